@@ -30,8 +30,6 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <queue>
-#include <stack>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
@@ -40,79 +38,46 @@
 #include "dist.h"
 #include "graph.h"
 #include "osm.h"
+#include "mapcache.h"
+#include "router.h"
+#include "ch.h"
+#include "sptcache.h"
+#include "components.h"
+#include "geoindex.h"
+#include "mapgraph.h"
 
 using namespace std;
 using namespace tinyxml2;
 
-const double INF = numeric_limits<double>::max();
-
-class prioritize {
-public:
-  bool operator()(const pair<long long , double>& p1, const pair<long long, double>& p2) const
-  {
-    return p1.second > p2.second; 
-  }
-};
-
-// @brief Find the center building based on coordinates of the midpoint, skipping unreachable buildings
+/// @brief Find the center building, the closest building to the midpoint that has not been tried yet
 /// @param Buildings Vector of BuildingInfo containing building information
-/// @param mid Coordinates representing the midpoint
-/// @param unreachableBuildings Set of buildings that are marked as unreachable
-/// @return BuildingInfo object representing the center building
-BuildingInfo findCenterBuilding(vector<BuildingInfo>& Buildings, Coordinates mid, set<string> unreachableBuildings) {
-  double minDist = INF;
-  BuildingInfo buildingCenter;
-
-  // Iterate over each building
-  for (BuildingInfo& building : Buildings) {
-    // Skip buildings marked as unreachable
-    if (unreachableBuildings.count(building.Abbrev) > 0) {
+/// @param candidates Cursor over the building index, enumerating buildings nearest to the midpoint first
+/// @param Components Connected components of the footway graph
+/// @param startNode Dense index of a node the destination must be connected to, or NO_VERTEX to accept any building
+/// @param buildingCenter Passed-by-reference variable to store the center building
+/// @return True if a center building was found, false if every building has been tried
+bool findCenterBuilding(vector<BuildingInfo>& Buildings, GeoIndex::NearestCursor& candidates,
+                        ComponentIndex& Components, uint32_t startNode, BuildingInfo& buildingCenter) {
+  // Pull buildings in order of distance from the midpoint; buildings
+  // already returned (and found unreachable) are never returned again
+  for (uint32_t i = candidates.next(); i != GeoIndex::NO_ITEM; i = candidates.next()) {
+    BuildingInfo& building = Buildings[i];
+
+    // Skip buildings that were not snapped to any node, the map has no footways to walk to them
+    if (building.NearestNode == NO_VERTEX) {
       continue;
     }
 
-    // Calculate the distance between the midpoint and the current building
-    double currDist = distBetween2Points(mid.Lat, mid.Lon, building.Coords.Lat, building.Coords.Lon);
-
-    // Update minimum distance and BuildingInfo of the center building if a closer distance is found
-    if (currDist < minDist) {
-      minDist = currDist;
-      buildingCenter = building;
+    // Skip buildings whose nearest node is in a different component than the start node
+    if (startNode != NO_VERTEX && !Components.connected(startNode, building.NearestNode)) {
+      continue;
     }
-  }
-
-  // Return the BuildingInfo of the building that is closest to the midpoint
-  return buildingCenter;
-}
 
-/// @brief Find the nearest node to a given building along footways
-/// @param Nodes Map of node IDs to their coordinates
-/// @param Footways Vector of FootwayInfo containing footway information
-/// @param building BuildingInfo representing the target building
-/// @return ID of the nearest node to the building along footways
-long long nearestNode(map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways, BuildingInfo building) {
-  double minDist = INF;
-  long long foundNode;
-
-  // Iterate over each footway
-  for (auto &footway : Footways) {
-    // Iterate over nodes in the current footway
-    for (size_t i = 0; i < footway.Nodes.size(); i++) {
-      // Get coordinates of the current node
-      Coordinates currCoords = Nodes.at(footway.Nodes[i]);
-
-      // Calculate the distance between the current node and the target building
-      double currDist = distBetween2Points(currCoords.Lat, currCoords.Lon, building.Coords.Lat, building.Coords.Lon);
-
-      // Update minimum distance and ID of the nearest node if a shorter distance is found
-      if (currDist < minDist) {
-        minDist = currDist;
-        foundNode = currCoords.ID;
-      }
-    }
+    buildingCenter = building;
+    return true;
   }
-  
-  // Return the ID of the nearest node
-  return foundNode;
+
+  return false;
 }
 
 /// @brief Search for a building in the data vector based on abbreviation or partial name
@@ -142,115 +107,21 @@ BuildingInfo searchBuilding(vector<BuildingInfo>& Buildings, string query) {
   return foundBuilding;
 }
 
-/// @brief Perform Dijkstra's shortest path algorithm to find all possible paths from a starting vertex
-/// @param G Graph of all vertices and edges information
-/// @param distances Map to store shortest distances from start vertex to each vertex
-/// @param predecessors Map to store predecessors for each vertex in the shortest path
-/// @param startV Starting vertex to begin the algorithm
-void DijkstraShortestPath(graph<long long, double>& G, map<long long, double>& distances, 
-                          map<long long, long long>& predecessors, long long startV) {
-  // Priority queue to store vertices with their distances, with custom comparison function
-  priority_queue<pair<long long, double>,
-  vector<pair<long long, double>>,
-  prioritize> unvisitedQueue;
-
-  // Set to track visited vertices
-  set<long long> visitedSet;
-
-  // Initialize distances and predecessors maps
-  for (long long& currV : G.getVertices()) {
-    distances[currV] = INF;
-    predecessors[currV] = 0;
-    unvisitedQueue.push(make_pair(currV, INF));
-  }
-
-  // Set distance of start vertex to 0 and add to the queue
-  distances[startV] = 0;
-  unvisitedQueue.push(make_pair(startV, 0));
-
-  // Loop while the remaining vertices are reachable
-  while (!unvisitedQueue.empty()) {
-    // Visit vertex with minimum distance from startV
-    long long currV = unvisitedQueue.top().first;
-    unvisitedQueue.pop();
-    
-    // Break if the remaining vertices have infinite distance, implying they are unreachable
-    if (distances[currV] == INF) {
-      break;
-    }
-    // Skip already visited vertices
-    else if (visitedSet.count(currV) > 0) { 
-      continue;
-    }
-    // If the vertex is not visited, mark it as visited and calculate its path
-    else {
-      visitedSet.insert(currV);
-    }
-
-    // Explore neighbors of the current vertex
-    for (auto& adjV : G.neighbors(currV)) {
-      double edgeWeight = 0;
-      G.getWeight(currV, adjV, edgeWeight); // retrieve the weight between current vertex and neighbor vertex
-      double alternativePathDist = distances[currV] + edgeWeight; // calculate potential shorter path to compare with calculated distance in map
-
-      // If a shorter path from startV to adjV is found, update adjV's distance and predecessor
-      if (alternativePathDist < distances[adjV]) {
-        distances[adjV] = alternativePathDist;
-        predecessors[adjV] = currV;
-        unvisitedQueue.push(make_pair(adjV, alternativePathDist));
-      }
-    }
-  }
-}
-
-/// @brief Get path from predecessors map and end vertex
-/// @param predecessors Map of predecessors for each node in the path
-/// @param endVertex The end vertex of the generated path
-/// @return Vector of path from start vertex to end vertex
-vector <long long> getPath(map<long long, long long> predecessors, long long endVertex) {
-  vector<long long> pathVector;
-  stack<long long> pathStack;
-
-  // Start from end vertex to trace back using predecessors
-  long long currV = endVertex;
-
-  while (predecessors[currV] != 0) {
-    pathStack.push(currV); // push into stack to reverse the order
-    currV = predecessors[currV]; // set to next predecessor
-  }
-  
-  // Add start vertex to the path vector
-  pathVector.push_back(currV);
-
-  // Pop elements from stack to reverse the order and add to path vector
-  while (!pathStack.empty()) {
-    long long currPathV = pathStack.top();
-    pathVector.push_back(currPathV);
-    pathStack.pop();
-  }
-
-  return pathVector;
-}
-
 /// @brief Print paths and distances for two persons to a destination node
-/// @param distances1 Map of distances from source node to each node for person 1
-/// @param predecessors1 Map of predecessors for each node in shortest path for person 1
-/// @param distances2 Map of distances from source node to each node for person 2
-/// @param predecessors2 Map of predecessors for each node in shortest path for person 2
-/// @param nodeCenter Destination node
-void printPathsAndDist(map<long long, double>& distances1, map<long long, long long>& predecessors1, 
-                        map<long long, double>& distances2, map<long long, long long>& predecessors2, 
-                        long long nodeCenter) {
+/// @param NodeCoords Vector of node coordinates, used to translate dense indices back to OSM IDs
+/// @param route1 Shortest route from person 1's node to the destination node
+/// @param route2 Shortest route from person 2's node to the destination node
+void printPathsAndDist(vector<Coordinates>& NodeCoords, RouteInfo& route1, RouteInfo& route2) {
   // Get paths for both buildings
-  vector<long long> pathToDist1 = getPath(predecessors1, nodeCenter);
-  vector<long long> pathToDist2 = getPath(predecessors2, nodeCenter);
+  vector<uint32_t>& pathToDist1 = route1.Path;
+  vector<uint32_t>& pathToDist2 = route2.Path;
 
   // Output person 1's distance and path
   cout << endl;
-  cout << "Person 1's distance to dest: " << distances1[nodeCenter] << " miles" << endl;
+  cout << "Person 1's distance to dest: " << route1.Distance << " miles" << endl;
   cout << "Path: ";
   for (size_t i = 0; i < pathToDist1.size(); i++) {
-    cout << pathToDist1[i];
+    cout << NodeCoords[pathToDist1[i]].ID;
     if (i != pathToDist1.size() - 1) {
       cout << "->";
     }
@@ -258,10 +129,10 @@ void printPathsAndDist(map<long long, double>& distances1, map<long long, long l
 
   // Output person 2's distance and path
   cout << endl;
-  cout << "Person 2's distance to dest: " << distances2[nodeCenter] << " miles" << endl;
+  cout << "Person 2's distance to dest: " << route2.Distance << " miles" << endl;
   cout << "Path: ";
   for (size_t i = 0; i < pathToDist2.size(); i++) {
-    cout << pathToDist2[i];
+    cout << NodeCoords[pathToDist2[i]].ID;
     if (i != pathToDist2.size() - 1) {
       cout << "->";
     }
@@ -270,12 +141,15 @@ void printPathsAndDist(map<long long, double>& distances1, map<long long, long l
   
 
 /// @brief Main application to find path to nearest center building between 2 selected buildings
-/// @param Nodes Map of node IDs to their coordinates
-/// @param Footways Vector of footway information
-/// @param Buildings Vector of building information
-/// @param G Graph of vertices and edges information
-void application (map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways,
-                  vector<BuildingInfo>& Buildings, graph<long long, double> G) {
+/// @param NodeCoords Vector of node coordinates, indexed by dense node index
+/// @param Buildings Vector of building information, each snapped to its nearest footway node
+/// @param BuildingIndex Spatial index of the buildings, items named by position in Buildings
+/// @param CH Contraction hierarchy of the footway graph, used to answer route queries
+/// @param Trees Cache of shortest-path trees, used to answer route queries once the first destination is unreachable
+/// @param Components Connected components of the footway graph, used to skip unreachable destinations
+void application (vector<Coordinates>& NodeCoords,
+                  vector<BuildingInfo>& Buildings, GeoIndex& BuildingIndex, ContractionHierarchy& CH, ShortestPathCache& Trees,
+                  ComponentIndex& Components) {
   string person1Building, person2Building;
 
   // Prompt for person 1's building
@@ -322,11 +196,7 @@ void application (map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footw
       building2 = searchBuilding(Buildings, person2Building);
     }
 
-    set<string> unreachableBuildings;
-    map<long long, double> distances1;
-    map<long long, long long> predecessors1;
-    map<long long, double> distances2;
-    map<long long, long long> predecessors2;
+    bool retrying = false;
     bool foundPath = false;
 
     // Display information about selected buildings
@@ -342,32 +212,43 @@ void application (map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footw
     // Calculate midpoint between two buildings
     Coordinates midpoint = centerBetween2Points(building1.Coords.Lat, building1.Coords.Lon, building2.Coords.Lat, building2.Coords.Lon);
 
-    // Find nearest nodes from both buildings
-    long long node1 = nearestNode(Nodes, Footways, building1);
-    long long node2 = nearestNode(Nodes, Footways, building2);
+    // Nearest nodes of both buildings, snapped when the map was loaded
+    uint32_t node1 = building1.NearestNode;
+    uint32_t node2 = building2.NearestNode;
+
+    // The start nodes never change while looking for a destination, so check once if they are connected;
+    // without footway nodes to snap to, no building is reachable and findCenterBuilding finds none
+    bool connected = node1 != NO_VERTEX && node2 != NO_VERTEX && Components.connected(node1, node2);
+
+    // Candidate destinations, closest to the midpoint first
+    GeoIndex::NearestCursor candidates = BuildingIndex.nearestFirst(midpoint.Lat, midpoint.Lon);
     
     // Loops while a path is not found for both buildings
     while (!foundPath) {
-      // Locate center building
-      BuildingInfo buildingCenter = findCenterBuilding(Buildings, midpoint, unreachableBuildings);
+      // Locate center building, only considering buildings both persons can walk to
+      BuildingInfo buildingCenter;
+      if (!findCenterBuilding(Buildings, candidates, Components, connected ? node1 : NO_VERTEX, buildingCenter)) {
+        cout << "Sorry, destination unreachable." << endl;
+        break;
+      }
 
-      // Find nearest node from destination building
-      long long nodeCenter = nearestNode(Nodes, Footways, buildingCenter);
+      // Nearest node of destination building
+      uint32_t nodeCenter = buildingCenter.NearestNode;
 
       // Display destination building and nearest nodes information
-      if (unreachableBuildings.empty()) {
+      if (!retrying) {
         cout << "Destination Building:" << endl;
         cout << " " << buildingCenter.Fullname << endl;
         cout << " (" << buildingCenter.Coords.Lat << ", " << buildingCenter.Coords.Lon << ")" << endl;
         
         cout << endl;
         cout << "Nearest P1 node:" << endl;
-        cout << " " << node1 << endl;
-        cout << " (" << Nodes.at(node1).Lat << ", " << Nodes.at(node1).Lon << ")" << endl;
+        cout << " " << NodeCoords[node1].ID << endl;
+        cout << " (" << NodeCoords[node1].Lat << ", " << NodeCoords[node1].Lon << ")" << endl;
 
         cout << "Nearest P2 node:" << endl;
-        cout << " " << node2 << endl;
-        cout << " (" << Nodes.at(node2).Lat << ", " << Nodes.at(node2).Lon << ")" << endl;
+        cout << " " << NodeCoords[node2].ID << endl;
+        cout << " (" << NodeCoords[node2].Lat << ", " << NodeCoords[node2].Lon << ")" << endl;
       }
       // Display only if first center building was unreachable
       else {
@@ -378,31 +259,41 @@ void application (map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footw
       }
 
       cout << "Nearest destination node:" << endl;
-      cout << " " << nodeCenter << endl;
-      cout << " (" << Nodes.at(nodeCenter).Lat << ", " << Nodes.at(nodeCenter).Lon << ")" << endl;
-
-      // Run Dijkstra’s Algorithm for first building's node
-      DijkstraShortestPath(G, distances1, predecessors1, node1);
+      cout << " " << NodeCoords[nodeCenter].ID << endl;
+      cout << " (" << NodeCoords[nodeCenter].Lat << ", " << NodeCoords[nodeCenter].Lon << ")" << endl;
 
       // Check if second building is unreachable, implying no possible path
-      if (distances1[node2] >= INF) {
+      if (!connected) {
         cout << "Sorry, destination unreachable." << endl;
         break;
       }
 
-      // Run Dijkstra’s Algorithm for second building's node
-      DijkstraShortestPath(G, distances2, predecessors2, node2);
+      RouteInfo route1, route2;
+
+      // Query the contraction hierarchy for routes from both buildings' nodes to the first destination node
+      if (!retrying) {
+        route1 = CH.query(node1, nodeCenter);
+        route2 = CH.query(node2, nodeCenter);
+      }
+      // Retries only change the destination, so read them from the cached shortest-path trees of both nodes.
+      // While every footway runs both ways, the component check above already rules out unreachable
+      // destinations and no retry happens; the cache (which allocates nothing until asked) keeps retries
+      // cheap should one-way edges ever make a connected destination unreachable
+      else {
+        route1 = Trees.route(node1, nodeCenter);
+        route2 = Trees.route(node2, nodeCenter);
+      }
 
       // Check if center building is unreachable for either person
-      if (distances1[nodeCenter] >= INF || distances2[nodeCenter] >= INF) {
-        // Mark the building as unreachable
-        unreachableBuildings.insert(buildingCenter.Abbrev);
+      if (route1.Distance >= INF || route2.Distance >= INF) {
+        // Move on to the next closest building
+        retrying = true;
         cout << "At least one person was unable to reach the destination building. Finding next closest building..." << endl;
       } 
       else {
         // Output distances and paths to destination
         foundPath = true;
-        printPathsAndDist(distances1, predecessors1, distances2, predecessors2, nodeCenter);
+        printPathsAndDist(NodeCoords, route1, route2);
       }
     }
     
@@ -413,47 +304,18 @@ void application (map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footw
   }
 }
 
-/// @brief Populate graph with vertices and edges based on provided information
-/// @param Nodes Map of node IDs to their coordinates
-/// @param Footways Vector of footway information
-/// @param Buildings Vector of building information
-/// @param G Graph to be populated
-void populateGraph (
-    map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways,
-    vector<BuildingInfo>& Buildings, graph<long long, double>& G) {
-  
-  // Add vertices to graph for each node
-  for (auto &vertex : Nodes) {
-    G.addVertex(vertex.first);
-  }
-
-  // Add edges to graph based on footway information
-  for (auto &footway : Footways) {
-    // Iterate over nodes in the footway
-    for (size_t i = 0; i < footway.Nodes.size() - 1; i++) {
-      // Retrieve coordinates of two consecutive nodes
-      Coordinates c1 = Nodes.at(footway.Nodes[i]);
-      Coordinates c2 = Nodes.at(footway.Nodes[i + 1]);
-
-      // Calculate distance between the nodes
-      double distance = distBetween2Points(c1.Lat, c1.Lon, c2.Lat, c2.Lon);
-
-      // Add edges in both directions
-      G.addEdge(c1.ID, c2.ID, distance);
-      G.addEdge(c2.ID, c1.ID, distance);
-    }
-  }
-}
-
 int main() {
   graph<long long, double> G;
+  // connected components of the footway graph
+  ComponentIndex Components;
   // maps a Node ID to it's coordinates (lat, lon)
   map<long long, Coordinates>  Nodes;
   // info about each footway, in no particular order
   vector<FootwayInfo>          Footways;
   // info about each building, in no particular order
   vector<BuildingInfo>         Buildings;
-  XMLDocument                  xmldoc;
+  // number of each read from the map file
+  MapCounts                    Counts;
 
   cout << "** Navigating UIC open street map **" << endl;
   cout << endl;
@@ -469,39 +331,69 @@ int main() {
     filename = def_filename;
   }
 
-  // Load XML-based map file
-  if (!LoadOpenStreetMap(filename, xmldoc)) {
-    cout << "**Error: unable to load open street map." << endl;
-    cout << endl;
-    return 0;
-  }
+  // Reuse the map compiled by an earlier run when it is still current;
+  // otherwise stream the XML-based map file in one pass, reading the
+  // nodes (the various known positions on the map), the footways (the
+  // walking paths) and the university buildings, and compile it
+  string compiledFilename = filename + ".bin";
+  vector<Coordinates> NodeCoords;
 
-  // Read the nodes, which are the various known positions on the map
-  int nodeCount = ReadMapNodes(xmldoc, Nodes);
+  if (!loadCompiledMap(compiledFilename, filename, G, NodeCoords, Buildings, Counts, Components)) {
+    if (!StreamOpenStreetMap(filename, Nodes, Footways, Buildings, Counts)) {
+      cout << "**Error: unable to load open street map." << endl;
+      cout << endl;
+      return 0;
+    }
 
-  // Read the footways, which are the walking paths
-  int footwayCount = ReadFootways(xmldoc, Footways);
+    assert(Counts.Nodes == (int)Nodes.size());
+    assert(Counts.Footways == (int)Footways.size());
+    assert(Counts.Buildings == (int)Buildings.size());
 
-  // Read the university buildings
-  int buildingCount = ReadUniversityBuildings(xmldoc, Nodes, Buildings);
+    populateGraph(Nodes, Footways, Buildings, G, &Components);
 
-  // Stats
-  assert(nodeCount == (int)Nodes.size());
-  assert(footwayCount == (int)Footways.size());
-  assert(buildingCount == (int)Buildings.size());
+    // The map never changes after loading, so compact the graph for routing
+    G.freeze();
+
+    // Dense node tables; OSM IDs are only needed again when printing
+    vector<uint32_t> FootwayNodes;
+    buildNodeTables(Nodes, Footways, G, NodeCoords, FootwayNodes);
 
+    // Snap every building to its nearest footway node once, up front
+    GeoIndex FootwayIndex;
+    buildFootwayIndex(NodeCoords, FootwayNodes, FootwayIndex);
+    snapBuildings(Buildings, FootwayIndex);
+
+    saveCompiledMap(compiledFilename, filename, G, NodeCoords, Buildings, Counts);
+  }
+
+  // Stats
   cout << endl;
-  cout << "# of nodes: " << Nodes.size() << endl;
-  cout << "# of footways: " << Footways.size() << endl;
-  cout << "# of buildings: " << Buildings.size() << endl;
+  cout << "# of nodes: " << Counts.Nodes << endl;
+  cout << "# of footways: " << Counts.Footways << endl;
+  cout << "# of buildings: " << Counts.Buildings << endl;
 
-  populateGraph(Nodes, Footways, Buildings, G);
+  // Spatial index for finding the buildings closest to a midpoint
+  GeoIndex BuildingIndex;
+  buildBuildingIndex(Buildings, BuildingIndex);
 
   cout << "# of vertices: " << G.NumVertices() << endl;
   cout << "# of edges: " << G.NumEdges() << endl;
 
+  // Preprocess the contraction hierarchy once per map, reusing the copy
+  // saved next to the map file when it matches the graph
+  ContractionHierarchy CH;
+  string chFilename = filename + ".ch";
+
+  if (!CH.load(chFilename, G)) {
+    CH.build(G);
+    CH.save(chFilename);
+  }
+
+  // Shortest-path trees of start nodes, kept across retries and queries
+  ShortestPathCache Trees(G);
+
   // Execute Application
-  application(Nodes, Footways, Buildings, G);
+  application(NodeCoords, Buildings, BuildingIndex, CH, Trees, Components);
 
   cout << "** Done **" << endl;
   return 0;
@@ -0,0 +1,470 @@
+// benchmark.cpp
+//
+// Routing benchmark: loads a map, builds the footway graph the same way
+// as application.cpp, and runs the same random point-to-point queries
+// through each of the router's query modes, ALT and the contraction
+// hierarchy.  For each mode it reports the average number of settled
+// vertices and the average query time, and checks that every mode
+// finds the same distances as Dijkstra.  It also times snapping random
+// positions to the nearest footway node, by linear scan, by the batch
+// distance kernel and by the spatial index.
+//
+// Usage: ./benchmark.exe [map.osm] [number of queries]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+
+#include "tinyxml2.h"
+#include "osm.h"
+#include "graph.h"
+#include "router.h"
+#include "mapgraph.h"
+#include "ch.h"
+#include "landmarks.h"
+#include "geoindex.h"
+#include "dist.h"
+
+using namespace std;
+using namespace tinyxml2;
+
+
+//
+// benchmarkMode
+//
+// Runs the queries through one query mode and prints its statistics.
+// The distances of the first mode run are kept as the reference that
+// later modes are checked against.
+//
+void benchmarkMode(string name, vector<pair<uint32_t, uint32_t>>& queries,
+                   function<RouteInfo(uint32_t, uint32_t)> query, vector<double>& reference)
+{
+  size_t totalSettled = 0;
+  int mismatches = 0;
+  bool isReference = reference.empty();
+
+  auto start = chrono::steady_clock::now();
+
+  for (size_t i = 0; i < queries.size(); i++)
+  {
+    RouteInfo route = query(queries[i].first, queries[i].second);
+    totalSettled += route.Settled;
+
+    if (isReference)
+    {
+      reference.push_back(route.Distance);
+    }
+    else if (route.Distance != reference[i] && fabs(route.Distance - reference[i]) > 1e-9)
+    {
+      mismatches++;
+    }
+  }
+
+  auto stop = chrono::steady_clock::now();
+  double micros = chrono::duration<double, micro>(stop - start).count();
+
+  cout << left << setw(16) << name
+       << right << setw(14) << fixed << setprecision(1) << (double)totalSettled / queries.size()
+       << setw(14) << micros / queries.size();
+
+  if (isReference)
+    cout << "     (reference)";
+  else
+    cout << "     " << mismatches << " mismatches";
+
+  cout << endl;
+}
+
+
+//
+// benchmarkSnapping
+//
+// Snaps random positions within the map's bounding box to the nearest
+// footway node by scanning every footway node, by the batch distance
+// kernel and through the spatial index, and checks that all find the
+// same node.
+//
+void benchmarkSnapping(vector<Coordinates>& NodeCoords, vector<uint32_t>& FootwayNodes, int numQueries)
+{
+  GeoIndex FootwayIndex;
+
+  auto start = chrono::steady_clock::now();
+  buildFootwayIndex(NodeCoords, FootwayNodes, FootwayIndex);
+  auto stop = chrono::steady_clock::now();
+  double buildSecs = chrono::duration<double>(stop - start).count();
+
+  double minLat = INF, maxLat = -INF, minLon = INF, maxLon = -INF;
+
+  for (uint32_t node : FootwayNodes)
+  {
+    minLat = min(minLat, NodeCoords[node].Lat);
+    maxLat = max(maxLat, NodeCoords[node].Lat);
+    minLon = min(minLon, NodeCoords[node].Lon);
+    maxLon = max(maxLon, NodeCoords[node].Lon);
+  }
+
+  mt19937 rng(251);
+  uniform_real_distribution<double> pickLat(minLat, maxLat);
+  uniform_real_distribution<double> pickLon(minLon, maxLon);
+  vector<Coordinates> positions;
+
+  for (int i = 0; i < numQueries; i++)
+  {
+    positions.push_back(Coordinates(-1, pickLat(rng), pickLon(rng)));
+  }
+
+  vector<uint32_t> scanned;
+
+  start = chrono::steady_clock::now();
+  for (Coordinates& position : positions)
+  {
+    double minDist = INF;
+    uint32_t found = NO_VERTEX;
+
+    for (uint32_t node : FootwayNodes)
+    {
+      double currDist = distBetween2Points(position.Lat, position.Lon, NodeCoords[node].Lat, NodeCoords[node].Lon);
+
+      if (currDist < minDist)
+      {
+        minDist = currDist;
+        found = node;
+      }
+    }
+
+    scanned.push_back(found);
+  }
+  stop = chrono::steady_clock::now();
+  double scanMicros = chrono::duration<double, micro>(stop - start).count();
+
+  vector<double> lats, lons;
+
+  for (uint32_t node : FootwayNodes)
+  {
+    lats.push_back(NodeCoords[node].Lat);
+    lons.push_back(NodeCoords[node].Lon);
+  }
+
+  int batchMismatches = 0;
+
+  start = chrono::steady_clock::now();
+  for (size_t i = 0; i < positions.size(); i++)
+  {
+    size_t found = nearestOf(positions[i].Lat, positions[i].Lon, lats.data(), lons.data(), lats.size());
+
+    if (FootwayNodes[found] != scanned[i])
+      batchMismatches++;
+  }
+  stop = chrono::steady_clock::now();
+  double batchMicros = chrono::duration<double, micro>(stop - start).count();
+
+  int mismatches = 0;
+
+  start = chrono::steady_clock::now();
+  for (size_t i = 0; i < positions.size(); i++)
+  {
+    if (FootwayIndex.nearest(positions[i].Lat, positions[i].Lon) != scanned[i])
+      mismatches++;
+  }
+  stop = chrono::steady_clock::now();
+  double indexMicros = chrono::duration<double, micro>(stop - start).count();
+
+  cout << left << setw(16) << "snap: scan"
+       << right << setw(28) << fixed << setprecision(1) << scanMicros / numQueries
+       << "     (reference)" << endl;
+  cout << left << setw(16) << "snap: batch"
+       << right << setw(28) << batchMicros / numQueries
+       << "     " << batchMismatches << " mismatches" << endl;
+  cout << left << setw(16) << "snap: k-d tree"
+       << right << setw(28) << indexMicros / numQueries
+       << "     " << mismatches << " mismatches" << endl;
+  cout << endl;
+  cout << "Footway index: " << setprecision(2) << buildSecs << " sec, "
+       << FootwayIndex.size() << " nodes" << endl;
+}
+
+
+//
+// benchmarkLoading
+//
+// Loads the map again reading it in chunks, parsing it in place from a
+// memory mapping, splitting the mapping across threads, and into a DOM
+// (twice, the second time reusing it), and checks that all read the
+// same number of nodes, footways and buildings.
+//
+void benchmarkLoading(string filename)
+{
+  struct LoadMode {
+    const char* name;
+    bool mapFile;
+    unsigned threads;
+  };
+
+  const LoadMode modes[] = {
+    {"load: read", false, 1},
+    {"load: mmap", true, 1},
+    {"load: threads", true, 0}
+  };
+
+  MapCounts reference;
+
+  for (const LoadMode& mode : modes)
+  {
+    map<long long, Coordinates>  Nodes;
+    vector<FootwayInfo>          Footways;
+    vector<BuildingInfo>         Buildings;
+    MapCounts                    Counts;
+
+    auto start = chrono::steady_clock::now();
+    StreamOpenStreetMap(filename, Nodes, Footways, Buildings, Counts, mode.mapFile, mode.threads);
+    auto stop = chrono::steady_clock::now();
+    double millis = chrono::duration<double, milli>(stop - start).count();
+
+    bool same = (&mode == &modes[0]) ||
+      (Counts.Nodes == reference.Nodes && Counts.Footways == reference.Footways &&
+       Counts.Buildings == reference.Buildings);
+
+    if (&mode == &modes[0])
+      reference = Counts;
+
+    cout << left << setw(16) << mode.name
+         << right << setw(28) << fixed << setprecision(1) << millis << " ms"
+         << (same ? "" : "     counts differ") << endl;
+  }
+
+  //
+  // and twice more into a tinyxml2 DOM, the loader whose tokenizer scans
+  // names, values and whitespace with SIMD.  The second time reuses the
+  // document, and with it the memory the first load allocated:
+  //
+  XMLDocument xmldoc;
+
+  for (const char* name : {"load: dom", "load: dom again"})
+  {
+    map<long long, Coordinates>  Nodes;
+    vector<FootwayInfo>          Footways;
+    vector<BuildingInfo>         Buildings;
+
+    auto start = chrono::steady_clock::now();
+    LoadOpenStreetMap(filename, xmldoc);
+    int nodes = ReadMapNodes(xmldoc, Nodes);
+    int footways = ReadFootways(xmldoc, Footways);
+    int buildings = ReadUniversityBuildings(xmldoc, Nodes, Buildings);
+    auto stop = chrono::steady_clock::now();
+    double millis = chrono::duration<double, milli>(stop - start).count();
+
+    bool same = (nodes == reference.Nodes && footways == reference.Footways &&
+                 buildings == reference.Buildings);
+
+    cout << left << setw(16) << name
+         << right << setw(28) << fixed << setprecision(1) << millis << " ms"
+         << (same ? "" : "     counts differ") << endl;
+  }
+
+  cout << "Loader threads: " << max(1u, thread::hardware_concurrency()) << endl;
+}
+
+
+//
+// benchmarkNumberParsing
+//
+// Converts the map's node IDs and positions, written out the way OSM
+// files write them, back into numbers with sscanf, with XMLUtil, and
+// (for positions) with the fixed-point decimal parser, and checks that
+// all give the same values.
+//
+void benchmarkNumberParsing(map<long long, Coordinates>& Nodes)
+{
+  vector<string> ids, positions;
+  vector<long long> idValues;
+  vector<double> positionValues;
+
+  for (auto& node : Nodes)
+  {
+    char text[32];
+
+    snprintf(text, sizeof(text), "%lld", node.first);
+    ids.push_back(text);
+    snprintf(text, sizeof(text), "%.7f", node.second.Lat);
+    positions.push_back(text);
+    snprintf(text, sizeof(text), "%.7f", node.second.Lon);
+    positions.push_back(text);
+  }
+
+  for (const string& text : ids)
+  {
+    long long value = 0;
+    sscanf(text.c_str(), "%lld", &value);
+    idValues.push_back(value);
+  }
+
+  for (const string& text : positions)
+  {
+    double value = 0;
+    sscanf(text.c_str(), "%lf", &value);
+    positionValues.push_back(value);
+  }
+
+  //
+  // times one way of converting all the strings, in nsec per string:
+  //
+  auto timeParse = [](const char* name, const vector<string>& texts, function<bool(const string&, size_t)> parse)
+  {
+    int mismatches = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < texts.size(); i++)
+    {
+      if (!parse(texts[i], i))
+        mismatches++;
+    }
+    auto stop = chrono::steady_clock::now();
+    double nanos = chrono::duration<double, nano>(stop - start).count();
+
+    cout << left << setw(24) << name
+         << right << setw(20) << fixed << setprecision(1) << nanos / max((size_t)1, texts.size())
+         << "     " << mismatches << " mismatches" << endl;
+  };
+
+  cout << left << setw(24) << "parse" << right << setw(20) << "avg nsec" << endl;
+
+  timeParse("id: sscanf", ids, [&](const string& text, size_t i) {
+    long long value = 0;
+    sscanf(text.c_str(), "%lld", &value);
+    return value == idValues[i];
+  });
+  timeParse("id: XMLUtil", ids, [&](const string& text, size_t i) {
+    int64_t value = 0;
+    XMLUtil::ToInt64(text.c_str(), &value);
+    return value == idValues[i];
+  });
+  timeParse("lat/lon: sscanf", positions, [&](const string& text, size_t i) {
+    double value = 0;
+    sscanf(text.c_str(), "%lf", &value);
+    return value == positionValues[i];
+  });
+  timeParse("lat/lon: XMLUtil", positions, [&](const string& text, size_t i) {
+    double value = 0;
+    XMLUtil::ToDouble(text.c_str(), &value);
+    return value == positionValues[i];
+  });
+  timeParse("lat/lon: fixed-point", positions, [&](const string& text, size_t i) {
+    double value = 0;
+    XMLUtil::ToFixedDecimal(text.data(), text.data() + text.size(), &value);
+    return value == positionValues[i];
+  });
+}
+
+
+int main(int argc, char* argv[])
+{
+  string filename = (argc > 1) ? argv[1] : "map.osm";
+  int numQueries = (argc > 2) ? atoi(argv[2]) : 1000;
+
+  map<long long, Coordinates>  Nodes;
+  vector<FootwayInfo>          Footways;
+  vector<BuildingInfo>         Buildings;
+  MapCounts                    Counts;
+
+  if (!StreamOpenStreetMap(filename, Nodes, Footways, Buildings, Counts))
+  {
+    return 1;
+  }
+
+  graph<long long, double> G;
+  populateGraph(Nodes, Footways, Buildings, G);
+  G.freeze();
+
+  vector<Coordinates> NodeCoords;
+  vector<uint32_t>    FootwayNodes;
+  buildNodeTables(Nodes, Footways, G, NodeCoords, FootwayNodes);
+
+  cout << "Map: " << filename << endl;
+  cout << "# of vertices: " << G.NumVertices() << endl;
+  cout << "# of edges: " << G.NumEdges() << endl;
+  cout << "# of queries: " << numQueries << endl;
+  cout << endl;
+
+  if (FootwayNodes.empty() || numQueries <= 0)
+  {
+    cout << "**Error: no footways to route between." << endl;
+    return 1;
+  }
+
+  //
+  // random source/target pairs among footway nodes, seeded so every
+  // run (and every mode) sees the same queries:
+  //
+  mt19937 rng(251);
+  uniform_int_distribution<size_t> pick(0, FootwayNodes.size() - 1);
+  vector<pair<uint32_t, uint32_t>> queries;
+
+  for (int i = 0; i < numQueries; i++)
+  {
+    queries.push_back(make_pair(FootwayNodes[pick(rng)], FootwayNodes[pick(rng)]));
+  }
+
+  Router router(G, NodeCoords);
+  vector<double> reference;
+
+  cout << left << setw(16) << "mode" << right << setw(14) << "avg settled" << setw(14) << "avg usec" << endl;
+
+  benchmarkMode("dijkstra", queries,
+    [&](uint32_t s, uint32_t t) { return router.shortestPath(s, t); }, reference);
+  benchmarkMode("bidirectional", queries,
+    [&](uint32_t s, uint32_t t) { return router.bidirectionalPath(s, t); }, reference);
+  benchmarkMode("astar", queries,
+    [&](uint32_t s, uint32_t t) { return router.astarPath(s, t); }, reference);
+
+  //
+  // ALT and the contraction hierarchy, timing the preprocessing separately:
+  //
+  LandmarkSet landmarks;
+
+  auto start = chrono::steady_clock::now();
+  landmarks.build(G, NodeCoords, 8);
+  auto stop = chrono::steady_clock::now();
+  double landmarkSecs = chrono::duration<double>(stop - start).count();
+
+  router.useLandmarks(landmarks);
+
+  benchmarkMode("alt", queries,
+    [&](uint32_t s, uint32_t t) { return router.altPath(s, t); }, reference);
+
+  ContractionHierarchy CH;
+
+  start = chrono::steady_clock::now();
+  CH.build(G);
+  stop = chrono::steady_clock::now();
+
+  benchmarkMode("ch", queries,
+    [&](uint32_t s, uint32_t t) { return CH.query(s, t); }, reference);
+
+  cout << endl;
+  cout << "ALT preprocessing: " << fixed << setprecision(2) << landmarkSecs << " sec, "
+       << landmarks.size() << " landmarks" << endl;
+  cout << "CH preprocessing: " << fixed << setprecision(2)
+       << chrono::duration<double>(stop - start).count() << " sec, "
+       << CH.numShortcuts() << " shortcuts" << endl;
+  cout << endl;
+
+  benchmarkSnapping(NodeCoords, FootwayNodes, numQueries);
+  cout << endl;
+
+  benchmarkLoading(filename);
+  cout << endl;
+
+  benchmarkNumberParsing(Nodes);
+
+  return 0;
+}
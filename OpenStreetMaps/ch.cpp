@@ -0,0 +1,830 @@
+/*ch.cpp*/
+
+//
+// Contraction hierarchy over the frozen footway graph, see ch.h.
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+#include "ch.h"
+
+using namespace std;
+
+
+//
+// Limits on the vertices settled by one witness search, when actually
+// contracting a vertex and when only estimating its priority.  A
+// witness search that gives up early only costs an unnecessary
+// shortcut, never a wrong distance, but unnecessary shortcuts make the
+// remaining graph denser and every later search slower, so contraction
+// searches far enough to find nearly every witness.
+//
+static const int WITNESS_SETTLE_LIMIT = 1000;
+static const int PRIORITY_SETTLE_LIMIT = 50;
+
+static const char CH_MAGIC[8] = {'O', 'S', 'M', 'C', 'H', '0', '0', '2'};
+
+
+//
+// Header of a saved hierarchy, followed by payloadSize bytes of
+// contents.
+//
+struct ChHeader
+{
+  char magic[8];
+  uint64_t numVertices;
+  uint64_t fingerprint;    // of the graph the hierarchy was built from
+  uint64_t payloadSize;
+  uint64_t checksum;       // of the payload
+};
+
+
+//
+// checksum
+//
+// FNV-1a hash of a block of bytes.
+//
+static uint64_t checksum(const char* data, size_t size)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+
+//
+// graphFingerprint
+//
+// FNV-1a hash over the vertices and edges of a frozen graph, used to
+// check that a saved hierarchy still matches the graph.
+//
+uint64_t graphFingerprint(const graph<long long, double>& G)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  auto mix = [&](const void* data, size_t size)
+  {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+  };
+
+  uint32_t numVertices = G.NumVertices();
+  mix(&numVertices, sizeof(numVertices));
+
+  for (uint32_t v = 0; v < numVertices; v++)
+  {
+    long long id = G.vertexAt(v);
+    mix(&id, sizeof(id));
+
+    for (auto edge : G.edges(v))
+    {
+      mix(&edge.neighbor, sizeof(edge.neighbor));
+      mix(&edge.weight, sizeof(edge.weight));
+    }
+  }
+
+  return hash;
+}
+
+
+//
+// isSymmetric
+//
+// Returns true if every edge of G has a reverse edge of the same
+// weight, as in the footway graph where every footway is walkable both
+// ways.
+//
+static bool isSymmetric(const graph<long long, double>& G)
+{
+  for (uint32_t v = 0; v < (uint32_t)G.NumVertices(); v++)
+  {
+    for (auto edge : G.edges(v))
+    {
+      bool reversed = false;
+
+      for (auto back : G.edges(edge.neighbor))
+      {
+        if (back.neighbor == v)
+        {
+          reversed = back.weight == edge.weight;
+          break;
+        }
+      }
+
+      if (!reversed)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+
+//
+// ContractionHierarchy
+//
+ContractionHierarchy::ContractionHierarchy()
+  : numVertices(0), built(false), fingerprint(0), generation(0)
+{
+}
+
+
+//
+// build
+//
+// Contracts every vertex of the graph, in an order chosen by a lazily
+// updated priority: the number of shortcuts contracting a vertex would
+// add, minus the edges it would remove, plus the number of neighbors
+// already contracted and the vertex's level in the hierarchy so far
+// (both of which spread contraction evenly over the map).  A priority
+// is only recomputed when the vertex reaches the front of the queue
+// after one of its neighbors was contracted.
+//
+// On a symmetric graph shortcuts come in pairs of the same weight, so
+// the remaining graph stays symmetric and a witness search from u also
+// decides the shortcut w -> u; only half the searches are run.
+//
+void ContractionHierarchy::build(const graph<long long, double>& G)
+{
+  assert(G.isFrozen());
+
+  numVertices = G.NumVertices();
+  built = false;
+  fingerprint = graphFingerprint(G);
+  edges.clear();
+
+  bool symmetric = isSymmetric(G);
+
+  //
+  // remaining graph: edge ids in and out of every uncontracted vertex,
+  // starting with the original edges:
+  //
+  vector<vector<uint32_t>> outE(numVertices);
+  vector<vector<uint32_t>> inE(numVertices);
+
+  for (uint32_t v = 0; v < numVertices; v++)
+  {
+    for (auto edge : G.edges(v))
+    {
+      uint32_t id = edges.size();
+      edges.push_back(ChEdge{v, edge.neighbor, edge.weight, NO_EDGE, NO_EDGE});
+      outE[v].push_back(id);
+      inE[edge.neighbor].push_back(id);
+    }
+  }
+
+  //
+  // witness search workspace:
+  //
+  vector<double> witnessDist(numVertices);
+  vector<uint32_t> witnessStamp(numVertices, 0);
+  vector<uint32_t> targetStamp(numVertices, 0);
+  uint32_t witnessGeneration = 0;
+  dheap<double> witnessHeap(numVertices);
+
+  // Dijkstra from u in the remaining graph avoiding v, up to maxDist or
+  // until all numTargets vertices stamped in targetStamp are settled:
+  auto witnessSearch = [&](uint32_t u, uint32_t v, double maxDist, int limit, int numTargets)
+  {
+    witnessGeneration++;
+    witnessHeap.clear();
+
+    witnessDist[u] = 0;
+    witnessStamp[u] = witnessGeneration;
+    witnessHeap.pushOrDecrease(u, 0);
+
+    int settled = 0;
+
+    while (!witnessHeap.empty() && settled < limit)
+    {
+      if (witnessHeap.topKey() > maxDist)
+        break;
+
+      uint32_t currV = witnessHeap.pop();
+      settled++;
+
+      if (targetStamp[currV] == witnessGeneration && --numTargets == 0)
+        break;
+
+      for (uint32_t e : outE[currV])
+      {
+        uint32_t adjV = edges[e].to;
+        if (adjV == v)
+          continue;
+
+        double d = witnessDist[currV] + edges[e].weight;
+
+        if (witnessStamp[adjV] != witnessGeneration || d < witnessDist[adjV])
+        {
+          witnessDist[adjV] = d;
+          witnessStamp[adjV] = witnessGeneration;
+          witnessHeap.pushOrDecrease(adjV, d);
+        }
+      }
+    }
+  };
+
+  // adds shortcut u -> w unless an edge at least as short already exists:
+  auto addShortcut = [&](uint32_t u, uint32_t w, double weight, uint32_t e1, uint32_t e2)
+  {
+    uint32_t id = edges.size();
+
+    for (uint32_t& e : outE[u])
+    {
+      if (edges[e].to != w)
+        continue;
+
+      if (edges[e].weight <= weight)
+        return;
+
+      // replace the longer edge in both adjacency lists:
+      replace(inE[w].begin(), inE[w].end(), e, id);
+      e = id;
+      edges.push_back(ChEdge{u, w, weight, e1, e2});
+      return;
+    }
+
+    edges.push_back(ChEdge{u, w, weight, e1, e2});
+    outE[u].push_back(id);
+    inE[w].push_back(id);
+  };
+
+  // the edges into and out of the vertex being contracted, by neighbor:
+  vector<uint32_t> edgeFrom(numVertices, NO_EDGE);
+  vector<uint32_t> edgeTo(numVertices, NO_EDGE);
+
+  // shortcuts needed to contract v, which are added if add is true:
+  auto contractShortcuts = [&](uint32_t v, bool add)
+  {
+    int count = 0;
+
+    // iterate over a copy, since adding shortcuts may grow the lists:
+    vector<uint32_t> incoming = inE[v];
+    vector<uint32_t> outgoing = outE[v];
+
+    for (uint32_t e : incoming)
+      edgeFrom[edges[e].from] = e;
+    for (uint32_t e : outgoing)
+      edgeTo[edges[e].to] = e;
+
+    for (uint32_t e1 : incoming)
+    {
+      uint32_t u = edges[e1].from;
+
+      // the out-neighbors of v are the targets of the witness search,
+      // stamped with the generation the search is about to use:
+      int numTargets = 0;
+      double maxOut = 0;
+      for (uint32_t e2 : outgoing)
+      {
+        uint32_t w = edges[e2].to;
+        if (w != u && (!symmetric || u < w) && targetStamp[w] != witnessGeneration + 1)
+        {
+          targetStamp[w] = witnessGeneration + 1;
+          numTargets++;
+          maxOut = max(maxOut, edges[e2].weight);
+        }
+      }
+
+      if (numTargets == 0)
+        continue;
+
+      witnessSearch(u, v, edges[e1].weight + maxOut, add ? WITNESS_SETTLE_LIMIT : PRIORITY_SETTLE_LIMIT, numTargets);
+
+      for (uint32_t e2 : outgoing)
+      {
+        uint32_t w = edges[e2].to;
+        if (w == u || (symmetric && u > w))
+          continue;
+
+        double viaV = edges[e1].weight + edges[e2].weight;
+
+        if (witnessStamp[w] == witnessGeneration && witnessDist[w] <= viaV)
+          continue;
+
+        count++;
+        if (add)
+          addShortcut(u, w, viaV, e1, e2);
+
+        if (symmetric)
+        {
+          count++;
+          if (add)
+            addShortcut(w, u, viaV, edgeFrom[w], edgeTo[u]);
+        }
+      }
+    }
+
+    for (uint32_t e : incoming)
+      edgeFrom[edges[e].from] = NO_EDGE;
+    for (uint32_t e : outgoing)
+      edgeTo[edges[e].to] = NO_EDGE;
+
+    return count;
+  };
+
+  vector<int> contractedNeighbors(numVertices, 0);
+  vector<int> level(numVertices, 0);
+  vector<bool> stale(numVertices, false);
+
+  auto priority = [&](uint32_t v)
+  {
+    int removed = inE[v].size() + outE[v].size();
+    return contractShortcuts(v, false) - removed + contractedNeighbors[v] + level[v];
+  };
+
+  //
+  // contract vertices in priority order, re-checking the priority of
+  // each vertex when it reaches the front of the queue:
+  //
+  dheap<int> order(numVertices);
+  for (uint32_t v = 0; v < numVertices; v++)
+    order.pushOrDecrease(v, priority(v));
+
+  rank.assign(numVertices, 0);
+  vector<vector<uint32_t>> upList(numVertices);
+  vector<vector<uint32_t>> downList(numVertices);
+  uint32_t nextRank = 0;
+
+  while (!order.empty())
+  {
+    uint32_t v = order.pop();
+
+    if (stale[v])
+    {
+      stale[v] = false;
+
+      int current = priority(v);
+      if (!order.empty() && current > order.topKey())
+      {
+        order.pushOrDecrease(v, current);
+        continue;
+      }
+    }
+
+    // every remaining neighbor will be ranked higher than v:
+    upList[v] = outE[v];
+    downList[v] = inE[v];
+
+    contractShortcuts(v, true);
+
+    // remove v from the remaining graph:
+    vector<uint32_t> neighbors;
+    for (uint32_t e : outE[v])
+    {
+      uint32_t w = edges[e].to;
+      inE[w].erase(find(inE[w].begin(), inE[w].end(), e));
+      neighbors.push_back(w);
+    }
+    for (uint32_t e : inE[v])
+    {
+      uint32_t u = edges[e].from;
+      outE[u].erase(find(outE[u].begin(), outE[u].end(), e));
+      neighbors.push_back(u);
+    }
+    outE[v].clear();
+    inE[v].clear();
+
+    rank[v] = nextRank++;
+
+    sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    for (uint32_t x : neighbors)
+    {
+      contractedNeighbors[x]++;
+      level[x] = max(level[x], level[v] + 1);
+      stale[x] = true;
+    }
+  }
+
+  //
+  // flatten the upward and downward edge lists:
+  //
+  upOffsets.assign(1, 0);
+  downOffsets.assign(1, 0);
+  upEdges.clear();
+  downEdges.clear();
+
+  for (uint32_t v = 0; v < numVertices; v++)
+  {
+    upEdges.insert(upEdges.end(), upList[v].begin(), upList[v].end());
+    downEdges.insert(downEdges.end(), downList[v].begin(), downList[v].end());
+    upOffsets.push_back(upEdges.size());
+    downOffsets.push_back(downEdges.size());
+  }
+
+  prepareQueries();
+  built = true;
+}
+
+
+//
+// writeVector / readVector
+//
+// Vectors are stored in the payload as a 64-bit element count followed
+// by the raw elements.  readVector reads the vector at pos and moves pos
+// past it; it refuses counts larger than limit, or than the rest of the
+// payload could hold, so a damaged count cannot make it allocate more
+// memory than the file is big.
+//
+template<typename T>
+static void writeVector(string& payload, const vector<T>& data)
+{
+  uint64_t count = data.size();
+  payload.append((const char*)&count, sizeof(count));
+  payload.append((const char*)data.data(), count * sizeof(T));
+}
+
+template<typename T>
+static bool readVector(const string& payload, size_t& pos, vector<T>& data, uint64_t limit)
+{
+  uint64_t count = 0;
+
+  if (payload.size() - pos < sizeof(count))
+    return false;
+
+  memcpy(&count, payload.data() + pos, sizeof(count));
+  pos += sizeof(count);
+
+  if (count > limit || count > (payload.size() - pos) / sizeof(T))
+    return false;
+
+  data.resize(count);
+  if (count > 0)
+    memcpy((void*)data.data(), payload.data() + pos, count * sizeof(T));
+  pos += count * sizeof(T);
+  return true;
+}
+
+
+//
+// save
+//
+// Writes the hierarchy to a binary file.  Returns false if the
+// hierarchy has not been built or the file could not be written.
+//
+bool ContractionHierarchy::save(string filename) const
+{
+  if (!built)
+    return false;
+
+  string payload;
+
+  writeVector(payload, rank);
+  writeVector(payload, edges);
+  writeVector(payload, upOffsets);
+  writeVector(payload, upEdges);
+  writeVector(payload, downOffsets);
+  writeVector(payload, downEdges);
+
+  ChHeader header;
+  memcpy(header.magic, CH_MAGIC, sizeof(CH_MAGIC));
+  header.numVertices = numVertices;
+  header.fingerprint = fingerprint;
+  header.payloadSize = payload.size();
+  header.checksum = checksum(payload.data(), payload.size());
+
+  ofstream file(filename, ios::binary);
+
+  if (!file.good())
+    return false;
+
+  file.write((const char*)&header, sizeof(header));
+  file.write(payload.data(), payload.size());
+
+  return file.good();
+}
+
+
+//
+// load
+//
+// Reads a hierarchy saved by save().  Returns false, leaving the
+// hierarchy unbuilt, if the file is missing or damaged, or if it was
+// built from a different graph than G.
+//
+bool ContractionHierarchy::load(string filename, const graph<long long, double>& G)
+{
+  built = false;
+
+  ifstream file(filename, ios::binary);
+
+  if (!file.good())
+    return false;
+
+  ChHeader header;
+  file.read((char*)&header, sizeof(header));
+
+  if (!file || memcmp(header.magic, CH_MAGIC, sizeof(CH_MAGIC)) != 0)
+    return false;
+
+  if (header.numVertices != (uint64_t)G.NumVertices() || header.fingerprint != graphFingerprint(G))
+    return false;
+
+  file.seekg(0, ios::end);
+  streampos end = file.tellg();
+  file.seekg(sizeof(header));
+
+  if (!file || header.payloadSize != (uint64_t)end - sizeof(header))
+    return false;
+
+  string payload(header.payloadSize, '\0');
+  file.read(payload.data(), payload.size());
+
+  if (!file || checksum(payload.data(), payload.size()) != header.checksum)
+    return false;
+
+  numVertices = header.numVertices;
+  fingerprint = header.fingerprint;
+
+  //
+  // the checksum matches, but check the structure anyway before
+  // trusting any index in it:
+  //
+  uint64_t edgeLimit = 1ULL << 32;
+  size_t pos = 0;
+
+  bool ok = readVector(payload, pos, rank, numVertices)
+    && readVector(payload, pos, edges, edgeLimit)
+    && readVector(payload, pos, upOffsets, numVertices + 1)
+    && readVector(payload, pos, upEdges, edgeLimit)
+    && readVector(payload, pos, downOffsets, numVertices + 1)
+    && readVector(payload, pos, downEdges, edgeLimit)
+    && pos == payload.size();
+
+  ok = ok && rank.size() == numVertices
+    && upOffsets.size() == numVertices + 1 && upOffsets.back() == upEdges.size()
+    && downOffsets.size() == numVertices + 1 && downOffsets.back() == downEdges.size();
+
+  vector<bool> ranked(ok ? numVertices : 0, false);
+
+  for (size_t i = 0; ok && i < rank.size(); i++)
+  {
+    ok = rank[i] < numVertices && !ranked[rank[i]];
+    if (ok)
+      ranked[rank[i]] = true;
+  }
+  for (size_t i = 0; ok && i < edges.size(); i++)
+  {
+    const ChEdge& e = edges[i];
+    ok = e.from < numVertices && e.to < numVertices
+      && (e.child1 == NO_EDGE || (e.child1 < i && e.child2 < i));
+  }
+  for (size_t i = 0; ok && i < numVertices; i++)
+  {
+    ok = upOffsets[i] <= upOffsets[i + 1] && downOffsets[i] <= downOffsets[i + 1];
+  }
+  for (size_t i = 0; ok && i < upEdges.size(); i++)
+  {
+    ok = upEdges[i] < edges.size();
+  }
+  for (size_t i = 0; ok && i < downEdges.size(); i++)
+  {
+    ok = downEdges[i] < edges.size();
+  }
+
+  if (!ok)
+  {
+    numVertices = 0;
+    rank.clear();
+    edges.clear();
+    return false;
+  }
+
+  prepareQueries();
+  built = true;
+  return true;
+}
+
+
+//
+// prepareQueries
+//
+// Copies the upward and downward edges into the arcs queries read, in
+// rank order, and sizes the query workspace for the current hierarchy.
+//
+void ContractionHierarchy::prepareQueries()
+{
+  vector<uint32_t> byRank(numVertices);
+  for (uint32_t v = 0; v < numVertices; v++)
+    byRank[rank[v]] = v;
+
+  upArcOffsets.assign(1, 0);
+  downArcOffsets.assign(1, 0);
+  upArcs.clear();
+  downArcs.clear();
+
+  for (uint32_t v : byRank)
+  {
+    for (uint32_t i = upOffsets[v]; i < upOffsets[v + 1]; i++)
+    {
+      uint32_t e = upEdges[i];
+      upArcs.push_back(QueryArc{rank[edges[e].to], e, edges[e].weight});
+    }
+
+    for (uint32_t i = downOffsets[v]; i < downOffsets[v + 1]; i++)
+    {
+      uint32_t e = downEdges[i];
+      downArcs.push_back(QueryArc{rank[edges[e].from], e, edges[e].weight});
+    }
+
+    upArcOffsets.push_back(upArcs.size());
+    downArcOffsets.push_back(downArcs.size());
+  }
+
+  generation = 0;
+
+  for (int side = 0; side < 2; side++)
+  {
+    dist[side].assign(numVertices, 0);
+    predEdge[side].assign(numVertices, NO_EDGE);
+    reachedStamp[side].assign(numVertices, 0);
+    heap[side] = dheap<double>(numVertices);
+  }
+}
+
+
+//
+// unpackEdge
+//
+// Appends the original vertices covered by edge e to the path, not
+// including the vertex the edge starts from.
+//
+void ContractionHierarchy::unpackEdge(uint32_t e, vector<uint32_t>& path) const
+{
+  if (edges[e].child1 == NO_EDGE)
+  {
+    path.push_back(edges[e].to);
+    return;
+  }
+
+  unpackEdge(edges[e].child1, path);
+  unpackEdge(edges[e].child2, path);
+}
+
+
+//
+// query
+//
+// Bidirectional upward search: the forward search from the source only
+// follows edges to higher ranked vertices, and so does the backward
+// search from the target over incoming edges.  Each side stops once
+// its smallest queued distance can no longer improve on the best
+// meeting point.  The path is unpacked into original vertices.
+//
+RouteInfo ContractionHierarchy::query(uint32_t source, uint32_t target)
+{
+  assert(isBuilt());
+
+  generation++;
+  if (generation == 0)
+  {
+    for (int side = 0; side < 2; side++)
+      fill(reachedStamp[side].begin(), reachedStamp[side].end(), 0);
+    generation = 1;
+  }
+
+  RouteInfo route;
+  uint32_t ends[2] = {rank[source], rank[target]};
+
+  for (int side = 0; side < 2; side++)
+  {
+    heap[side].clear();
+    dist[side][ends[side]] = 0;
+    predEdge[side][ends[side]] = NO_EDGE;
+    reachedStamp[side][ends[side]] = generation;
+    heap[side].pushOrDecrease(ends[side], 0);
+  }
+
+  double best = INF;
+  uint32_t meet = NO_VERTEX;
+
+  while (true)
+  {
+    bool forwardOpen = !heap[0].empty() && heap[0].topKey() < best;
+    bool backwardOpen = !heap[1].empty() && heap[1].topKey() < best;
+
+    if (!forwardOpen && !backwardOpen)
+      break;
+
+    int side = (forwardOpen && (!backwardOpen || heap[0].topKey() <= heap[1].topKey())) ? 0 : 1;
+    int other = 1 - side;
+
+    uint32_t currV = heap[side].pop();
+    route.Settled++;
+
+    if (reachedStamp[other][currV] == generation && dist[side][currV] + dist[other][currV] < best)
+    {
+      best = dist[side][currV] + dist[other][currV];
+      meet = currV;
+    }
+
+    const vector<uint32_t>& offsets = (side == 0) ? upArcOffsets : downArcOffsets;
+    const vector<QueryArc>& arcs = (side == 0) ? upArcs : downArcs;
+
+    //
+    // stall-on-demand: if a higher ranked vertex already reached by this
+    // side offers a shorter path to currV, currV is not on a shortest
+    // upward path and its edges need not be relaxed:
+    //
+    const vector<uint32_t>& stallOffsets = (side == 0) ? downArcOffsets : upArcOffsets;
+    const vector<QueryArc>& stallArcs = (side == 0) ? downArcs : upArcs;
+    bool stalled = false;
+
+    for (uint32_t i = stallOffsets[currV]; i < stallOffsets[currV + 1] && !stalled; i++)
+    {
+      const QueryArc& arc = stallArcs[i];
+
+      stalled = reachedStamp[side][arc.neighbor] == generation
+        && dist[side][arc.neighbor] + arc.weight < dist[side][currV];
+    }
+
+    if (stalled)
+      continue;
+
+    for (uint32_t i = offsets[currV]; i < offsets[currV + 1]; i++)
+    {
+      const QueryArc& arc = arcs[i];
+      uint32_t adjV = arc.neighbor;
+      double d = dist[side][currV] + arc.weight;
+
+      if (reachedStamp[side][adjV] != generation || d < dist[side][adjV])
+      {
+        dist[side][adjV] = d;
+        predEdge[side][adjV] = arc.edge;
+        reachedStamp[side][adjV] = generation;
+        heap[side].pushOrDecrease(adjV, d);
+      }
+    }
+  }
+
+  if (meet == NO_VERTEX)
+    return route;
+
+  route.Distance = best;
+
+  // edges from the source up to the meeting vertex, in path order
+  // (the workspace is indexed by rank):
+  vector<uint32_t> upPath;
+  for (uint32_t r = meet; predEdge[0][r] != NO_EDGE; r = rank[edges[predEdge[0][r]].from])
+    upPath.push_back(predEdge[0][r]);
+
+  reverse(upPath.begin(), upPath.end());
+
+  route.Path.push_back(source);
+  for (uint32_t e : upPath)
+    unpackEdge(e, route.Path);
+
+  // edges from the meeting vertex down to the target:
+  for (uint32_t r = meet; predEdge[1][r] != NO_EDGE; r = rank[edges[predEdge[1][r]].to])
+    unpackEdge(predEdge[1][r], route.Path);
+
+  return route;
+}
+
+
+//
+// isBuilt
+//
+// Returns true once the hierarchy has been built or loaded.
+//
+bool ContractionHierarchy::isBuilt() const
+{
+  return built;
+}
+
+
+//
+// numShortcuts
+//
+// Returns the number of shortcut edges in the hierarchy, including
+// shortcuts later replaced by shorter ones.
+//
+size_t ContractionHierarchy::numShortcuts() const
+{
+  size_t count = 0;
+
+  for (const ChEdge& e : edges)
+  {
+    if (e.child1 != NO_EDGE)
+      count++;
+  }
+
+  return count;
+}
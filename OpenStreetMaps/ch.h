@@ -0,0 +1,103 @@
+/*ch.h*/
+
+//
+// Contraction hierarchy over the frozen footway graph.
+//
+// Preprocessing contracts the vertices one at a time, least important
+// first.  Contracting v removes it from the remaining graph; for every
+// pair of neighbors u -> v -> w whose shortest path runs through v, a
+// shortcut edge u -> w is added so distances among the remaining
+// vertices are preserved.  The order in which vertices are contracted
+// is their rank.
+//
+// A query runs Dijkstra upward (toward higher ranks) from both the
+// source and the target; the two searches meet at the highest ranked
+// vertex of the shortest path and together settle a small fraction of
+// the vertices Dijkstra would.  Every shortcut remembers the two edges
+// it replaces, so the route is unpacked back into original vertices.
+//
+// The hierarchy can be saved to disk and loaded back, so preprocessing
+// runs once per map.  The saved file records a fingerprint of the graph
+// and a checksum of its contents, and is rejected if it is damaged or
+// the graph has changed since.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "graph.h"
+#include "dheap.h"
+#include "router.h"
+
+using namespace std;
+
+class ContractionHierarchy {
+  private:
+    //
+    // Edge of the hierarchy, either an original edge of the graph or a
+    // shortcut that replaces the edges child1 and child2.
+    //
+    struct ChEdge {
+      uint32_t from;
+      uint32_t to;
+      double weight;
+      uint32_t child1;  // NO_EDGE for original edges
+      uint32_t child2;
+    };
+
+    //
+    // Edge of the upward or downward graph as a query reads it: the
+    // rank of the vertex at its higher ranked end and its weight, copied
+    // out of edges so that a vertex's edges are read from one place.
+    //
+    struct QueryArc {
+      uint32_t neighbor;
+      uint32_t edge;    // index in edges, for unpacking the path
+      double weight;
+    };
+
+    static constexpr uint32_t NO_EDGE = NO_VERTEX;
+
+    uint32_t numVertices;
+    bool built;                 // by build() or a successful load()
+    uint64_t fingerprint;       // of the graph the hierarchy was built from
+    vector<uint32_t> rank;      // contraction order of each vertex
+    vector<ChEdge> edges;
+    vector<uint32_t> upOffsets;    // per vertex, range of upEdges
+    vector<uint32_t> upEdges;      // edges v -> w with rank[w] > rank[v]
+    vector<uint32_t> downOffsets;  // per vertex, range of downEdges
+    vector<uint32_t> downEdges;    // edges u -> v with rank[u] > rank[v]
+
+    // query workspace, reset lazily by generation as in Router.  Queries
+    // number vertices by rank, so the upward searches, which mostly
+    // visit high ranked vertices, stay near one end of the arrays.
+    vector<uint32_t> upArcOffsets;    // per rank, range of upArcs
+    vector<QueryArc> upArcs;          // upEdges as arcs
+    vector<uint32_t> downArcOffsets;  // per rank, range of downArcs
+    vector<QueryArc> downArcs;        // downEdges as arcs
+    uint32_t generation;
+    vector<double> dist[2];
+    vector<uint32_t> predEdge[2];
+    vector<uint32_t> reachedStamp[2];
+    dheap<double> heap[2];
+
+    void prepareQueries();
+    void unpackEdge(uint32_t e, vector<uint32_t>& path) const;
+
+  public:
+    ContractionHierarchy();
+
+    void build(const graph<long long, double>& G);
+    bool save(string filename) const;
+    bool load(string filename, const graph<long long, double>& G);
+
+    RouteInfo query(uint32_t source, uint32_t target);
+
+    bool isBuilt() const;
+    size_t numShortcuts() const;
+};
+
+uint64_t graphFingerprint(const graph<long long, double>& G);
@@ -0,0 +1,177 @@
+/*components.cpp*/
+
+//
+// Connected components of the footway graph, see components.h.
+//
+
+#include <vector>
+#include <utility>
+#include <cassert>
+
+#include "components.h"
+
+using namespace std;
+
+
+//
+// ComponentIndex
+//
+ComponentIndex::ComponentIndex()
+  : numComponents(0)
+{
+}
+
+
+//
+// find
+//
+// Returns the root of v's set, pointing every node on the way at its
+// grandparent (path halving) so later finds take fewer steps.
+//
+uint32_t ComponentIndex::find(uint32_t v)
+{
+  while (parent[v] != v)
+  {
+    parent[v] = parent[parent[v]];
+    v = parent[v];
+  }
+
+  return v;
+}
+
+
+//
+// addNode
+//
+// Adds a node as a component of its own and returns its index, or
+// returns the existing index if the node was already added.
+//
+uint32_t ComponentIndex::addNode(long long id)
+{
+  auto result = indices.emplace(id, (uint32_t)parent.size());
+
+  if (result.second)
+  {
+    parent.push_back(result.first->second);
+    setSize.push_back(1);
+    numComponents++;
+  }
+
+  return result.first->second;
+}
+
+
+//
+// addEdge
+//
+// Merges the components of the two nodes, attaching the smaller set
+// below the larger.  Returns false if either node was never added.
+//
+bool ComponentIndex::addEdge(long long from, long long to)
+{
+  auto it1 = indices.find(from);
+  auto it2 = indices.find(to);
+
+  if (it1 == indices.end() || it2 == indices.end())
+    return false;
+
+  uint32_t root1 = find(it1->second);
+  uint32_t root2 = find(it2->second);
+
+  if (root1 != root2)
+  {
+    if (setSize[root1] < setSize[root2])
+      swap(root1, root2);
+
+    parent[root2] = root1;
+    setSize[root1] += setSize[root2];
+    numComponents--;
+  }
+
+  return true;
+}
+
+
+//
+// flatten
+//
+// Points every node directly at its root, so until the next addEdge a
+// component lookup is a single array access.
+//
+void ComponentIndex::flatten()
+{
+  for (uint32_t v = 0; v < parent.size(); v++)
+  {
+    parent[v] = find(v);
+  }
+}
+
+
+//
+// clear
+//
+void ComponentIndex::clear()
+{
+  indices.clear();
+  parent.clear();
+  setSize.clear();
+  numComponents = 0;
+}
+
+
+//
+// component
+//
+// Returns the component label of node v (by index); two nodes are in
+// the same component exactly when their labels are equal.
+//
+uint32_t ComponentIndex::component(uint32_t v)
+{
+  assert(v < parent.size());
+
+  return find(v);
+}
+
+
+//
+// connected
+//
+// Returns true if nodes v1 and v2 (by index) are in the same component.
+//
+bool ComponentIndex::connected(uint32_t v1, uint32_t v2)
+{
+  return component(v1) == component(v2);
+}
+
+
+//
+// componentSize
+//
+// Returns the number of nodes in v's component.
+//
+size_t ComponentIndex::componentSize(uint32_t v)
+{
+  return setSize[component(v)];
+}
+
+
+//
+// count
+//
+// Returns the number of components.
+//
+size_t ComponentIndex::count() const
+{
+  return numComponents;
+}
+
+
+//
+// size
+//
+// Returns the number of nodes.
+//
+size_t ComponentIndex::size() const
+{
+  return parent.size();
+}
@@ -0,0 +1,45 @@
+/*components.h*/
+
+//
+// Connected components of the footway graph, kept in a union-find
+// (disjoint set) structure that is updated as edges are added.  Two
+// nodes can reach each other exactly when they are in the same
+// component (footway edges always come in pairs, one each way), so
+// reachability is answered without running a search.
+//
+// Nodes are numbered in the order they are added.  populateGraph adds
+// them in sorted ID order, the same order freeze() uses, so the
+// numbers are the dense indices of the frozen graph.
+//
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+class ComponentIndex {
+  private:
+    unordered_map<long long, uint32_t> indices;  // node ID -> index
+    vector<uint32_t> parent;   // union-find forest; roots are their own parent
+    vector<uint32_t> setSize;  // number of nodes in the set, valid for roots
+    size_t numComponents;
+
+    uint32_t find(uint32_t v);
+
+  public:
+    ComponentIndex();
+
+    uint32_t addNode(long long id);
+    bool addEdge(long long from, long long to);
+    void flatten();
+    void clear();
+
+    uint32_t component(uint32_t v);
+    bool connected(uint32_t v1, uint32_t v2);
+    size_t componentSize(uint32_t v);
+    size_t count() const;
+    size_t size() const;
+};
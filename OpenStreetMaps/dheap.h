@@ -0,0 +1,168 @@
+// dheap.h
+//
+// Indexed d-ary min-heap over the items 0..N-1, used as the priority
+// queue of the routing engine.  Each item appears at most once, and its
+// position in the heap is tracked so that its key can be decreased in
+// place instead of pushing duplicate entries.
+//
+// A larger arity D makes the heap shallower, which speeds up insert and
+// decrease-key (the common operations in Dijkstra) at a small cost to
+// pop.  D = 4 keeps the children of a node in one cache line.
+//
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+using namespace std;
+
+template<typename KeyT, int D = 4>
+class dheap {
+  private:
+    static constexpr uint32_t NOT_IN_HEAP = numeric_limits<uint32_t>::max();
+
+    vector<KeyT> keys;          // key of each heap slot
+    vector<uint32_t> items;     // item stored in each heap slot
+    vector<uint32_t> position;  // heap slot of each item, or NOT_IN_HEAP
+
+    /// @brief Store an item and its key in a heap slot, updating its position
+    void place(size_t slot, uint32_t item, KeyT key) {
+      keys[slot] = key;
+      items[slot] = item;
+      position[item] = slot;
+    }
+
+    /// @brief Move the item at a slot up until its parent is not larger
+    void siftUp(size_t slot) {
+      uint32_t item = items[slot];
+      KeyT key = keys[slot];
+
+      while (slot > 0) {
+        size_t parent = (slot - 1) / D;
+        if (!(key < keys[parent])) {
+          break;
+        }
+        place(slot, items[parent], keys[parent]);
+        slot = parent;
+      }
+
+      place(slot, item, key);
+    }
+
+    /// @brief Move the item at a slot down until none of its children are smaller
+    void siftDown(size_t slot) {
+      uint32_t item = items[slot];
+      KeyT key = keys[slot];
+      size_t count = items.size();
+
+      while (true) {
+        size_t firstChild = slot * D + 1;
+        if (firstChild >= count) {
+          break;
+        }
+
+        // Find the smallest of up to D children
+        size_t lastChild = min(firstChild + D, count);
+        size_t best = firstChild;
+        for (size_t child = firstChild + 1; child < lastChild; child++) {
+          if (keys[child] < keys[best]) {
+            best = child;
+          }
+        }
+
+        if (!(keys[best] < key)) {
+          break;
+        }
+        place(slot, items[best], keys[best]);
+        slot = best;
+      }
+
+      place(slot, item, key);
+    }
+
+  public:
+
+    /// @brief Create an empty heap for the items 0..capacity-1
+    /// @param capacity Number of distinct items that may be stored
+    explicit dheap(size_t capacity = 0) {
+      position.assign(capacity, NOT_IN_HEAP);
+    }
+
+    /// @brief Returns true if the heap holds no items
+    bool empty() const {
+      return items.empty();
+    }
+
+    /// @brief Returns number of items in the heap
+    size_t size() const {
+      return items.size();
+    }
+
+    /// @brief Check if an item is currently in the heap
+    bool contains(uint32_t item) const {
+      return position[item] != NOT_IN_HEAP;
+    }
+
+    /// @brief Insert an item, or lower its key if it is already in the heap
+    /// @param item Item to insert, must be less than the heap capacity
+    /// @param key Priority of the item, smaller keys are popped first
+    /// @return True if the item was inserted or its key decreased
+    bool pushOrDecrease(uint32_t item, KeyT key) {
+      if (position[item] == NOT_IN_HEAP) {
+        keys.push_back(key);
+        items.push_back(item);
+        position[item] = items.size() - 1;
+        siftUp(items.size() - 1);
+        return true;
+      }
+
+      size_t slot = position[item];
+      if (!(key < keys[slot])) {
+        return false;
+      }
+      keys[slot] = key;
+      siftUp(slot);
+      return true;
+    }
+
+    /// @brief Returns the item with the smallest key, heap must not be empty
+    uint32_t top() const {
+      return items[0];
+    }
+
+    /// @brief Returns the smallest key, heap must not be empty
+    KeyT topKey() const {
+      return keys[0];
+    }
+
+    /// @brief Remove and return the item with the smallest key, heap must not be empty
+    uint32_t pop() {
+      uint32_t item = items[0];
+      position[item] = NOT_IN_HEAP;
+
+      uint32_t lastItem = items.back();
+      KeyT lastKey = keys.back();
+      items.pop_back();
+      keys.pop_back();
+
+      // Move the last item to the root and restore the heap order
+      if (!items.empty()) {
+        place(0, lastItem, lastKey);
+        siftDown(0);
+      }
+
+      return item;
+    }
+
+    /// @brief Remove all items, in time proportional to the number of items left
+    void clear() {
+      for (uint32_t item : items) {
+        position[item] = NOT_IN_HEAP;
+      }
+      items.clear();
+      keys.clear();
+    }
+};
@@ -10,11 +10,56 @@
 // University of Illinois at Chicago
 //
 
+#pragma once
+
 #include <iostream>
 #include <cmath>
+#include <cstddef>
 #include "osm.h"
 
 using namespace std;
 
 double distBetween2Points(double lat1, double long1, double lat2, double long2);
+
+//
+// TrigCoordinates
+//
+// The sines and cosines distBetween2Points needs for one point,
+// computed once so that distances between precomputed points take a
+// few multiplications and a single acos.  (X, Y, SinLat) is also the
+// point's position on the unit sphere.
+//
+struct TrigCoordinates
+{
+  double X;       // cos(lat) * cos(lon)
+  double Y;       // cos(lat) * sin(lon)
+  double SinLat;
+  double CosLat;
+  double CosLon;
+  double SinLon;
+};
+
+TrigCoordinates toTrigCoordinates(double lat, double lon);
+double distBetween2Points(const TrigCoordinates& p1, const TrigCoordinates& p2);
 Coordinates centerBetween2Points(double lat1, double long1, double lat2, double long2);
+
+//
+// Batch kernels: one query point against arrays of latitudes and
+// longitudes (in degrees), see dist.cpp.
+//
+void approxDistancesFrom(double lat, double lon, const double* lats, const double* lons, size_t n, double* dists);
+
+//
+// The kernels approxDistancesFrom picks from, by name, so that they can
+// be checked against each other.  SSE2 and AVX2 exist only on x86-64,
+// AVX2 (which also uses FMA) only on CPUs that have both.
+//
+enum class DistKernel {
+  SCALAR,
+  SSE2,
+  AVX2
+};
+
+bool hasDistKernel(DistKernel kernel);
+void approxDistancesWith(DistKernel kernel, double lat, double lon, const double* lats, const double* lons, size_t n, double* dists);
+size_t nearestOf(double lat, double lon, const double* lats, const double* lons, size_t n);
@@ -0,0 +1,378 @@
+/*geoindex.cpp*/
+
+//
+// Spatial index over map positions, see geoindex.h.
+//
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#include "geoindex.h"
+#include "dist.h"
+
+using namespace std;
+
+
+//
+// Constants shared with distBetween2Points.
+//
+static const double PI = 3.14159265;
+static const double EARTH_RAD = 3963.1;
+
+
+//
+// coordinate
+//
+// Returns the x, y or z coordinate (axis 0, 1 or 2) of a point on the
+// unit sphere.
+//
+static double coordinate(const TrigCoordinates& p, int axis)
+{
+  return (axis == 0) ? p.X : (axis == 1) ? p.Y : p.SinLat;
+}
+
+
+//
+// chordBound
+//
+// Converts a distance in miles into the largest chord between unit
+// vectors that might still be that close.  The slack covers rounding in
+// the acos formula, which loses precision for nearby points.
+//
+static double chordBound(double miles)
+{
+  double angle = min(miles / EARTH_RAD, PI);
+
+  return 2.0 * sin(angle / 2.0) * (1.0 + 1e-9) + 1e-7;
+}
+
+
+//
+// arcBound
+//
+// The reverse of chordBound: converts a chord between unit vectors into
+// the smallest distance in miles that distBetween2Points might report
+// for points at least that far apart.
+//
+static double arcBound(double chord)
+{
+  double angle = 2.0 * asin(min(chord / 2.0, 1.0));
+
+  return max(0.0, (angle * (1.0 - 1e-9) - 1e-7) * EARTH_RAD);
+}
+
+
+//
+// exactDistance
+//
+// distBetween2Points from the query to a point, from the precomputed
+// trig of both; acos of a value rounded just past 1 is NaN, for (nearly)
+// identical points, which counts as 0.
+//
+static double exactDistance(const TrigCoordinates& query, const TrigCoordinates& p)
+{
+  double dist = distBetween2Points(query, p);
+
+  return isnan(dist) ? 0 : dist;
+}
+
+
+//
+// operator<
+//
+bool GeoIndex::Candidate::operator<(const Candidate& other) const
+{
+  if (Dist != other.Dist)
+    return Dist < other.Dist;
+
+  return Rank < other.Rank;
+}
+
+
+//
+// build
+//
+// Indexes positions[i] as item items[i].  When two items are equally
+// close to a query, the one that comes first here wins.
+//
+void GeoIndex::build(const vector<Coordinates>& positions, const vector<uint32_t>& items)
+{
+  assert(positions.size() == items.size());
+
+  points.clear();
+  points.reserve(positions.size());
+
+  for (size_t i = 0; i < positions.size(); i++)
+  {
+    points.push_back(Point{toTrigCoordinates(positions[i].Lat, positions[i].Lon), items[i], (uint32_t)i});
+  }
+
+  axes.assign(points.size(), 0);
+  buildRange(0, points.size());
+}
+
+
+//
+// buildRange
+//
+// Arranges points[first, last) into a k-d tree: the middle element
+// becomes the split point along the axis where the range is widest,
+// with smaller coordinates before it and larger ones after.
+//
+void GeoIndex::buildRange(size_t first, size_t last)
+{
+  if (last - first <= 1)
+    return;
+
+  double low[3] = {INFINITY, INFINITY, INFINITY};
+  double high[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+  for (size_t i = first; i < last; i++)
+  {
+    for (int axis = 0; axis < 3; axis++)
+    {
+      double c = coordinate(points[i].Trig, axis);
+      low[axis] = min(low[axis], c);
+      high[axis] = max(high[axis], c);
+    }
+  }
+
+  int axis = 0;
+
+  for (int a = 1; a < 3; a++)
+  {
+    if (high[a] - low[a] > high[axis] - low[axis])
+      axis = a;
+  }
+
+  size_t middle = first + (last - first) / 2;
+
+  nth_element(points.begin() + first, points.begin() + middle, points.begin() + last,
+    [axis](const Point& p1, const Point& p2)
+    {
+      return coordinate(p1.Trig, axis) < coordinate(p2.Trig, axis);
+    });
+
+  axes[middle] = axis;
+
+  buildRange(first, middle);
+  buildRange(middle + 1, last);
+}
+
+
+//
+// searchRange
+//
+// Adds the points of points[first, last) that belong among the k
+// nearest to the query into best, a max-heap of at most k candidates.
+// The half of the range on the query's side of the split is searched
+// first; the other half only if the split plane is close enough.
+//
+void GeoIndex::searchRange(size_t first, size_t last, const Point& query, size_t k,
+                           vector<Candidate>& best) const
+{
+  if (first >= last)
+    return;
+
+  size_t middle = first + (last - first) / 2;
+  const Point& p = points[middle];
+
+  Candidate candidate{exactDistance(query.Trig, p.Trig), p.Rank, p.Item};
+
+  if (best.size() < k)
+  {
+    best.push_back(candidate);
+    push_heap(best.begin(), best.end());
+  }
+  else if (candidate < best.front())
+  {
+    pop_heap(best.begin(), best.end());
+    best.back() = candidate;
+    push_heap(best.begin(), best.end());
+  }
+
+  if (last - first == 1)
+    return;
+
+  int axis = axes[middle];
+  double offset = coordinate(query.Trig, axis) - coordinate(p.Trig, axis);
+
+  size_t nearFirst = first, nearLast = middle;
+  size_t farFirst = middle + 1, farLast = last;
+
+  if (offset > 0)
+  {
+    swap(nearFirst, farFirst);
+    swap(nearLast, farLast);
+  }
+
+  searchRange(nearFirst, nearLast, query, k, best);
+
+  if (best.size() < k || fabs(offset) <= chordBound(best.front().Dist))
+    searchRange(farFirst, farLast, query, k, best);
+}
+
+
+//
+// nearest
+//
+// Returns the item nearest to (lat, lon), or NO_ITEM if the index is
+// empty.
+//
+uint32_t GeoIndex::nearest(double lat, double lon) const
+{
+  vector<uint32_t> found = kNearest(lat, lon, 1);
+
+  return found.empty() ? NO_ITEM : found[0];
+}
+
+
+//
+// kNearest
+//
+// Returns the (at most) k items nearest to (lat, lon), nearest first.
+//
+vector<uint32_t> GeoIndex::kNearest(double lat, double lon, size_t k) const
+{
+  vector<uint32_t> found;
+
+  if (k == 0)
+    return found;
+
+  Point query{toTrigCoordinates(lat, lon), NO_ITEM, 0};
+
+  vector<Candidate> best;
+  best.reserve(k + 1);
+  searchRange(0, points.size(), query, k, best);
+
+  sort_heap(best.begin(), best.end());
+
+  for (const Candidate& candidate : best)
+    found.push_back(candidate.Item);
+
+  return found;
+}
+
+
+//
+// nearestFirst
+//
+// Returns a cursor that enumerates all items, nearest to (lat, lon)
+// first.
+//
+GeoIndex::NearestCursor GeoIndex::nearestFirst(double lat, double lon) const
+{
+  return NearestCursor(*this, lat, lon);
+}
+
+
+//
+// size
+//
+// Returns the number of indexed positions.
+//
+size_t GeoIndex::size() const
+{
+  return points.size();
+}
+
+
+//
+// operator>
+//
+bool GeoIndex::NearestCursor::Entry::operator>(const Entry& other) const
+{
+  if (Key != other.Key)
+    return Key > other.Key;
+
+  if (IsPoint != other.IsPoint)
+    return IsPoint;
+
+  return Rank > other.Rank;
+}
+
+
+//
+// NearestCursor
+//
+// Starts with the whole tree queued, at distance 0.
+//
+GeoIndex::NearestCursor::NearestCursor(const GeoIndex& index, double lat, double lon)
+  : index(&index), query{toTrigCoordinates(lat, lon), NO_ITEM, 0}, lastDist(INFINITY)
+{
+  if (!index.points.empty())
+    push(Entry{0, false, 0, 0, (uint32_t)index.points.size()});
+}
+
+
+//
+// push
+//
+void GeoIndex::NearestCursor::push(const Entry& entry)
+{
+  queue.push_back(entry);
+  push_heap(queue.begin(), queue.end(), greater<Entry>());
+}
+
+
+//
+// next
+//
+// Returns the next closest item, or NO_ITEM once every item has been
+// returned.  Ranges are opened until a point is at the front of the
+// queue; since every range is keyed below any point it holds, nothing
+// still queued can be closer.
+//
+uint32_t GeoIndex::NearestCursor::next()
+{
+  while (!queue.empty())
+  {
+    pop_heap(queue.begin(), queue.end(), greater<Entry>());
+    Entry entry = queue.back();
+    queue.pop_back();
+
+    if (entry.IsPoint)
+    {
+      lastDist = entry.Key;
+      return index->points[entry.First].Item;
+    }
+
+    size_t first = entry.First, last = entry.Last;
+    size_t middle = first + (last - first) / 2;
+    const Point& p = index->points[middle];
+
+    push(Entry{exactDistance(query.Trig, p.Trig), true, p.Rank, (uint32_t)middle, 0});
+
+    if (last - first == 1)
+      continue;
+
+    int axis = index->axes[middle];
+    double offset = coordinate(query.Trig, axis) - coordinate(p.Trig, axis);
+    double farKey = max(entry.Key, arcBound(fabs(offset)));
+
+    // the side of the split holding the query keeps the bound of the whole range:
+    double lowKey = (offset > 0) ? farKey : entry.Key;
+    double highKey = (offset > 0) ? entry.Key : farKey;
+
+    if (first < middle)
+      push(Entry{lowKey, false, 0, (uint32_t)first, (uint32_t)middle});
+    if (middle + 1 < last)
+      push(Entry{highKey, false, 0, (uint32_t)(middle + 1), (uint32_t)last});
+  }
+
+  lastDist = INFINITY;
+  return NO_ITEM;
+}
+
+
+//
+// distance
+//
+// Returns the distance in miles of the item last returned by next().
+//
+double GeoIndex::NearestCursor::distance() const
+{
+  return lastDist;
+}
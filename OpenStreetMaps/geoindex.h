@@ -0,0 +1,105 @@
+/*geoindex.h*/
+
+//
+// Spatial index over map positions, for nearest-neighbor queries.
+//
+// Positions are stored as points on the unit sphere in a k-d tree
+// (balanced, laid out implicitly in one array: the median of every
+// range splits it in two).  The straight-line (chord) distance between
+// unit vectors grows with the great-circle distance, so a branch of the
+// tree can be skipped as soon as the splitting plane is farther away
+// than the best candidate found so far.
+//
+// Candidates are compared with distBetween2Points, the same distance
+// the linear scans used, and ties go to the item added first, so the
+// index returns exactly what a scan in insertion order would.  Each
+// point keeps its precomputed trig, so measuring it costs one acos.
+//
+// Besides the k nearest items, the index can enumerate items one at a
+// time in order of distance (a NearestCursor): only as much of the
+// tree is opened as the items pulled so far require, so asking for the
+// next closest item after rejecting one costs about as much as the
+// first.
+//
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "osm.h"
+#include "dist.h"
+
+using namespace std;
+
+class GeoIndex {
+  private:
+    struct Point {
+      TrigCoordinates Trig;  // unit sphere position and trig for the exact distance
+      uint32_t Item;         // caller's item number
+      uint32_t Rank;         // insertion order, breaks ties
+    };
+
+    //
+    // Item found by a query, ordered by distance and then rank.
+    //
+    struct Candidate {
+      double Dist;
+      uint32_t Rank;
+      uint32_t Item;
+
+      bool operator<(const Candidate& other) const;
+    };
+
+    vector<Point> points;   // k-d tree, each range split at its middle element
+    vector<uint8_t> axes;   // split axis of the middle element of each range
+
+    void buildRange(size_t first, size_t last);
+    void searchRange(size_t first, size_t last, const Point& query, size_t k,
+                     vector<Candidate>& best) const;
+
+  public:
+    static constexpr uint32_t NO_ITEM = 0xFFFFFFFF;
+
+    //
+    // Enumerates the items of an index from nearest to farthest from a
+    // query position.  The index must outlive the cursor.
+    //
+    class NearestCursor {
+      private:
+        //
+        // Queued range of the tree, keyed by a lower bound on the
+        // distance of its points, or a single point keyed by its exact
+        // distance.  A range is opened before a point with the same key.
+        //
+        struct Entry {
+          double Key;
+          bool IsPoint;
+          uint32_t Rank;
+          uint32_t First, Last;  // range [First, Last) or, for a point, its position in First
+
+          bool operator>(const Entry& other) const;
+        };
+
+        const GeoIndex* index;
+        Point query;
+        vector<Entry> queue;   // min-heap
+        double lastDist;
+
+        void push(const Entry& entry);
+
+      public:
+        NearestCursor(const GeoIndex& index, double lat, double lon);
+
+        uint32_t next();
+        double distance() const;
+    };
+
+    void build(const vector<Coordinates>& positions, const vector<uint32_t>& items);
+
+    uint32_t nearest(double lat, double lon) const;
+    vector<uint32_t> kNearest(double lat, double lon, size_t k) const;
+    NearestCursor nearestFirst(double lat, double lon) const;
+
+    size_t size() const;
+};
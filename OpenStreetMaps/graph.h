@@ -5,6 +5,17 @@
 // Contains helper function to construct, edit and retrieve 
 // information for the graph
 //
+// Once fully built, a graph can be frozen into a compressed-sparse-row
+// (CSR) layout: vertices are numbered 0..V-1 in sorted order, and the
+// edges of vertex i are stored contiguously in [offsets[i], offsets[i+1])
+// of the neighbor and weight arrays.  The reverse (incoming) edges are
+// stored the same way for searches that run backward from a target.
+// A frozen graph is immutable.
+//
+// Every change to the graph bumps its version number, so results
+// computed from the graph (such as cached shortest-path trees) can tell
+// whether they are still current.
+//
 // Adam T Koehler, PhD
 // University of Illinois Chicago
 // CS 251, Fall 2023
@@ -20,6 +31,9 @@
 #include <stdexcept>
 #include <map>
 #include <set>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
 
 using namespace std;
 
@@ -28,12 +42,135 @@ class graph {
   private:
     map<VertexT, map<VertexT, WeightT>> adjList;
     vector<VertexT> verticesList;
+    uint64_t versionNumber;  // bumped by every change to the graph
+
+    // Frozen CSR representation, only valid when frozen is true
+    bool frozen;
+    vector<VertexT> sortedVertices;  // dense index -> vertex, sorted
+    vector<size_t> rowOffsets;       // size V+1, edge range of each vertex
+    vector<uint32_t> colIndices;     // dense index of each edge's target
+    vector<WeightT> edgeWeights;     // weight of each edge
+    vector<size_t> revOffsets;       // size V+1, incoming edge range of each vertex
+    vector<uint32_t> revIndices;     // dense index of each incoming edge's source
+    vector<WeightT> revWeights;      // weight of each incoming edge
+
+    /// @brief Find the dense index of a vertex in a frozen graph
+    /// @param v Vertex to look up
+    /// @param index Passed-by-reference variable to store the dense index
+    /// @return True if the vertex exists in the graph
+    bool findIndex(VertexT v, uint32_t& index) const {
+      auto it = lower_bound(sortedVertices.begin(), sortedVertices.end(), v);
+
+      if (it == sortedVertices.end() || *it != v) {
+        return false;
+      }
+
+      index = (uint32_t)(it - sortedVertices.begin());
+      return true;
+    }
+
+    /// @brief Find the position of an edge in the CSR arrays of a frozen graph
+    /// @param from Dense index of the vertex that the edge starts from
+    /// @param to Dense index of the vertex that the edge points to
+    /// @return Position of the edge, or colIndices.size() if there is no such edge
+    size_t findEdge(uint32_t from, uint32_t to) const {
+      // Rows are sorted by target index, so binary search within the row
+      auto first = colIndices.begin() + rowOffsets[from];
+      auto last = colIndices.begin() + rowOffsets[from + 1];
+      auto it = lower_bound(first, last, to);
+
+      if (it == last || *it != to) {
+        return colIndices.size();
+      }
+
+      return it - colIndices.begin();
+    }
+
+    /// @brief Build the reverse (incoming) CSR rows from the forward rows
+    void buildReverseRows() {
+      // Build the reverse rows by counting the incoming edges of each vertex
+      size_t numVertices = sortedVertices.size();
+      revOffsets.assign(numVertices + 1, 0);
+      for (uint32_t target : colIndices) {
+        revOffsets[target + 1]++;
+      }
+      for (size_t i = 0; i < numVertices; i++) {
+        revOffsets[i + 1] += revOffsets[i];
+      }
+
+      // Scan sources in order so every reverse row ends up sorted by source
+      vector<size_t> next(revOffsets.begin(), revOffsets.end() - 1);
+      revIndices.resize(colIndices.size());
+      revWeights.resize(colIndices.size());
+      for (uint32_t from = 0; from < numVertices; from++) {
+        for (size_t e = rowOffsets[from]; e < rowOffsets[from + 1]; e++) {
+          size_t slot = next[colIndices[e]]++;
+          revIndices[slot] = from;
+          revWeights[slot] = edgeWeights[e];
+        }
+      }
+    }
 
   public:
 
+    /// @brief An outgoing edge of a frozen graph, read straight from the CSR arrays
+    struct Edge {
+      uint32_t neighbor;  // dense index of the neighbor vertex
+      WeightT weight;     // weight of the edge
+    };
+
+    /// @brief Forward iterator over the edges of one CSR row
+    class EdgeIterator {
+      private:
+        const uint32_t* col;
+        const WeightT* weight;
+
+      public:
+        EdgeIterator(const uint32_t* col, const WeightT* weight) : col(col), weight(weight) {}
+
+        Edge operator*() const {
+          return Edge{*col, *weight};
+        }
+
+        EdgeIterator& operator++() {
+          col++;
+          weight++;
+          return *this;
+        }
+
+        bool operator!=(const EdgeIterator& other) const {
+          return col != other.col;
+        }
+    };
+
+    /// @brief Range of the outgoing edges of one vertex, usable in range-based for loops
+    class EdgeRange {
+      private:
+        EdgeIterator first;
+        EdgeIterator last;
+        size_t count;
+
+      public:
+        EdgeRange(EdgeIterator first, EdgeIterator last, size_t count) : first(first), last(last), count(count) {}
+
+        EdgeIterator begin() const {
+          return first;
+        }
+
+        EdgeIterator end() const {
+          return last;
+        }
+
+        size_t size() const {
+          return count;
+        }
+    };
+
     /// @brief Empty constructor for the graph
     graph() {
       adjList = {}; 
+      frozen = false;
+      versionNumber = 0;
     }
     
     /// @brief Delete all graph data, including its keys (vertices) and values (maps of vertex neighbors) 
@@ -44,6 +181,18 @@ class graph {
       }
 
       adjList.clear();
+      verticesList.clear();
+      versionNumber++;
+
+      // Drop the frozen representation, the graph is editable again
+      frozen = false;
+      sortedVertices.clear();
+      rowOffsets.clear();
+      colIndices.clear();
+      edgeWeights.clear();
+      revOffsets.clear();
+      revIndices.clear();
+      revWeights.clear();
     }
     
     /// @brief Assignment operator clear the current graph and makes a copy of the "other" graph
@@ -57,6 +206,21 @@ class graph {
 
       clear();
 
+      verticesList = other.verticesList;
+
+      // Copy the CSR arrays directly if the other graph is frozen
+      if (other.frozen) {
+        frozen = true;
+        sortedVertices = other.sortedVertices;
+        rowOffsets = other.rowOffsets;
+        colIndices = other.colIndices;
+        edgeWeights = other.edgeWeights;
+        revOffsets = other.revOffsets;
+        revIndices = other.revIndices;
+        revWeights = other.revWeights;
+        return *this;
+      }
+
       // Iterate through each vertex and its values map of the other graph
       for (auto& vertexPair : other.adjList) {
         VertexT vertex = vertexPair.first;
@@ -78,11 +242,19 @@ class graph {
 
     /// @brief Returns number of vertices in the graph
     int NumVertices() const {
+      if (frozen) {
+        return sortedVertices.size();
+      }
+
       return adjList.size();
     }
 
     /// @brief Returns number of edges in the graph
     int NumEdges() const {
+      if (frozen) {
+        return colIndices.size();
+      }
+
       int sum = 0;
 
       // Iterate through each vertex in graph to add number of edges
@@ -95,10 +267,10 @@ class graph {
 
     /// @brief Adds a new vertex into the graph
     /// @param v vertex to be added
-    /// @return true if vertex is successfully added, false if vertex already exist in graph
+    /// @return true if vertex is successfully added, false if vertex already exist in graph or graph is frozen
     bool addVertex(VertexT v) {
       // Check and return false if vertex is already in graph
-      if (adjList.count(v) != 0) {
+      if (frozen || adjList.count(v) != 0) {
         return false;
       }
 
@@ -107,6 +279,7 @@ class graph {
       adjList[v] = newEdgeMap;
 
       verticesList.push_back(v); // push into vector of vertices
+      versionNumber++;
 
       return true;
     }
@@ -115,15 +288,16 @@ class graph {
     /// @param from Vertex that the edge starts from
     /// @param to Vertex that the edge points to
     /// @param weight Weight of the new edge
-    /// @return True if edge is successfully added, false if either vertex does not exist in graph
+    /// @return True if edge is successfully added, false if either vertex does not exist in graph or graph is frozen
     bool addEdge(VertexT from, VertexT to, WeightT weight) {
       // Check and return false if either vertex is not in graph
-      if (adjList.count(from) == 0 || adjList.count(to) == 0) {
+      if (frozen || adjList.count(from) == 0 || adjList.count(to) == 0) {
         return false;
       }
 
       // Add the new edge with weight into graph
       adjList[from][to] = weight; 
+      versionNumber++;
 
       return true;
     }
@@ -135,6 +309,24 @@ class graph {
     /// @return True if weight is successfully retrieved
     /// False if either vertex does not exist in the graph or if there is no edge between the two vertices
     bool getWeight(VertexT from, VertexT to, WeightT& weight) const {
+      if (frozen) {
+        uint32_t fromIndex, toIndex;
+
+        // Check and return false if either vertex is not in graph
+        if (!findIndex(from, fromIndex) || !findIndex(to, toIndex)) {
+          return false;
+        }
+
+        // Check and return false if edge between two vertices does not exist
+        size_t edge = findEdge(fromIndex, toIndex);
+        if (edge == colIndices.size()) {
+          return false;
+        }
+
+        weight = edgeWeights[edge];
+        return true;
+      }
+
       // Check and return false if either vertex is not in graph
       if (adjList.count(from) == 0 || adjList.count(to) == 0) {
         return false;
@@ -157,6 +349,19 @@ class graph {
     set<VertexT> neighbors(VertexT v) const {
       set<VertexT> neighborSet;
 
+      if (frozen) {
+        uint32_t index;
+
+        // Insert the neighbor vertices stored in the vertex's CSR row
+        if (findIndex(v, index)) {
+          for (size_t e = rowOffsets[index]; e < rowOffsets[index + 1]; e++) {
+            neighborSet.insert(sortedVertices[colIndices[e]]);
+          }
+        }
+
+        return neighborSet;
+      }
+
       // Check if the vertex exists in the graph
       if (adjList.count(v) != 0) {
         // Iterate over neighbors of the given vertex
@@ -169,12 +374,178 @@ class graph {
       return neighborSet;
     }
 
+    /// @brief Visit each neighbor of a vertex along with the weight of the edge to it,
+    /// without building a set or looking up the weights separately
+    /// @param v Vertex whose neighbors are visited
+    /// @param visit Callable invoked as visit(neighbor, weight) for each outgoing edge
+    template<typename Visitor>
+    void forEachNeighbor(VertexT v, Visitor visit) const {
+      if (frozen) {
+        uint32_t index;
+
+        if (findIndex(v, index)) {
+          for (size_t e = rowOffsets[index]; e < rowOffsets[index + 1]; e++) {
+            visit(sortedVertices[colIndices[e]], edgeWeights[e]);
+          }
+        }
+        return;
+      }
+
+      auto it = adjList.find(v);
+      if (it != adjList.end()) {
+        for (auto& edgePair : it->second) {
+          visit(edgePair.first, edgePair.second);
+        }
+      }
+    }
+
+    /// @brief Get the outgoing edges of a vertex in a frozen graph by dense index
+    /// The range points into the CSR arrays, so iterating it allocates nothing
+    /// @param index Dense index of the vertex, must be less than NumVertices()
+    /// @return Range of (neighbor index, weight) edges, in increasing neighbor order
+    EdgeRange edges(uint32_t index) const {
+      size_t first = rowOffsets[index];
+      size_t last = rowOffsets[index + 1];
+
+      return EdgeRange(EdgeIterator(colIndices.data() + first, edgeWeights.data() + first),
+                       EdgeIterator(colIndices.data() + last, edgeWeights.data() + last),
+                       last - first);
+    }
+
+    /// @brief Get the incoming edges of a vertex in a frozen graph by dense index
+    /// @param index Dense index of the vertex, must be less than NumVertices()
+    /// @return Range of (source index, weight) edges that point to the vertex, in increasing source order
+    EdgeRange inEdges(uint32_t index) const {
+      size_t first = revOffsets[index];
+      size_t last = revOffsets[index + 1];
+
+      return EdgeRange(EdgeIterator(revIndices.data() + first, revWeights.data() + first),
+                       EdgeIterator(revIndices.data() + last, revWeights.data() + last),
+                       last - first);
+    }
+
     /// @brief Get the vector of vertices in the graph
     /// @return Vector of vertices in the graph
     vector<VertexT> getVertices() const {
       return verticesList;
     }
 
+    /// @brief Compact the graph into compressed-sparse-row arrays
+    /// After freezing, the graph can no longer be edited until clear() is called
+    void freeze() {
+      if (frozen) {
+        return;
+      }
+
+      // Dense indices follow the sorted order of the vertices, which is also
+      // the iteration order of the adjacency map
+      sortedVertices.clear();
+      sortedVertices.reserve(adjList.size());
+      for (auto& vertexPair : adjList) {
+        sortedVertices.push_back(vertexPair.first);
+      }
+
+      rowOffsets.assign(1, 0);
+      rowOffsets.reserve(sortedVertices.size() + 1);
+      colIndices.reserve(NumEdges());
+      edgeWeights.reserve(NumEdges());
+
+      // Copy each vertex's edges into its row, already sorted by target
+      for (auto& vertexPair : adjList) {
+        for (auto& edgePair : vertexPair.second) {
+          uint32_t target = 0;
+          findIndex(edgePair.first, target);
+
+          colIndices.push_back(target);
+          edgeWeights.push_back(edgePair.second);
+        }
+        rowOffsets.push_back(colIndices.size());
+      }
+
+      buildReverseRows();
+
+      // Release the map-based representation
+      adjList.clear();
+      frozen = true;
+      versionNumber++;
+    }
+
+    /// @brief Replace the graph with one that is already compacted, such as a
+    /// graph saved by another run, without rebuilding it edge by edge
+    /// @param vertices Vertices in sorted order, one per dense index
+    /// @param offsets Size V+1, edge range of each vertex
+    /// @param targets Dense index of each edge's target, sorted within each row
+    /// @param weights Weight of each edge
+    /// @return True if the arrays form a valid graph, false (leaving the graph empty) if not
+    bool freezeFrom(vector<VertexT> vertices, vector<size_t> offsets,
+                    vector<uint32_t> targets, vector<WeightT> weights) {
+      clear();
+
+      bool valid = offsets.size() == vertices.size() + 1 && offsets.front() == 0 &&
+                   offsets.back() == targets.size() && weights.size() == targets.size();
+
+      for (size_t i = 1; valid && i < vertices.size(); i++) {
+        valid = vertices[i - 1] < vertices[i];
+      }
+
+      // every row must lie within targets before any row is read:
+      for (size_t i = 0; valid && i < vertices.size(); i++) {
+        valid = offsets[i] <= offsets[i + 1] && offsets[i + 1] <= targets.size();
+      }
+
+      for (size_t i = 0; valid && i < vertices.size(); i++) {
+        for (size_t e = offsets[i]; valid && e < offsets[i + 1]; e++) {
+          valid = targets[e] < vertices.size() && (e == offsets[i] || targets[e - 1] < targets[e]);
+        }
+      }
+
+      if (!valid) {
+        return false;
+      }
+
+      verticesList = vertices;
+      sortedVertices = move(vertices);
+      rowOffsets = move(offsets);
+      colIndices = move(targets);
+      edgeWeights = move(weights);
+      buildReverseRows();
+
+      frozen = true;
+      versionNumber++;
+      return true;
+    }
+
+    /// @brief Get the version number of the graph, which changes whenever the graph does
+    /// @return Version number, starting at 0 for a new graph
+    uint64_t version() const {
+      return versionNumber;
+    }
+
+    /// @brief Check if the graph has been compacted by freeze()
+    /// @return True if the graph is frozen
+    bool isFrozen() const {
+      return frozen;
+    }
+
+    /// @brief Get the dense index (0..V-1) of a vertex in a frozen graph
+    /// @param v Vertex to look up
+    /// @param index Passed-by-reference variable to store the dense index
+    /// @return True if index is successfully retrieved, false if the vertex does not exist or graph is not frozen
+    bool vertexIndex(VertexT v, uint32_t& index) const {
+      if (!frozen) {
+        return false;
+      }
+
+      return findIndex(v, index);
+    }
+
+    /// @brief Get the vertex with the given dense index in a frozen graph
+    /// @param index Dense index of the vertex, must be less than NumVertices()
+    /// @return Vertex stored at the dense index
+    VertexT vertexAt(uint32_t index) const {
+      return sortedVertices.at(index);
+    }
+
     /// @brief Dump the graph information to the output stream
     /// @param output The output stream to which the graph information will be written
     void dump(ostream& output) const {
@@ -195,6 +566,17 @@ class graph {
       // Display the list of edges
       output << endl;
       output << "**Edges:" << endl;
+      if (frozen) {
+        for (size_t i = 0; i < sortedVertices.size(); i++) {
+          output << " row " << sortedVertices[i] << ": ";
+
+          // Iterate over edges stored in the current vertex's row
+          for (size_t e = rowOffsets[i]; e < rowOffsets[i + 1]; e++) {
+            output << "(" << sortedVertices[colIndices[e]] << "," << edgeWeights[e] << ") ";
+          }
+          output << endl;
+        }
+      }
       for (auto& vertexPair : adjList) {
         VertexT row = vertexPair.first;
         output << " row " << row << ": ";
@@ -0,0 +1,252 @@
+/*landmarks.cpp*/
+
+//
+// Landmarks for ALT routing, see landmarks.h.
+//
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cassert>
+
+#include "landmarks.h"
+#include "dheap.h"
+#include "dist.h"
+#include "router.h"
+
+using namespace std;
+
+
+//
+// landmarkDistances
+//
+// Dijkstra from the landmark over the whole graph, following outgoing
+// edges (distances from the landmark) or incoming edges if reverse is
+// true (distances to the landmark).  Unreached vertices get INF.
+//
+static void landmarkDistances(const graph<long long, double>& G, uint32_t landmark,
+                              bool reverse, vector<double>& dist)
+{
+  dist.assign(G.NumVertices(), INF);
+
+  dheap<double> heap(G.NumVertices());
+
+  dist[landmark] = 0;
+  heap.pushOrDecrease(landmark, 0);
+
+  while (!heap.empty())
+  {
+    uint32_t currV = heap.pop();
+
+    for (auto edge : (reverse ? G.inEdges(currV) : G.edges(currV)))
+    {
+      double d = dist[currV] + edge.weight;
+
+      if (d < dist[edge.neighbor])
+      {
+        dist[edge.neighbor] = d;
+        heap.pushOrDecrease(edge.neighbor, d);
+      }
+    }
+  }
+}
+
+
+//
+// largestComponent
+//
+// Returns the vertices of the largest connected component (ignoring
+// edge direction), so landmarks are not wasted on isolated nodes such
+// as building outlines that no footway touches.
+//
+static vector<uint32_t> largestComponent(const graph<long long, double>& G)
+{
+  size_t numVertices = G.NumVertices();
+  vector<bool> visited(numVertices, false);
+  vector<uint32_t> largest;
+  vector<uint32_t> component;
+
+  for (uint32_t start = 0; start < numVertices; start++)
+  {
+    if (visited[start])
+      continue;
+
+    // breadth-first search, using the component vector as the queue:
+    component.clear();
+    component.push_back(start);
+    visited[start] = true;
+
+    for (size_t i = 0; i < component.size(); i++)
+    {
+      uint32_t currV = component[i];
+
+      for (auto range : {G.edges(currV), G.inEdges(currV)})
+      {
+        for (auto edge : range)
+        {
+          if (!visited[edge.neighbor])
+          {
+            visited[edge.neighbor] = true;
+            component.push_back(edge.neighbor);
+          }
+        }
+      }
+    }
+
+    if (component.size() > largest.size())
+      largest.swap(component);
+  }
+
+  return largest;
+}
+
+
+//
+// LandmarkSet
+//
+LandmarkSet::LandmarkSet()
+  : numLandmarks(0)
+{
+}
+
+
+//
+// build
+//
+// Picks k landmarks in the largest component by farthest-point
+// selection: each new landmark is the vertex farthest (in straight-line
+// distance) from all landmarks chosen so far, which spreads them out
+// toward the edges of the map where they give the best bounds.  The
+// distances from and to each landmark are then computed in parallel,
+// one landmark per thread.
+//
+void LandmarkSet::build(const graph<long long, double>& G, const vector<Coordinates>& NodeCoords, size_t k)
+{
+  assert(G.isFrozen());
+  assert(NodeCoords.size() == (size_t)G.NumVertices());
+
+  size_t numVertices = G.NumVertices();
+  vector<uint32_t> candidates = largestComponent(G);
+
+  landmarks.clear();
+  k = min(k, candidates.size());
+
+  //
+  // farthest-point selection, starting from the vertex farthest from
+  // an arbitrary vertex of the component.  Only the ranking matters
+  // here, so the fast approximate distance kernel is good enough:
+  //
+  vector<double> lats, lons;
+
+  for (uint32_t v : candidates)
+  {
+    lats.push_back(NodeCoords[v].Lat);
+    lons.push_back(NodeCoords[v].Lon);
+  }
+
+  vector<double> minDist(candidates.size(), INF);
+  vector<double> dist(candidates.size());
+
+  if (!candidates.empty())
+    approxDistancesFrom(lats[0], lons[0], lats.data(), lons.data(), candidates.size(), minDist.data());
+
+  while (landmarks.size() < k)
+  {
+    size_t farthest = max_element(minDist.begin(), minDist.end()) - minDist.begin();
+    landmarks.push_back(candidates[farthest]);
+
+    approxDistancesFrom(lats[farthest], lons[farthest], lats.data(), lons.data(), candidates.size(), dist.data());
+
+    for (size_t i = 0; i < candidates.size(); i++)
+      minDist[i] = min(minDist[i], dist[i]);
+
+    minDist[farthest] = -1;  // never pick the same vertex twice
+  }
+
+  numLandmarks = landmarks.size();
+
+  //
+  // one thread per landmark computes both of its distance arrays:
+  //
+  vector<vector<double>> from(numLandmarks);
+  vector<vector<double>> to(numLandmarks);
+  vector<thread> workers;
+
+  for (size_t i = 0; i < numLandmarks; i++)
+  {
+    workers.push_back(thread([&, i]()
+    {
+      landmarkDistances(G, landmarks[i], false, from[i]);
+      landmarkDistances(G, landmarks[i], true, to[i]);
+    }));
+  }
+
+  for (thread& worker : workers)
+    worker.join();
+
+  //
+  // interleave by vertex, so the bounds for one vertex share a cache line:
+  //
+  fromLandmark.resize(numVertices * numLandmarks);
+  toLandmark.resize(numVertices * numLandmarks);
+
+  for (size_t v = 0; v < numVertices; v++)
+  {
+    for (size_t i = 0; i < numLandmarks; i++)
+    {
+      fromLandmark[v * numLandmarks + i] = from[i][v];
+      toLandmark[v * numLandmarks + i] = to[i][v];
+    }
+  }
+}
+
+
+//
+// lowerBound
+//
+// Returns a lower bound on the distance from v to target, the largest
+// triangle inequality bound over all landmarks.  Landmarks that cannot
+// reach (or be reached from) one of the two vertices give no bound.
+//
+double LandmarkSet::lowerBound(uint32_t v, uint32_t target) const
+{
+  const double* fromV = &fromLandmark[v * numLandmarks];
+  const double* fromT = &fromLandmark[target * numLandmarks];
+  const double* toV = &toLandmark[v * numLandmarks];
+  const double* toT = &toLandmark[target * numLandmarks];
+
+  double best = 0;
+
+  for (size_t i = 0; i < numLandmarks; i++)
+  {
+    if (fromT[i] != INF && fromV[i] != INF)
+      best = max(best, fromT[i] - fromV[i]);
+
+    if (toV[i] != INF && toT[i] != INF)
+      best = max(best, toV[i] - toT[i]);
+  }
+
+  return best;
+}
+
+
+//
+// size
+//
+// Returns the number of landmarks, 0 until build() is called.
+//
+size_t LandmarkSet::size() const
+{
+  return numLandmarks;
+}
+
+
+//
+// vertices
+//
+// Returns the dense indices of the landmarks.
+//
+const vector<uint32_t>& LandmarkSet::vertices() const
+{
+  return landmarks;
+}
@@ -0,0 +1,43 @@
+/*landmarks.h*/
+
+//
+// Landmarks for ALT (A*, Landmarks, Triangle inequality) routing.
+//
+// For a handful of landmark vertices L we store the exact distances
+// d(L, v) and d(v, L) for every vertex v.  By the triangle inequality
+// the walking distance from v to a target t is at least
+//
+//   d(L, t) - d(L, v)   and   d(v, L) - d(t, L)
+//
+// and the best of these bounds over all landmarks is an A* heuristic
+// that follows the actual footways, so it stays tight where paths wind
+// around buildings and the straight-line bound does not.
+//
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "graph.h"
+#include "osm.h"
+
+using namespace std;
+
+class LandmarkSet {
+  private:
+    size_t numLandmarks;
+    vector<uint32_t> landmarks;    // dense index of each landmark
+    vector<double> fromLandmark;   // d(L, v), stored at v * numLandmarks + L
+    vector<double> toLandmark;     // d(v, L), stored at v * numLandmarks + L
+
+  public:
+    LandmarkSet();
+
+    void build(const graph<long long, double>& G, const vector<Coordinates>& NodeCoords, size_t k);
+
+    double lowerBound(uint32_t v, uint32_t target) const;
+
+    size_t size() const;
+    const vector<uint32_t>& vertices() const;
+};
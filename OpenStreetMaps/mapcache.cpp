@@ -0,0 +1,350 @@
+/*mapcache.cpp*/
+
+//
+// Compiled map snapshots, see mapcache.h.
+//
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+
+#include "mapcache.h"
+#include "xmlstream.h"
+#include "router.h"
+
+using namespace std;
+
+
+static const char MAP_MAGIC[8] = {'O', 'S', 'M', 'M', 'A', 'P', '0', '1'};
+
+
+//
+// Header of a compiled map, followed by payloadSize bytes of contents.
+//
+struct MapHeader
+{
+  char magic[8];
+  uint64_t sourceSize;     // size of the .osm file compiled
+  int64_t sourceTime;      // and its modification time
+  uint64_t payloadSize;
+  uint64_t checksum;       // of the payload
+};
+
+
+//
+// checksum
+//
+// FNV-1a hash of a block of bytes.
+//
+static uint64_t checksum(const char* data, size_t size)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+
+//
+// sourceStamp
+//
+// Gets the size and modification time of the map file.  Returns false
+// if the file does not exist.
+//
+static bool sourceStamp(const string& mapFilename, uint64_t& size, int64_t& time)
+{
+  error_code error;
+
+  size = filesystem::file_size(mapFilename, error);
+  if (error)
+    return false;
+
+  auto modified = filesystem::last_write_time(mapFilename, error);
+  if (error)
+    return false;
+
+  time = modified.time_since_epoch().count();
+  return true;
+}
+
+
+//
+// Appends values, arrays and strings to the payload being written.
+//
+template<typename T>
+static void putValue(string& out, const T& value)
+{
+  static_assert(is_trivially_copyable<T>::value, "written as raw bytes");
+  out.append((const char*)&value, sizeof(T));
+}
+
+template<typename T>
+static void putVector(string& out, const vector<T>& data)
+{
+  static_assert(is_trivially_copyable<T>::value, "written as raw bytes");
+  putValue(out, (uint64_t)data.size());
+  out.append((const char*)data.data(), data.size() * sizeof(T));
+}
+
+static void putString(string& out, const string& text)
+{
+  putValue(out, (uint64_t)text.size());
+  out.append(text);
+}
+
+
+//
+// PayloadReader
+//
+// Reads values, arrays and strings back out of a payload, failing
+// (rather than reading past the end) if the payload is cut short.
+//
+class PayloadReader
+{
+  private:
+    const char* next;
+    const char* end;
+
+  public:
+    PayloadReader(const char* data, size_t size) : next(data), end(data + size) {}
+
+    template<typename T>
+    bool getValue(T& value)
+    {
+      if ((size_t)(end - next) < sizeof(T))
+        return false;
+
+      memcpy(&value, next, sizeof(T));
+      next += sizeof(T);
+      return true;
+    }
+
+    template<typename T>
+    bool getVector(vector<T>& data)
+    {
+      uint64_t count = 0;
+
+      if (!getValue(count) || count > (uint64_t)(end - next) / sizeof(T))
+        return false;
+
+      data.resize(count);
+      memcpy((void*)data.data(), next, count * sizeof(T));
+      next += count * sizeof(T);
+      return true;
+    }
+
+    bool getString(string& text)
+    {
+      uint64_t length = 0;
+
+      if (!getValue(length) || length > (uint64_t)(end - next))
+        return false;
+
+      text.assign(next, length);
+      next += length;
+      return true;
+    }
+
+    bool atEnd() const
+    {
+      return next == end;
+    }
+};
+
+
+//
+// saveCompiledMap
+//
+// Writes a snapshot of a map compiled from mapFilename: the frozen
+// graph G, the position of every graph vertex (NodeCoords, by dense
+// index), the snapped buildings and the counts read from the map.
+// Returns false if the file could not be written.
+//
+bool saveCompiledMap(string filename, string mapFilename,
+                     const graph<long long, double>& G, const vector<Coordinates>& NodeCoords,
+                     const vector<BuildingInfo>& Buildings, const MapCounts& Counts)
+{
+  MapHeader header;
+  memcpy(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC));
+
+  if (!G.isFrozen() || !sourceStamp(mapFilename, header.sourceSize, header.sourceTime))
+    return false;
+
+  //
+  // the graph as CSR arrays:
+  //
+  uint32_t numVertices = G.NumVertices();
+  vector<long long> vertices(numVertices);
+  vector<uint64_t> offsets(1, 0);
+  vector<uint32_t> targets;
+  vector<double> weights;
+
+  offsets.reserve(numVertices + 1);
+  targets.reserve(G.NumEdges());
+  weights.reserve(G.NumEdges());
+
+  for (uint32_t v = 0; v < numVertices; v++)
+  {
+    vertices[v] = G.vertexAt(v);
+
+    for (auto edge : G.edges(v))
+    {
+      targets.push_back(edge.neighbor);
+      weights.push_back(edge.weight);
+    }
+
+    offsets.push_back(targets.size());
+  }
+
+  string payload;
+
+  putValue(payload, Counts);
+  putVector(payload, vertices);
+  putVector(payload, offsets);
+  putVector(payload, targets);
+  putVector(payload, weights);
+  putVector(payload, NodeCoords);
+
+  putValue(payload, (uint64_t)Buildings.size());
+
+  for (const BuildingInfo& building : Buildings)
+  {
+    putString(payload, building.Fullname);
+    putString(payload, building.Abbrev);
+    putValue(payload, building.Coords);
+    putValue(payload, building.NearestNode);
+  }
+
+  header.payloadSize = payload.size();
+  header.checksum = checksum(payload.data(), payload.size());
+
+  ofstream file(filename, ios::binary);
+
+  if (!file.good())
+    return false;
+
+  file.write((const char*)&header, sizeof(header));
+  file.write(payload.data(), payload.size());
+
+  return file.good();
+}
+
+
+//
+// loadCompiledMap
+//
+// Reads a snapshot written by saveCompiledMap, rebuilding the connected
+// components from the graph.  Returns false, leaving the outputs empty,
+// if the snapshot is missing or damaged, or if mapFilename has changed
+// since it was compiled.
+//
+bool loadCompiledMap(string filename, string mapFilename,
+                     graph<long long, double>& G, vector<Coordinates>& NodeCoords,
+                     vector<BuildingInfo>& Buildings, MapCounts& Counts,
+                     ComponentIndex& Components)
+{
+  G.clear();
+  NodeCoords.clear();
+  Buildings.clear();
+  Components.clear();
+
+  uint64_t sourceSize = 0;
+  int64_t sourceTime = 0;
+
+  if (!sourceStamp(mapFilename, sourceSize, sourceTime))
+    return false;
+
+  MappedFileSource mapping(filename);
+  const char* data = nullptr;
+  size_t size = 0;
+
+  if (!mapping.contents(data, size) || size < sizeof(MapHeader))
+    return false;
+
+  MapHeader header;
+  memcpy(&header, data, sizeof(header));
+
+  if (memcmp(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC)) != 0 ||
+      header.sourceSize != sourceSize || header.sourceTime != sourceTime ||
+      header.payloadSize != size - sizeof(MapHeader))
+    return false;
+
+  const char* payload = data + sizeof(MapHeader);
+
+  if (checksum(payload, header.payloadSize) != header.checksum)
+    return false;
+
+  //
+  // the checksum matches, but check the structure anyway before
+  // trusting any index in it:
+  //
+  PayloadReader reader(payload, header.payloadSize);
+  MapCounts counts;
+  vector<long long> vertices;
+  vector<uint64_t> offsets;
+  vector<uint32_t> targets;
+  vector<double> weights;
+  uint64_t numBuildings = 0;
+
+  bool ok = reader.getValue(counts)
+    && reader.getVector(vertices)
+    && reader.getVector(offsets)
+    && reader.getVector(targets)
+    && reader.getVector(weights)
+    && reader.getVector(NodeCoords)
+    && reader.getValue(numBuildings)
+    && NodeCoords.size() == vertices.size();
+
+  for (uint64_t i = 0; ok && i < numBuildings; i++)
+  {
+    BuildingInfo building;
+
+    ok = reader.getString(building.Fullname)
+      && reader.getString(building.Abbrev)
+      && reader.getValue(building.Coords)
+      && reader.getValue(building.NearestNode)
+      && (building.NearestNode < vertices.size() || building.NearestNode == NO_VERTEX);
+
+    if (ok)
+      Buildings.push_back(move(building));
+  }
+
+  ok = ok && reader.atEnd()
+    && G.freezeFrom(move(vertices), vector<size_t>(offsets.begin(), offsets.end()),
+                    move(targets), move(weights));
+
+  if (!ok)
+  {
+    G.clear();
+    NodeCoords.clear();
+    Buildings.clear();
+    return false;
+  }
+
+  for (uint32_t v = 0; v < (uint32_t)G.NumVertices(); v++)
+  {
+    Components.addNode(G.vertexAt(v));
+  }
+
+  for (uint32_t v = 0; v < (uint32_t)G.NumVertices(); v++)
+  {
+    for (auto edge : G.edges(v))
+    {
+      Components.addEdge(G.vertexAt(v), G.vertexAt(edge.neighbor));
+    }
+  }
+
+  Components.flatten();
+
+  Counts = counts;
+  return true;
+}
@@ -0,0 +1,36 @@
+/*mapcache.h*/
+
+//
+// Compiled map: a binary snapshot of everything the application builds
+// from an .osm file before it can answer queries.  That includes the
+// frozen footway graph (vertex IDs and CSR edges with their weights),
+// the dense node positions, and the buildings already snapped to their
+// nearest footway nodes.
+//
+// Loading the snapshot skips parsing the XML, computing the edge
+// weights and snapping the buildings.  The file is memory-mapped and
+// its arrays copied straight out of the mapping.  The header records a
+// format version, the size and modification time of the .osm file it
+// was compiled from, and a checksum of the contents.  A snapshot that
+// does not match any of them is rejected, and the caller goes back to
+// the XML (as it does where files cannot be memory-mapped).
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "graph.h"
+#include "osm.h"
+#include "components.h"
+
+using namespace std;
+
+bool saveCompiledMap(string filename, string mapFilename,
+                     const graph<long long, double>& G, const vector<Coordinates>& NodeCoords,
+                     const vector<BuildingInfo>& Buildings, const MapCounts& Counts);
+bool loadCompiledMap(string filename, string mapFilename,
+                     graph<long long, double>& G, vector<Coordinates>& NodeCoords,
+                     vector<BuildingInfo>& Buildings, MapCounts& Counts,
+                     ComponentIndex& Components);
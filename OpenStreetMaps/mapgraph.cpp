@@ -0,0 +1,182 @@
+/*mapgraph.cpp*/
+
+//
+// Builds the footway graph and the dense node tables used for routing,
+// see mapgraph.h.
+//
+
+#include <vector>
+#include <map>
+#include <thread>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+#include <cassert>
+
+#include "dist.h"
+#include "mapgraph.h"
+#include "router.h"
+
+using namespace std;
+
+/// @brief Populate graph with vertices and edges based on provided information
+/// @param Nodes Map of node IDs to their coordinates
+/// @param Footways Vector of footway information
+/// @param Buildings Vector of building information
+/// @param G Graph to be populated
+/// @param Components Optional component index, kept up to date with every edge added
+void populateGraph (
+    map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways,
+    vector<BuildingInfo>& Buildings, graph<long long, double>& G,
+    ComponentIndex* Components) {
+  
+  // Add vertices to graph for each node, in sorted ID order so component
+  // indices match the dense indices of the frozen graph.  The trig of
+  // every node is computed once here rather than for every edge it is on.
+  vector<long long> ids;
+  vector<TrigCoordinates> trig;
+  ids.reserve(Nodes.size());
+  trig.reserve(Nodes.size());
+
+  for (auto &vertex : Nodes) {
+    G.addVertex(vertex.first);
+    ids.push_back(vertex.first);
+    trig.push_back(toTrigCoordinates(vertex.second.Lat, vertex.second.Lon));
+
+    if (Components != nullptr) {
+      Components->addNode(vertex.first);
+    }
+  }
+
+  // Position of a node in ids/trig, which are sorted by ID
+  auto nodeIndex = [&ids](long long id) -> size_t {
+    auto it = lower_bound(ids.begin(), ids.end(), id);
+
+    if (it == ids.end() || *it != id) {
+      throw out_of_range("footway node " + to_string(id) + " not found");
+    }
+
+    return it - ids.begin();
+  };
+
+  // Add edges to graph based on footway information
+  for (auto &footway : Footways) {
+    // Iterate over nodes in the footway
+    for (size_t i = 0; i < footway.Nodes.size() - 1; i++) {
+      // Look up two consecutive nodes
+      size_t n1 = nodeIndex(footway.Nodes[i]);
+      size_t n2 = nodeIndex(footway.Nodes[i + 1]);
+
+      // Calculate distance between the nodes
+      double distance = distBetween2Points(trig[n1], trig[n2]);
+
+      // Add edges in both directions
+      G.addEdge(ids[n1], ids[n2], distance);
+      G.addEdge(ids[n2], ids[n1], distance);
+
+      if (Components != nullptr) {
+        Components->addEdge(ids[n1], ids[n2]);
+      }
+    }
+  }
+
+  // Settle every node on its component label for constant-time lookups
+  if (Components != nullptr) {
+    Components->flatten();
+  }
+}
+
+/// @brief Remap OSM node IDs to the dense indices of the frozen graph
+/// @param Nodes Map of node IDs to their coordinates
+/// @param Footways Vector of footway information
+/// @param G Frozen graph whose vertices are the node IDs
+/// @param NodeCoords Vector to be filled with node coordinates, indexed by dense node index
+/// @param FootwayNodes Vector to be filled with the dense indices of the nodes of every footway
+void buildNodeTables (
+    map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways,
+    graph<long long, double>& G, vector<Coordinates>& NodeCoords, vector<uint32_t>& FootwayNodes) {
+
+  // Dense indices follow the sorted order of node IDs, same as the map
+  NodeCoords.clear();
+  NodeCoords.reserve(Nodes.size());
+  for (auto &node : Nodes) {
+    NodeCoords.push_back(node.second);
+  }
+  assert(NodeCoords.size() == (size_t)G.NumVertices());
+
+  // Translate the node IDs of each footway once, keeping footway order
+  FootwayNodes.clear();
+  for (auto &footway : Footways) {
+    for (long long id : footway.Nodes) {
+      uint32_t index = 0;
+      G.vertexIndex(id, index);
+      FootwayNodes.push_back(index);
+    }
+  }
+}
+
+/// @brief Build the spatial index used to snap positions to the nearest footway node
+/// @param NodeCoords Vector of node coordinates, indexed by dense node index
+/// @param FootwayNodes Dense indices of the nodes of every footway, in footway order
+/// @param FootwayIndex Index to be filled with every footway node once, as items named by dense index
+void buildFootwayIndex(vector<Coordinates>& NodeCoords, vector<uint32_t>& FootwayNodes, GeoIndex& FootwayIndex) {
+  vector<bool> added(NodeCoords.size(), false);
+  vector<Coordinates> positions;
+  vector<uint32_t> nodes;
+
+  // Nodes shared by several footways are indexed at their first occurrence,
+  // which is the one a scan of FootwayNodes would settle ties on
+  for (uint32_t node : FootwayNodes) {
+    if (!added[node]) {
+      added[node] = true;
+      positions.push_back(NodeCoords[node]);
+      nodes.push_back(node);
+    }
+  }
+
+  FootwayIndex.build(positions, nodes);
+}
+
+/// @brief Build the spatial index used to find the buildings closest to a position
+/// @param Buildings Vector of building information
+/// @param BuildingIndex Index to be filled with every building, as items named by position in Buildings
+void buildBuildingIndex(vector<BuildingInfo>& Buildings, GeoIndex& BuildingIndex) {
+  vector<Coordinates> positions;
+  vector<uint32_t> buildings;
+
+  for (size_t i = 0; i < Buildings.size(); i++) {
+    positions.push_back(Buildings[i].Coords);
+    buildings.push_back((uint32_t)i);
+  }
+
+  BuildingIndex.build(positions, buildings);
+}
+
+/// @brief Snap every building to its nearest footway node, storing the node in BuildingInfo::NearestNode,
+///        or NO_VERTEX if there are no footway nodes
+/// @param Buildings Vector of building information
+/// @param FootwayIndex Spatial index of the footway nodes
+/// @param Threads Number of threads to snap with, at most one per 64 buildings (0 for one per core)
+void snapBuildings(vector<BuildingInfo>& Buildings, GeoIndex& FootwayIndex, unsigned Threads) {
+  // Buildings are independent, so split them into one contiguous chunk per thread
+  size_t numThreads = (Threads == 0) ? max(1u, thread::hardware_concurrency()) : Threads;
+  numThreads = min(numThreads, max((size_t)1, Buildings.size() / 64));
+  size_t chunk = (Buildings.size() + numThreads - 1) / numThreads;
+
+  vector<thread> workers;
+
+  for (size_t first = 0; first < Buildings.size(); first += chunk) {
+    size_t last = min(first + chunk, Buildings.size());
+
+    workers.push_back(thread([&Buildings, &FootwayIndex, first, last]() {
+      for (size_t i = first; i < last; i++) {
+        uint32_t node = FootwayIndex.nearest(Buildings[i].Coords.Lat, Buildings[i].Coords.Lon);
+        Buildings[i].NearestNode = (node == GeoIndex::NO_ITEM) ? NO_VERTEX : node;
+      }
+    }));
+  }
+
+  for (thread& worker : workers) {
+    worker.join();
+  }
+}
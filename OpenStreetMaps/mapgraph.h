@@ -0,0 +1,28 @@
+/*mapgraph.h*/
+
+//
+// Builds the footway graph and the dense node tables used for routing
+// from the nodes and footways read out of the OSM file.
+//
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include "graph.h"
+#include "osm.h"
+#include "components.h"
+#include "geoindex.h"
+
+using namespace std;
+
+void populateGraph(map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways,
+                   vector<BuildingInfo>& Buildings, graph<long long, double>& G,
+                   ComponentIndex* Components = nullptr);
+void buildNodeTables(map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways,
+                     graph<long long, double>& G, vector<Coordinates>& NodeCoords, vector<uint32_t>& FootwayNodes);
+void buildFootwayIndex(vector<Coordinates>& NodeCoords, vector<uint32_t>& FootwayNodes, GeoIndex& FootwayIndex);
+void buildBuildingIndex(vector<BuildingInfo>& Buildings, GeoIndex& BuildingIndex);
+void snapBuildings(vector<BuildingInfo>& Buildings, GeoIndex& FootwayIndex, unsigned Threads = 0);
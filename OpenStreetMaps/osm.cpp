@@ -24,26 +24,105 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <iterator>
+#include <charconv>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
 
 #include "tinyxml2.h"
 #include "osm.h"
+#include "xmlstream.h"
 
 using namespace std;
 using namespace tinyxml2;
 
 
+//
+// OpenMapSource
+//
+// Opens a map file for the streaming parser: decompressing it on the
+// fly if it is gzip or bzip2 compressed, otherwise memory-mapped (if
+// MapFile is set and the file can be mapped) or read in chunks.
+// Returns nullptr if the file cannot be opened.
+//
+static unique_ptr<ByteSource> OpenMapSource(const string& filename, bool MapFile)
+{
+  Compression compression = fileCompression(filename);
+
+  if (compression == Compression::GZIP)
+  {
+    unique_ptr<GzipSource> gzip = make_unique<GzipSource>(filename);
+    return gzip->isOpen() ? move(gzip) : nullptr;
+  }
+
+  if (compression == Compression::BZIP2)
+  {
+    unique_ptr<Bzip2Source> bzip2 = make_unique<Bzip2Source>(filename);
+    return bzip2->isOpen() ? move(bzip2) : nullptr;
+  }
+
+  if (MapFile)
+  {
+    unique_ptr<MappedFileSource> mapped = make_unique<MappedFileSource>(filename);
+
+    if (mapped->isOpen())
+      return mapped;
+  }
+
+  unique_ptr<FileSource> file = make_unique<FileSource>(filename);
+  return file->isOpen() ? move(file) : nullptr;
+}
+
+
 //
 // LoadOpenStreetMap
 //
 bool LoadOpenStreetMap(string filename, XMLDocument& xmldoc)
 {
   //
-  // load the XML document:
+  // load the XML document, interning the element and attribute names so
+  // the Read* functions below find "node", "way", "id" etc. by comparing
+  // integers rather than strings.  They read nothing but elements and
+  // attributes, so text and comments are skipped rather than built:
   //
-  xmldoc.LoadFile(filename.c_str());
+  xmldoc.SetInternNames(true);
+  xmldoc.SetElementsOnly(true);
+
+  if (fileCompression(filename) == Compression::NONE)
+  {
+    xmldoc.LoadFile(filename.c_str());
+  }
+  else
+  {
+    //
+    // a compressed map is decompressed into memory first; the document
+    // will hold all of it anyway (StreamOpenStreetMap does not):
+    //
+    unique_ptr<ByteSource> source = OpenMapSource(filename, false);
+
+    if (source == nullptr)
+    {
+      cout << "**ERROR: unable to open map file '" << filename << "'." << endl;
+      return false;
+    }
+
+    string text;
+    size_t count = 0;
+    const size_t CHUNK_BYTES = 1 << 20;
+
+    do
+    {
+      text.resize(text.size() + CHUNK_BYTES);
+      count = source->read(&text[text.size() - CHUNK_BYTES], CHUNK_BYTES);
+      text.resize(text.size() - CHUNK_BYTES + count);
+    } while (count > 0);
+
+    xmldoc.Parse(text.data(), text.size());
+  }
 
   if (xmldoc.ErrorID() != 0)  // failed:
   {
@@ -71,6 +150,44 @@ bool LoadOpenStreetMap(string filename, XMLDocument& xmldoc)
 
 
 
+//
+// OsmName
+//
+// An element or attribute name the Read* functions look up.  If the
+// document interned its names (as LoadOpenStreetMap asks), the atom of
+// the name is found once and every lookup compares integers; otherwise
+// the lookups compare strings as before.
+//
+struct OsmName
+{
+  const char* Text;
+  int Atom;  // -1 if the document does not intern names
+
+  OsmName(const XMLDocument& xmldoc, const char* text)
+    : Text(text), Atom(xmldoc.InternNames() ? xmldoc.NameAtom(text) : -1)
+  { }
+};
+
+static XMLElement* FirstChild(XMLElement* parent, const OsmName& name)
+{
+  return (name.Atom >= 0) ? parent->FirstChildElementByAtom(name.Atom)
+                          : parent->FirstChildElement(name.Text);
+}
+
+static XMLElement* NextSibling(XMLElement* element, const OsmName& name)
+{
+  return (name.Atom >= 0) ? element->NextSiblingElementByAtom(name.Atom)
+                          : element->NextSiblingElement(name.Text);
+}
+
+static const XMLAttribute* FindAttribute(const XMLElement* element, const OsmName& name)
+{
+  return (name.Atom >= 0) ? element->FindAttributeByAtom(name.Atom)
+                          : element->FindAttribute(name.Text);
+}
+
+
+
 //
 // ReadMapNodes
 //
@@ -79,18 +196,21 @@ int ReadMapNodes(XMLDocument& xmldoc, map<long long, Coordinates>& Nodes)
   XMLElement* osm = xmldoc.FirstChildElement("osm");
   assert(osm != nullptr);
 
+  OsmName nodeName(xmldoc, "node"), idName(xmldoc, "id");
+  OsmName latName(xmldoc, "lat"), lonName(xmldoc, "lon");
+
   //
   // Parse the XML document node by node: 
   //
   int nodeCount = 0;
 
-  XMLElement* node = osm->FirstChildElement("node");
+  XMLElement* node = FirstChild(osm, nodeName);
 
   while (node != nullptr)
   {
-    const XMLAttribute* attrId = node->FindAttribute("id");
-    const XMLAttribute* attrLat = node->FindAttribute("lat");
-    const XMLAttribute* attrLon = node->FindAttribute("lon");
+    const XMLAttribute* attrId = FindAttribute(node, idName);
+    const XMLAttribute* attrLat = FindAttribute(node, latName);
+    const XMLAttribute* attrLon = FindAttribute(node, lonName);
 
     assert(attrId != nullptr);
     assert(attrLat != nullptr);
@@ -110,7 +230,7 @@ int ReadMapNodes(XMLDocument& xmldoc, map<long long, Coordinates>& Nodes)
     //
     // next node element in the XML doc:
     //
-    node = node->NextSiblingElement("node");
+    node = NextSibling(node, nodeName);
   }
 
   //
@@ -128,16 +248,20 @@ int ReadFootways(XMLDocument& xmldoc, vector<FootwayInfo>& Footways)
   XMLElement* osm = xmldoc.FirstChildElement("osm");
   assert(osm != nullptr);
 
+  OsmName wayName(xmldoc, "way"), idName(xmldoc, "id");
+  OsmName tagName(xmldoc, "tag"), kName(xmldoc, "k"), vName(xmldoc, "v");
+  OsmName ndName(xmldoc, "nd"), refName(xmldoc, "ref");
+
   //
   // Parse the XML document way by way, looking for footways:
   //
   int footwayCount = 0;
 
-  XMLElement* way = osm->FirstChildElement("way");
+  XMLElement* way = FirstChild(osm, wayName);
 
   while (way != nullptr)
   {
-    const XMLAttribute* attr = way->FindAttribute("id");
+    const XMLAttribute* attr = FindAttribute(way, idName);
     assert(attr != nullptr);
 
     long long id = attr->Int64Value();
@@ -148,11 +272,11 @@ int ReadFootways(XMLDocument& xmldoc, vector<FootwayInfo>& Footways)
     //
     bool isFootway = false;
 
-    XMLElement* tag = way->FirstChildElement("tag");
+    XMLElement* tag = FirstChild(way, tagName);
     while (tag != nullptr)
     {
-      const XMLAttribute* attrk = tag->FindAttribute("k");
-      const XMLAttribute* attrv = tag->FindAttribute("v");
+      const XMLAttribute* attrk = FindAttribute(tag, kName);
+      const XMLAttribute* attrv = FindAttribute(tag, vName);
 
       if (attrk != nullptr && attrv != nullptr)
       {
@@ -167,7 +291,7 @@ int ReadFootways(XMLDocument& xmldoc, vector<FootwayInfo>& Footways)
         }
       }
 
-      tag = tag->NextSiblingElement("tag");
+      tag = NextSibling(tag, tagName);
     }
 
     // 
@@ -178,11 +302,11 @@ int ReadFootways(XMLDocument& xmldoc, vector<FootwayInfo>& Footways)
     {
       FootwayInfo footway(id);
 
-      XMLElement* nd = way->FirstChildElement("nd");
+      XMLElement* nd = FirstChild(way, ndName);
 
       while (nd != nullptr)
       {
-        const XMLAttribute* ndref = nd->FindAttribute("ref");
+        const XMLAttribute* ndref = FindAttribute(nd, refName);
         assert(ndref != nullptr);
 
         long long id = ndref->Int64Value();
@@ -190,13 +314,13 @@ int ReadFootways(XMLDocument& xmldoc, vector<FootwayInfo>& Footways)
         footway.Nodes.push_back(id);
 
         // advance to next node ref:
-        nd = nd->NextSiblingElement("nd");
+        nd = NextSibling(nd, ndName);
       }
 
       Footways.push_back(footway);
     }//if
 
-    way = way->NextSiblingElement("way");
+    way = NextSibling(way, wayName);
   }//while
 
   //
@@ -206,6 +330,28 @@ int ReadFootways(XMLDocument& xmldoc, vector<FootwayInfo>& Footways)
 }
 
 
+//
+// BuildingAbbrev
+//
+// Returns the abbreviation in a building's name, which appears as
+// "... (SEO)", or "?" if there is none.
+//
+static string BuildingAbbrev(const string& fullname)
+{
+  string abbrev = "?";
+
+  size_t left = fullname.find('(');
+  size_t right = fullname.find(')');
+
+  if (left != string::npos && right != string::npos && left < right)
+  {
+    abbrev = fullname.substr(left + 1, right - left - 1);
+  }
+
+  return abbrev;
+}
+
+
 //
 // ReadUniversityBuildings
 //
@@ -216,16 +362,20 @@ int ReadUniversityBuildings(XMLDocument& xmldoc,
   XMLElement* osm = xmldoc.FirstChildElement("osm");
   assert(osm != nullptr);
 
+  OsmName wayName(xmldoc, "way"), idName(xmldoc, "id");
+  OsmName tagName(xmldoc, "tag"), kName(xmldoc, "k"), vName(xmldoc, "v");
+  OsmName ndName(xmldoc, "nd"), refName(xmldoc, "ref");
+
   //
   // Parse the XML document way by way, looking for university buildings:
   //
   int buildingCount = 0;
 
-  XMLElement* way = osm->FirstChildElement("way");
+  XMLElement* way = FirstChild(osm, wayName);
 
   while (way != nullptr)
   {
-    const XMLAttribute* attr = way->FindAttribute("id");
+    const XMLAttribute* attr = FindAttribute(way, idName);
     assert(attr != nullptr);
 
     long long id = attr->Int64Value();
@@ -234,11 +384,11 @@ int ReadUniversityBuildings(XMLDocument& xmldoc,
 
     const char* buildingName = nullptr;
 
-    XMLElement* tag = way->FirstChildElement("tag");
+    XMLElement* tag = FirstChild(way, tagName);
     while (tag != nullptr)
     {
-      const XMLAttribute* attrk = tag->FindAttribute("k");
-      const XMLAttribute* attrv = tag->FindAttribute("v");
+      const XMLAttribute* attrk = FindAttribute(tag, kName);
+      const XMLAttribute* attrv = FindAttribute(tag, vName);
 
       if (attrk != nullptr && attrv != nullptr)
       {
@@ -256,7 +406,7 @@ int ReadUniversityBuildings(XMLDocument& xmldoc,
         }
       }
 
-      tag = tag->NextSiblingElement("tag");
+      tag = NextSibling(tag, tagName);
     }
 
     //
@@ -264,7 +414,7 @@ int ReadUniversityBuildings(XMLDocument& xmldoc,
     //
     if (isBuilding && buildingName != nullptr)
     {
-      XMLElement* nd = way->FirstChildElement("nd");
+      XMLElement* nd = FirstChild(way, ndName);
       buildingCount++;
       //
       // we need to compute a (lat, lon) for the building, so we compute
@@ -278,7 +428,7 @@ int ReadUniversityBuildings(XMLDocument& xmldoc,
 
       while (nd != nullptr)
       {
-        const XMLAttribute* ndref = nd->FindAttribute("ref");
+        const XMLAttribute* ndref = FindAttribute(nd, refName);
         assert(ndref != nullptr);
 
         long long id = ndref->Int64Value();
@@ -289,7 +439,7 @@ int ReadUniversityBuildings(XMLDocument& xmldoc,
         numNodes++;
 
         // advance to next node ref:
-        nd = nd->NextSiblingElement("nd");
+        nd = NextSibling(nd, ndName);
       }//while
 
       //
@@ -300,24 +450,12 @@ int ReadUniversityBuildings(XMLDocument& xmldoc,
       double lon = totalLon / numNodes;
 
       string  fullname(buildingName);
-
-      //
-      // do we have an abbreviation?  Appears as "... (SEO)" in the string:
-      //
-      string abbrev = "?";
-
-      size_t left = fullname.find('(');
-      size_t right = fullname.find(')');
-
-      if (left != string::npos && right != string::npos && left < right)
-      {
-        abbrev = fullname.substr(left + 1, right - left - 1);
-      }
+      string  abbrev = BuildingAbbrev(fullname);
 
       Buildings.push_back(BuildingInfo(fullname, abbrev, id, lat, lon));
     }//if
 
-    way = way->NextSiblingElement("way");
+    way = NextSibling(way, wayName);
   }//while
 
   //
@@ -325,3 +463,631 @@ int ReadUniversityBuildings(XMLDocument& xmldoc,
   //
   return buildingCount;
 }
+
+
+//
+// AttributeValue
+//
+// Returns the value of an attribute read by the streaming parser, with
+// entity references expanded; scratch holds the expanded copy, which is
+// only made when the raw value needs it.
+//
+static string_view AttributeValue(const XmlPullParser::Attribute* attr, string& scratch)
+{
+  if (attr->Value.find_first_of("&\r") == string_view::npos)
+  {
+    return attr->Value;
+  }
+
+  XmlPullParser::decode(attr->Value, scratch);
+  return scratch;
+}
+
+
+//
+// Int64Value / DoubleValue
+//
+// Convert an attribute the same way XMLAttribute::Int64Value and
+// DoubleValue do, giving 0 if the attribute is missing or malformed.
+// Plain numbers, which is nearly all of them, are converted straight
+// out of the parser's buffer; anything else goes through a copy and
+// XMLUtil.
+//
+static long long Int64Value(const XmlPullParser::Attribute* attr)
+{
+  int64_t value = 0;
+
+  if (attr != nullptr)
+  {
+    string scratch;
+    string_view text = AttributeValue(attr, scratch);
+    const char* end = text.data() + text.size();
+    from_chars_result result = from_chars(text.data(), end, value);
+
+    if (result.ec != errc() || result.ptr != end)
+    {
+      string copy(text);
+      value = 0;
+      XMLUtil::ToInt64(copy.c_str(), &value);
+    }
+  }
+
+  return value;
+}
+
+static double DoubleValue(const XmlPullParser::Attribute* attr)
+{
+  double value = 0;
+
+  if (attr != nullptr)
+  {
+    string scratch;
+    string_view text = AttributeValue(attr, scratch);
+
+    if (!XMLUtil::ToFixedDecimal(text.data(), text.data() + text.size(), &value))
+    {
+      string copy(text);
+      XMLUtil::ToDouble(copy.c_str(), &value);
+    }
+  }
+
+  return value;
+}
+
+
+//
+// PendingBuilding
+//
+// University building read by the streaming parser.  Its position is
+// computed once all nodes have been read, in case it refers to nodes
+// that come after it.
+//
+struct PendingBuilding
+{
+  long long ID;
+  string Fullname;
+  vector<long long> Nodes;
+};
+
+
+//
+// OsmContentReader
+//
+// Picks the nodes, footways and university buildings out of the
+// elements inside the top-level osm element as the streaming parser
+// hands them over.  Depths count from the children of osm, so a node or
+// a way is at depth 1.  Nodes go into nodeMap if it is set, otherwise
+// they are collected in document order in nodeList.
+//
+// A way is classified once its end tag is reached, since its tags come
+// after its node refs.  startElement returns false if a node, way or nd
+// element is missing an attribute it needs, which makes the map
+// unreadable.
+//
+class OsmContentReader
+{
+  private:
+    map<long long, Coordinates>* nodeMap;
+    vector<Coordinates>* nodeList;
+    vector<FootwayInfo>& footways;
+    vector<PendingBuilding>& pending;
+    MapCounts& counts;
+
+    // the way being read:
+    bool inWay;
+    long long wayId;
+    vector<long long> wayNodes;
+    bool isFootway;
+    bool isBuilding;
+    bool hasName;
+    string buildingName;
+
+    string scratchK, scratchV;
+
+  public:
+    OsmContentReader(map<long long, Coordinates>* nodeMap, vector<Coordinates>* nodeList,
+                     vector<FootwayInfo>& footways, vector<PendingBuilding>& pending, MapCounts& counts)
+      : nodeMap(nodeMap), nodeList(nodeList), footways(footways), pending(pending), counts(counts),
+        inWay(false), wayId(0), isFootway(false), isBuilding(false), hasName(false)
+    {
+    }
+
+    bool startElement(const XmlPullParser& parser, size_t depth);
+    void endElement(size_t depth);
+};
+
+
+//
+// startElement
+//
+bool OsmContentReader::startElement(const XmlPullParser& parser, size_t depth)
+{
+  string_view name = parser.name();
+
+  if (depth == 1 && name == "node")
+  {
+    const XmlPullParser::Attribute* attrId = parser.findAttribute("id");
+    const XmlPullParser::Attribute* attrLat = parser.findAttribute("lat");
+    const XmlPullParser::Attribute* attrLon = parser.findAttribute("lon");
+
+    if (attrId == nullptr || attrLat == nullptr || attrLon == nullptr)
+      return false;
+
+    long long id = Int64Value(attrId);
+    double latitude = DoubleValue(attrLat);
+    double longitude = DoubleValue(attrLon);
+
+    counts.Nodes++;
+
+    if (nodeMap != nullptr)
+      (*nodeMap)[id] = Coordinates(id, latitude, longitude);
+    else
+      nodeList->push_back(Coordinates(id, latitude, longitude));
+  }
+  else if (depth == 1 && name == "way")
+  {
+    const XmlPullParser::Attribute* attr = parser.findAttribute("id");
+
+    if (attr == nullptr)
+      return false;
+
+    inWay = true;
+    wayId = Int64Value(attr);
+    wayNodes.clear();
+    isFootway = false;
+    isBuilding = false;
+    hasName = false;
+  }
+  else if (depth == 2 && inWay && name == "nd")
+  {
+    const XmlPullParser::Attribute* ndref = parser.findAttribute("ref");
+
+    if (ndref == nullptr)
+      return false;
+
+    wayNodes.push_back(Int64Value(ndref));
+  }
+  else if (depth == 2 && inWay && name == "tag")
+  {
+    const XmlPullParser::Attribute* attrk = parser.findAttribute("k");
+    const XmlPullParser::Attribute* attrv = parser.findAttribute("v");
+
+    if (attrk != nullptr && attrv != nullptr)
+    {
+      string_view k_value = AttributeValue(attrk, scratchK);
+      string_view v_value = AttributeValue(attrv, scratchV);
+
+      if (k_value == "highway" && v_value == "footway")
+      {
+        isFootway = true;
+      }
+
+      if (k_value == "building" && v_value == "university")
+      {
+        isBuilding = true;
+      }
+
+      if (k_value == "name")
+      {
+        hasName = true;
+        buildingName = string(v_value);
+      }
+    }
+  }
+
+  return true;
+}
+
+
+//
+// endElement
+//
+// depth is the depth of the element just ended, not counting it.
+//
+void OsmContentReader::endElement(size_t depth)
+{
+  if (depth != 0 || !inWay)
+    return;
+
+  //
+  // end of the way, store it if it is a footway or a building:
+  //
+  inWay = false;
+
+  if (isFootway)
+  {
+    FootwayInfo footway(wayId);
+    footway.Nodes = wayNodes;
+
+    footways.push_back(footway);
+    counts.Footways++;
+  }
+
+  if (isBuilding && hasName)
+  {
+    pending.push_back(PendingBuilding{wayId, buildingName, wayNodes});
+    counts.Buildings++;
+  }
+}
+
+
+//
+// ReadOsmSerially
+//
+// Reads the whole map with one parser, the contents of the first
+// top-level osm element.  Prints an error and returns false if the file
+// is not well-formed XML, has no osm element, or has a node or way
+// without the attributes it needs.
+//
+static bool ReadOsmSerially(ByteSource& source, const string& filename,
+  map<long long, Coordinates>& Nodes,
+  vector<FootwayInfo>& Footways,
+  vector<PendingBuilding>& Pending,
+  MapCounts& Counts)
+{
+  XmlPullParser parser(source);
+  OsmContentReader content(&Nodes, nullptr, Footways, Pending, Counts);
+
+  bool inOsm = false;    // inside the first top-level "osm" element
+  bool seenOsm = false;
+
+  for (;;)
+  {
+    XmlPullParser::Event event = parser.next();
+
+    if (event == XmlPullParser::END_DOCUMENT)
+    {
+      break;
+    }
+
+    if (event == XmlPullParser::PARSE_ERROR)
+    {
+      cout << "**ERROR: unable to open map file '" << filename << "'." << endl;
+      return false;
+    }
+
+    size_t depth = parser.depth();
+
+    if (event == XmlPullParser::END_ELEMENT)
+    {
+      if (depth == 0)
+        inOsm = false;
+      else if (inOsm)
+        content.endElement(depth - 1);
+    }
+    else if (depth == 1)
+    {
+      inOsm = !seenOsm && parser.name() == "osm";
+      seenOsm = seenOsm || inOsm;
+    }
+    else if (inOsm && !content.startElement(parser, depth - 1))
+    {
+      cout << "**ERROR: unable to open map file '" << filename << "'." << endl;
+      return false;
+    }
+  }
+
+  if (!seenOsm)
+  {
+    cout << "**ERROR: unable to find top-level 'osm' XML element." << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+//
+// Minimum size of a piece of the map read by one thread; smaller maps
+// are not worth splitting.
+//
+static const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+
+//
+// OsmChunk
+//
+// What one thread reads from its piece of the map.  Nodes are sorted by
+// ID, keeping only the last occurrence of an ID, ready to be merged.
+//
+struct OsmChunk
+{
+  size_t First, Last;   // byte range of the piece
+  vector<Coordinates> Nodes;
+  vector<FootwayInfo> Footways;
+  vector<PendingBuilding> Pending;
+  MapCounts Counts;
+  bool Ok;
+};
+
+
+//
+// NextSplitPoint
+//
+// Returns the position of the first node, way or relation start tag at
+// or after from, or the end of text if there is none.  These are the
+// elements directly inside osm, so the map can be split before any of
+// them.
+//
+static size_t NextSplitPoint(string_view text, size_t from)
+{
+  static const string_view names[] = {"node", "way", "relation"};
+
+  for (size_t i = text.find('<', from); i != string_view::npos; i = text.find('<', i + 1))
+  {
+    string_view tag = text.substr(i + 1);
+
+    for (string_view name : names)
+    {
+      if (tag.size() > name.size() && tag.substr(0, name.size()) == name &&
+          strchr(" \t\r\n/>", tag[name.size()]) != nullptr)
+        return i;
+    }
+  }
+
+  return text.size();
+}
+
+
+//
+// ReadOsmChunk
+//
+// Reads a piece of the contents of the osm element.  The piece must
+// hold whole elements only, and no comments, CDATA sections or
+// processing instructions, whose text could have been mistaken for a
+// split point.  Sets chunk.Ok to false if it does not, or if it cannot
+// be read.
+//
+static void ReadOsmChunk(const char* data, OsmChunk& chunk)
+{
+  string_view text(data + chunk.First, chunk.Last - chunk.First);
+  chunk.Ok = false;
+
+  if (text.find("<!") != string_view::npos || text.find("<?") != string_view::npos)
+    return;
+
+  if (text.find('<') != string_view::npos)
+  {
+    MemorySource source(text.data(), text.size());
+    XmlPullParser parser(source);
+    OsmContentReader content(nullptr, &chunk.Nodes, chunk.Footways, chunk.Pending, chunk.Counts);
+
+    parser.parseFragment();
+
+    for (;;)
+    {
+      XmlPullParser::Event event = parser.next();
+
+      if (event == XmlPullParser::END_DOCUMENT)
+        break;
+
+      if (event == XmlPullParser::PARSE_ERROR)
+        return;
+
+      if (event == XmlPullParser::START_ELEMENT)
+      {
+        if (!content.startElement(parser, parser.depth()))
+          return;
+      }
+      else
+        content.endElement(parser.depth());
+    }
+  }
+
+  //
+  // sort the nodes by ID; of repeated IDs the last one read wins, as it
+  // does when they overwrite each other in the map:
+  //
+  stable_sort(chunk.Nodes.begin(), chunk.Nodes.end(),
+    [](const Coordinates& c1, const Coordinates& c2)
+    {
+      return c1.ID < c2.ID;
+    });
+
+  size_t kept = 0;
+
+  for (size_t i = 0; i < chunk.Nodes.size(); i++)
+  {
+    if (i + 1 < chunk.Nodes.size() && chunk.Nodes[i + 1].ID == chunk.Nodes[i].ID)
+      continue;
+
+    chunk.Nodes[kept++] = chunk.Nodes[i];
+  }
+
+  chunk.Nodes.resize(kept);
+  chunk.Ok = true;
+}
+
+
+//
+// ReadOsmInParallel
+//
+// Reads a map held in memory by splitting the contents of its osm
+// element into numChunks pieces at element boundaries and reading them
+// on separate threads.  The results are then merged in document order,
+// so they are the same as reading the map serially.
+//
+// Returns false, without touching the outputs, if the map is not laid
+// out plainly enough to be split safely: a single top-level osm element
+// whose contents are elements and whitespace only.  The caller then
+// reads it serially, which also reports any error.
+//
+static bool ReadOsmInParallel(const char* data, size_t size, size_t numChunks,
+  map<long long, Coordinates>& Nodes,
+  vector<FootwayInfo>& Footways,
+  vector<PendingBuilding>& Pending,
+  MapCounts& Counts)
+{
+  string_view text(data, size);
+
+  //
+  // the contents of the osm element, from the end of its start tag to
+  // the start of its end tag, which must be the last markup in the map:
+  //
+  MemorySource source(data, size);
+  XmlPullParser parser(source);
+
+  if (parser.next() != XmlPullParser::START_ELEMENT || parser.name() != "osm")
+    return false;
+
+  size_t contentsStart = parser.offset();
+  size_t contentsEnd = text.rfind("</osm");
+
+  if (text[contentsStart - 2] == '/' || contentsEnd == string_view::npos || contentsEnd < contentsStart)
+    return false;
+
+  size_t tail = text.find_first_not_of(" \t\r\n", contentsEnd + 5);
+
+  if (tail == string_view::npos || text[tail] != '>' ||
+      text.find_first_not_of(" \t\r\n", tail + 1) != string_view::npos)
+    return false;
+
+  //
+  // split the contents, and read each piece on its own thread:
+  //
+  string_view contents = text.substr(contentsStart, contentsEnd - contentsStart);
+  vector<OsmChunk> chunks;
+  size_t first = 0;
+
+  for (size_t c = 1; c <= numChunks; c++)
+  {
+    size_t last = (c == numChunks) ? contents.size()
+                                   : NextSplitPoint(contents, max(first, contents.size() / numChunks * c));
+
+    if (last > first || c == numChunks)
+    {
+      chunks.push_back(OsmChunk());
+      chunks.back().First = contentsStart + first;
+      chunks.back().Last = contentsStart + last;
+      first = last;
+    }
+  }
+
+  vector<thread> workers;
+
+  for (OsmChunk& chunk : chunks)
+  {
+    workers.push_back(thread([data, &chunk]() {
+      ReadOsmChunk(data, chunk);
+    }));
+  }
+
+  for (thread& worker : workers)
+  {
+    worker.join();
+  }
+
+  for (const OsmChunk& chunk : chunks)
+  {
+    if (!chunk.Ok)
+      return false;
+  }
+
+  //
+  // merge in document order; each piece's nodes are sorted, so they go
+  // into the map next to the previous one:
+  //
+  for (OsmChunk& chunk : chunks)
+  {
+    if (!chunk.Nodes.empty())
+    {
+      auto hint = Nodes.lower_bound(chunk.Nodes.front().ID);
+
+      for (const Coordinates& node : chunk.Nodes)
+      {
+        hint = next(Nodes.insert_or_assign(hint, node.ID, node));
+      }
+    }
+
+    move(chunk.Footways.begin(), chunk.Footways.end(), back_inserter(Footways));
+    move(chunk.Pending.begin(), chunk.Pending.end(), back_inserter(Pending));
+
+    Counts.Nodes += chunk.Counts.Nodes;
+    Counts.Footways += chunk.Counts.Footways;
+    Counts.Buildings += chunk.Counts.Buildings;
+  }
+
+  return true;
+}
+
+
+//
+// StreamOpenStreetMap
+//
+// Reads the nodes, footways and university buildings of a map in a
+// single pass over the file, without loading it into an XMLDocument.
+// The results (and error messages) are the same as LoadOpenStreetMap
+// followed by ReadMapNodes, ReadFootways and ReadUniversityBuildings,
+// but only the extracted data is kept in memory, not the whole file.
+// Building positions are averaged at the end of the file, in case a
+// building refers to nodes that come after it.
+//
+// With MapFile set, the file is memory-mapped and parsed in place, so
+// attribute values are read straight out of the mapping; if it cannot
+// be mapped, it is read in chunks instead.  A mapped file of a few
+// megabytes or more is split into pieces read by up to Threads threads
+// (0 for one per core).  A gzip or bzip2 compressed file is decompressed
+// a chunk at a time as it is parsed, on one thread.
+//
+bool StreamOpenStreetMap(string filename,
+  map<long long, Coordinates>& Nodes,
+  vector<FootwayInfo>& Footways,
+  vector<BuildingInfo>& Buildings,
+  MapCounts& Counts,
+  bool MapFile,
+  unsigned Threads)
+{
+  unique_ptr<ByteSource> source = OpenMapSource(filename, MapFile);
+
+  if (source == nullptr)
+  {
+    cout << "**ERROR: unable to open map file '" << filename << "'." << endl;
+    return false;
+  }
+
+  vector<PendingBuilding> pending;
+
+  if (Threads == 0)
+    Threads = max(1u, thread::hardware_concurrency());
+
+  const char* data = nullptr;
+  size_t size = 0;
+  bool done = false;
+
+  if (Threads > 1 && source->contents(data, size) && size >= 2 * MIN_CHUNK_BYTES)
+  {
+    size_t numChunks = min((size_t)Threads, size / MIN_CHUNK_BYTES);
+    done = ReadOsmInParallel(data, size, numChunks, Nodes, Footways, pending, Counts);
+  }
+
+  if (!done && !ReadOsmSerially(*source, filename, Nodes, Footways, pending, Counts))
+  {
+    return false;
+  }
+
+  //
+  // position each building at the average of its perimeter nodes:
+  //
+  for (PendingBuilding& building : pending)
+  {
+    double totalLat = 0.0;
+    double totalLon = 0.0;
+    int    numNodes = 0;
+
+    for (long long id : building.Nodes)
+    {
+      assert(Nodes.find(id) != Nodes.end());
+
+      totalLat += Nodes[id].Lat;
+      totalLon += Nodes[id].Lon;
+      numNodes++;
+    }
+
+    double lat = totalLat / numNodes;
+    double lon = totalLon / numNodes;
+
+    Buildings.push_back(BuildingInfo(building.Fullname, BuildingAbbrev(building.Fullname), building.ID, lat, lon));
+  }
+
+  return true;
+}
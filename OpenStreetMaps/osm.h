@@ -16,6 +16,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <cstdint>
 
 #include "tinyxml2.h"
 
@@ -82,19 +83,24 @@ struct FootwayInfo
 // BuildingInfo
 //
 // Defines a campus building with a fullname, an abbreviation (e.g. SEO),
-// and the coordinates of the building (id, lat, lon).
+// and the coordinates of the building (id, lat, lon).  NearestNode is
+// the dense graph index of the footway node closest to the building,
+// filled in once the footway graph is built (-1, which router.h names
+// NO_VERTEX, until then, and for good if the map has no footway nodes).
 //
 struct BuildingInfo
 {
   string Fullname;
   string Abbrev;
   Coordinates Coords;
+  uint32_t NearestNode;
 
   BuildingInfo()
   {
     Fullname = "";
     Abbrev = "";
     Coords = Coordinates();
+    NearestNode = (uint32_t)-1;
   }
 
   BuildingInfo(string fullname, string abbrev, long long id, double lat, double lon)
@@ -102,6 +108,29 @@ struct BuildingInfo
     Fullname = fullname;
     Abbrev = abbrev;
     Coords = Coordinates(id, lat, lon);
+    NearestNode = (uint32_t)-1;
+  }
+};
+
+
+//
+// MapCounts
+//
+// Number of nodes, footways and university buildings read from a map,
+// the counts ReadMapNodes, ReadFootways and ReadUniversityBuildings
+// return.
+//
+struct MapCounts
+{
+  int Nodes;
+  int Footways;
+  int Buildings;
+
+  MapCounts()
+  {
+    Nodes = 0;
+    Footways = 0;
+    Buildings = 0;
   }
 };
 
@@ -115,3 +144,10 @@ int  ReadFootways(XMLDocument& xmldoc, vector<FootwayInfo>& Footways);
 int  ReadUniversityBuildings(XMLDocument& xmldoc,
        map<long long, Coordinates>& Nodes,
        vector<BuildingInfo>& Buildings);
+bool StreamOpenStreetMap(string filename,
+       map<long long, Coordinates>& Nodes,
+       vector<FootwayInfo>& Footways,
+       vector<BuildingInfo>& Buildings,
+       MapCounts& Counts,
+       bool MapFile = true,
+       unsigned Threads = 0);
@@ -0,0 +1,490 @@
+/*router.cpp*/
+
+//
+// Routing engine for the frozen footway graph, see router.h.
+//
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#include "router.h"
+
+using namespace std;
+
+
+//
+// SearchSpace
+//
+// Allocates the arrays of one search direction; all stamps start at
+// generation 0, which no query uses.
+//
+Router::SearchSpace::SearchSpace(size_t numVertices)
+  : dist(numVertices), pred(numVertices),
+    reachedStamp(numVertices, 0), settledStamp(numVertices, 0),
+    heap(numVertices)
+{
+}
+
+
+//
+// Router
+//
+// Sizes the workspace for the given graph, which must be frozen and
+// must outlive the router.
+//
+Router::Router(const graph<long long, double>& G)
+  : G(G), scale(1.0), landmarks(nullptr), generation(0), goal(NO_VERTEX), heuristic(NO_HEURISTIC),
+    forward(G.NumVertices()), settled(0)
+{
+  assert(G.isFrozen());
+}
+
+
+//
+// Router
+//
+// Same as above, and also keeps the position of every node (indexed by
+// dense index) for A* queries.  Positions are converted to radians once
+// here so the heuristic needs no map lookups or degree conversions.
+//
+// The edge weights come from the acos form in dist.cpp, whose rounding
+// error grows as edges get shorter (about 0.5% for a 1 m edge), so an
+// edge can weigh less than the great-circle distance between its ends.
+// A* settles each vertex only once, which is exact only if the bound
+// never drops by more than an edge weighs along the edge.  So the bound
+// is scaled by the smallest ratio of weight to great-circle distance
+// over all edges, shaved a little more for rounding in the haversine.
+//
+Router::Router(const graph<long long, double>& G, const vector<Coordinates>& NodeCoords)
+  : Router(G)
+{
+  assert(NodeCoords.size() == (size_t)G.NumVertices());
+
+  const double PI = 3.14159265;  // same constant as distBetween2Points
+
+  points.reserve(NodeCoords.size());
+
+  for (const Coordinates& coords : NodeCoords)
+  {
+    double latRad = coords.Lat * PI / 180.0;
+    double lonRad = coords.Lon * PI / 180.0;
+
+    points.push_back(NodePoint{latRad, lonRad, cos(latRad)});
+  }
+
+  for (uint32_t v = 0; v < (uint32_t)G.NumVertices(); v++)
+  {
+    for (auto edge : G.edges(v))
+    {
+      double straight = greatCircle(points[v], points[edge.neighbor]);
+
+      if (straight > 0 && edge.weight < scale * straight)
+        scale = edge.weight / straight;
+    }
+  }
+
+  scale *= 1.0 - 1e-9;
+}
+
+
+//
+// startQuery
+//
+// Advances to a new generation, which invalidates the results of the
+// previous query without touching the arrays.  Only when the counter
+// wraps around do the stamps have to be cleared.
+//
+void Router::startQuery()
+{
+  generation++;
+
+  if (generation == 0)
+  {
+    for (SearchSpace* space : {&forward, &backward})
+    {
+      fill(space->reachedStamp.begin(), space->reachedStamp.end(), 0);
+      fill(space->settledStamp.begin(), space->settledStamp.end(), 0);
+    }
+    generation = 1;
+  }
+
+  forward.heap.clear();
+  backward.heap.clear();
+  settled = 0;
+  goal = NO_VERTEX;
+  heuristic = NO_HEURISTIC;
+}
+
+
+//
+// isReached
+//
+bool Router::isReached(const SearchSpace& space, uint32_t v) const
+{
+  return space.reachedStamp[v] == generation;
+}
+
+
+//
+// greatCircle
+//
+// The haversine form of the great-circle distance in miles, which
+// unlike the acos form in dist.cpp stays accurate for nearby points.
+//
+double Router::greatCircle(const NodePoint& p1, const NodePoint& p2) const
+{
+  const double earth_rad = 3963.1;  // statute miles, same as distBetween2Points
+
+  double sinLat = sin((p2.LatRad - p1.LatRad) / 2.0);
+  double sinLon = sin((p2.LonRad - p1.LonRad) / 2.0);
+  double a = sinLat * sinLat + p1.CosLat * p2.CosLat * sinLon * sinLon;
+
+  return 2.0 * earth_rad * asin(sqrt(min(a, 1.0)));
+}
+
+
+//
+// estimate
+//
+// A* heuristic: a lower bound on the walking distance from v to the
+// goal, or 0 when no A* query is running.  ALT queries take the bound
+// from the landmarks; otherwise this is the great-circle distance,
+// scaled down so that it stays consistent with the edge weights (see
+// the constructor).
+//
+double Router::estimate(uint32_t v) const
+{
+  if (goal == NO_VERTEX)
+    return 0;
+
+  if (heuristic == LANDMARKS)
+    return landmarks->lowerBound(v, goal);
+
+  return scale * greatCircle(points[v], points[goal]);
+}
+
+
+//
+// reach
+//
+// Records distance d and predecessor p for v, and queues v (or lowers
+// its key) in the heap of the search direction.  During A* the key is
+// the distance plus the estimate of the remaining distance.
+//
+void Router::reach(SearchSpace& space, uint32_t v, double d, uint32_t p)
+{
+  space.dist[v] = d;
+  space.pred[v] = p;
+  space.reachedStamp[v] = generation;
+  space.heap.pushOrDecrease(v, d + estimate(v));
+}
+
+
+//
+// settleNext
+//
+// Settles the closest queued vertex of a search direction and relaxes
+// its edges (incoming edges if reverse is true).  If the opposite
+// direction is given, every vertex reached by both searches is checked
+// as a meeting point, keeping the best total distance in best/meet.
+// Returns the settled vertex.
+//
+uint32_t Router::settleNext(SearchSpace& space, bool reverse, const SearchSpace* other,
+                            double& best, uint32_t& meet)
+{
+  uint32_t currV = space.heap.pop();
+  space.settledStamp[currV] = generation;
+  settled++;
+
+  for (auto edge : (reverse ? G.inEdges(currV) : G.edges(currV)))
+  {
+    uint32_t adjV = edge.neighbor;
+
+    if (space.settledStamp[adjV] == generation)
+      continue;
+
+    double alternativePathDist = space.dist[currV] + edge.weight;
+
+    // first time reached in this query, or a shorter path was found:
+    if (!isReached(space, adjV) || alternativePathDist < space.dist[adjV])
+    {
+      reach(space, adjV, alternativePathDist, currV);
+    }
+
+    if (other != nullptr && isReached(*other, adjV))
+    {
+      double total = space.dist[adjV] + other->dist[adjV];
+
+      if (total < best)
+      {
+        best = total;
+        meet = adjV;
+      }
+    }
+  }
+
+  return currV;
+}
+
+
+//
+// search
+//
+// Forward Dijkstra from the source.  Stops as soon as the target is
+// settled, or settles everything reachable if target is NO_VERTEX.
+// Unless directedBy is NO_HEURISTIC, the search is ordered by that
+// A* estimate of the remaining distance to the target.
+//
+void Router::search(uint32_t source, uint32_t target, Heuristic directedBy)
+{
+  startQuery();
+
+  if (directedBy != NO_HEURISTIC)
+  {
+    goal = target;
+    heuristic = directedBy;
+  }
+
+  reach(forward, source, 0, NO_VERTEX);
+
+  double best = INF;
+  uint32_t meet = NO_VERTEX;
+
+  while (!forward.heap.empty())
+  {
+    if (settleNext(forward, false, nullptr, best, meet) == target)
+      break;
+  }
+}
+
+
+//
+// shortestPaths
+//
+// Dijkstra's algorithm from the source vertex (dense index), settling
+// every vertex reachable from it.  Afterwards distance() and path()
+// answer for any vertex.
+//
+void Router::shortestPaths(uint32_t source)
+{
+  search(source, NO_VERTEX, NO_HEURISTIC);
+}
+
+
+//
+// forwardRoute
+//
+// Packages the result of the last forward search for the target.
+//
+RouteInfo Router::forwardRoute(uint32_t target) const
+{
+  RouteInfo route;
+  route.Settled = settled;
+
+  if (reached(target))
+  {
+    route.Distance = distance(target);
+    route.Path = path(target);
+  }
+
+  return route;
+}
+
+
+//
+// shortestPath
+//
+// Point-to-point Dijkstra: stops as soon as the target is settled, so
+// only vertices closer to the source than the target are settled.
+//
+RouteInfo Router::shortestPath(uint32_t source, uint32_t target)
+{
+  search(source, target, NO_HEURISTIC);
+
+  return forwardRoute(target);
+}
+
+
+//
+// bidirectionalPath
+//
+// Point-to-point Dijkstra that alternates between a forward search from
+// the source and a backward search (over incoming edges) from the
+// target, always expanding the side with the smaller queue.  Once the
+// two smallest queued distances add up to at least the best meeting
+// distance found, no shorter path can exist and the search stops.
+//
+RouteInfo Router::bidirectionalPath(uint32_t source, uint32_t target)
+{
+  if (backward.dist.size() != forward.dist.size())
+  {
+    backward = SearchSpace(forward.dist.size());
+  }
+
+  startQuery();
+  reach(forward, source, 0, NO_VERTEX);
+  reach(backward, target, 0, NO_VERTEX);
+
+  double best = INF;
+  uint32_t meet = NO_VERTEX;
+
+  if (source == target)
+  {
+    best = 0;
+    meet = source;
+  }
+
+  while (!forward.heap.empty() && !backward.heap.empty())
+  {
+    if (forward.heap.topKey() + backward.heap.topKey() >= best)
+      break;
+
+    if (forward.heap.size() <= backward.heap.size())
+      settleNext(forward, false, &backward, best, meet);
+    else
+      settleNext(backward, true, &forward, best, meet);
+  }
+
+  RouteInfo route;
+  route.Settled = settled;
+
+  if (meet == NO_VERTEX)
+    return route;
+
+  route.Distance = best;
+
+  // source ... meet from the forward predecessors:
+  for (uint32_t currV = meet; currV != NO_VERTEX; currV = forward.pred[currV])
+    route.Path.push_back(currV);
+
+  reverse(route.Path.begin(), route.Path.end());
+
+  // meet ... target from the backward predecessors, which point toward the target:
+  for (uint32_t currV = backward.pred[meet]; currV != NO_VERTEX; currV = backward.pred[currV])
+    route.Path.push_back(currV);
+
+  return route;
+}
+
+
+//
+// astarPath
+//
+// Point-to-point A* search: Dijkstra ordered by distance so far plus
+// the great-circle distance to the target.  The straight-line bound
+// pulls the search toward the target, so far fewer vertices are
+// settled than by plain Dijkstra.  Requires node coordinates.
+//
+RouteInfo Router::astarPath(uint32_t source, uint32_t target)
+{
+  assert(!points.empty());
+
+  search(source, target, GREAT_CIRCLE);
+
+  return forwardRoute(target);
+}
+
+
+//
+// useLandmarks
+//
+// Gives the router a built landmark set for altPath; it must outlive
+// the router (or the next call to useLandmarks).
+//
+void Router::useLandmarks(const LandmarkSet& L)
+{
+  assert(L.size() > 0);
+
+  landmarks = &L;
+}
+
+
+//
+// altPath
+//
+// Point-to-point A* search using the landmark bounds instead of the
+// straight-line distance.  The landmark bounds follow the footways, so
+// they stay tight where the walk has to go around obstacles.
+//
+RouteInfo Router::altPath(uint32_t source, uint32_t target)
+{
+  assert(landmarks != nullptr);
+
+  search(source, target, LANDMARKS);
+
+  return forwardRoute(target);
+}
+
+
+//
+// reached
+//
+// Returns true if the last forward search found a path to v.
+//
+bool Router::reached(uint32_t v) const
+{
+  return generation != 0 && isReached(forward, v);
+}
+
+
+//
+// distance
+//
+// Returns the distance found to v by the last forward search, or INF
+// if v was not reached.
+//
+double Router::distance(uint32_t v) const
+{
+  return reached(v) ? forward.dist[v] : INF;
+}
+
+
+//
+// predecessor
+//
+// Returns the vertex before v on the shortest path found by the last
+// forward search, or NO_VERTEX if v is the source or was not reached.
+//
+uint32_t Router::predecessor(uint32_t v) const
+{
+  return reached(v) ? forward.pred[v] : NO_VERTEX;
+}
+
+
+//
+// path
+//
+// Returns the dense indices on the shortest path from the source of
+// the last forward search to target, or just the target if it was not
+// reached.
+//
+vector<uint32_t> Router::path(uint32_t target) const
+{
+  vector<uint32_t> pathVector;
+
+  // trace back using predecessors, then reverse into source-first order:
+  uint32_t currV = target;
+
+  while (currV != NO_VERTEX)
+  {
+    pathVector.push_back(currV);
+    currV = predecessor(currV);
+  }
+
+  reverse(pathVector.begin(), pathVector.end());
+
+  return pathVector;
+}
+
+
+//
+// settledCount
+//
+// Returns the number of vertices settled by the last query.
+//
+size_t Router::settledCount() const
+{
+  return settled;
+}
@@ -0,0 +1,138 @@
+/*router.h*/
+
+//
+// Routing engine for the frozen footway graph.  A Router owns dense
+// distance, predecessor and visited arrays plus an indexed d-ary heap,
+// all sized once for the graph and reused across queries.
+//
+// Instead of clearing its arrays before every query, the router stamps
+// each vertex with the generation (query number) in which it was last
+// touched; a vertex whose stamp is older than the current generation
+// is treated as unreached.  A query therefore costs time proportional
+// to the vertices it reaches, not to the size of the graph.
+//
+// Queries:
+//   shortestPaths      single-source, settles everything reachable
+//   shortestPath       point-to-point, stops once the target is settled
+//   bidirectionalPath  point-to-point, searches forward from the source
+//                      and backward from the target until they meet
+//   astarPath          point-to-point, goal-directed by the straight-line
+//                      (great-circle) distance to the target; needs the
+//                      node coordinates passed to the constructor
+//   altPath            point-to-point A* with landmark lower bounds (ALT);
+//                      needs a landmark set passed to useLandmarks
+//
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+
+#include "graph.h"
+#include "dheap.h"
+#include "osm.h"
+#include "landmarks.h"
+
+using namespace std;
+
+const double INF = numeric_limits<double>::max();
+const uint32_t NO_VERTEX = numeric_limits<uint32_t>::max();
+
+
+//
+// RouteInfo
+//
+// Result of a point-to-point query.  The path holds dense vertex
+// indices from source to target, and is empty if the target cannot be
+// reached (Distance is then INF).  Settled counts the vertices the
+// query settled, in both directions for a bidirectional search.
+//
+struct RouteInfo
+{
+  double Distance;
+  vector<uint32_t> Path;
+  size_t Settled;
+
+  RouteInfo()
+  {
+    Distance = INF;
+    Settled = 0;
+  }
+};
+
+
+class Router {
+  private:
+    //
+    // Workspace of one search direction.  dist and pred are only valid
+    // for vertices whose reachedStamp equals the current generation.
+    //
+    struct SearchSpace {
+      vector<double> dist;
+      vector<uint32_t> pred;
+      vector<uint32_t> reachedStamp;
+      vector<uint32_t> settledStamp;
+      dheap<double> heap;
+
+      explicit SearchSpace(size_t numVertices = 0);
+    };
+
+    //
+    // Node position in radians, precomputed for the A* heuristic.
+    //
+    struct NodePoint {
+      double LatRad;
+      double LonRad;
+      double CosLat;
+    };
+
+    //
+    // Lower bound used to direct the current query toward its goal.
+    //
+    enum Heuristic {
+      NO_HEURISTIC,
+      GREAT_CIRCLE,
+      LANDMARKS
+    };
+
+    const graph<long long, double>& G;
+    vector<NodePoint> points;  // by dense index, empty if no coordinates were given
+    double scale;              // factor keeping the great-circle bound under every edge weight
+    const LandmarkSet* landmarks;  // set by useLandmarks, or nullptr
+
+    uint32_t generation;     // number of the current query
+    uint32_t goal;           // target of the current goal-directed query, or NO_VERTEX
+    Heuristic heuristic;     // lower bound of the current goal-directed query
+    SearchSpace forward;     // search from the source
+    SearchSpace backward;    // search from the target, sized on first use
+    size_t settled;          // number of vertices settled by the current query
+
+    void startQuery();
+    bool isReached(const SearchSpace& space, uint32_t v) const;
+    double greatCircle(const NodePoint& p1, const NodePoint& p2) const;
+    double estimate(uint32_t v) const;
+    void reach(SearchSpace& space, uint32_t v, double d, uint32_t p);
+    uint32_t settleNext(SearchSpace& space, bool reverse, const SearchSpace* other,
+                        double& best, uint32_t& meet);
+    void search(uint32_t source, uint32_t target, Heuristic directedBy);
+    RouteInfo forwardRoute(uint32_t target) const;
+
+  public:
+    Router(const graph<long long, double>& G);
+    Router(const graph<long long, double>& G, const vector<Coordinates>& NodeCoords);
+
+    void shortestPaths(uint32_t source);
+    RouteInfo shortestPath(uint32_t source, uint32_t target);
+    RouteInfo bidirectionalPath(uint32_t source, uint32_t target);
+    RouteInfo astarPath(uint32_t source, uint32_t target);
+
+    void useLandmarks(const LandmarkSet& L);
+    RouteInfo altPath(uint32_t source, uint32_t target);
+
+    bool reached(uint32_t v) const;
+    double distance(uint32_t v) const;
+    uint32_t predecessor(uint32_t v) const;
+    vector<uint32_t> path(uint32_t target) const;
+    size_t settledCount() const;
+};
@@ -0,0 +1,181 @@
+/*sptcache.cpp*/
+
+//
+// Cache of single-source shortest-path trees, see sptcache.h.
+//
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cassert>
+
+#include "sptcache.h"
+
+using namespace std;
+
+
+//
+// ShortestPathCache
+//
+// The graph must be frozen and must outlive the cache; it may be
+// rebuilt in between lookups.  capacity is the number of trees kept
+// before the least recently used is dropped.
+//
+ShortestPathCache::ShortestPathCache(const graph<long long, double>& G, size_t capacity)
+  : G(G), version(G.version()), router(nullptr), capacity(max(capacity, (size_t)1)), useCounter(0), hitCount(0), missCount(0)
+{
+}
+
+
+//
+// lookup
+//
+// Returns the tree of the source for the current graph version,
+// computing it (and evicting the least recently used tree if the cache
+// is full) when it is not cached.  computed is set to true if the tree
+// had to be computed.  The reference is only valid until the next
+// lookup.
+//
+// The router, whose workspace is sized by the number of vertices, is
+// built by the first lookup, and built again (dropping all trees) by
+// the first lookup after the graph has changed.
+//
+ShortestPathCache::Tree& ShortestPathCache::lookup(uint32_t source, bool& computed)
+{
+  if (router == nullptr || G.version() != version)
+  {
+    trees.clear();
+    router = make_unique<Router>(G);
+    version = G.version();
+  }
+
+  useCounter++;
+
+  for (Tree& tree : trees)
+  {
+    if (tree.source == source)
+    {
+      tree.lastUsed = useCounter;
+      hitCount++;
+      computed = false;
+      return tree;
+    }
+  }
+
+  missCount++;
+  computed = true;
+
+  //
+  // reuse the slot of the least recently used tree, or add one:
+  //
+  Tree* slot = nullptr;
+
+  if (trees.size() < capacity)
+  {
+    trees.push_back(Tree());
+    slot = &trees.back();
+  }
+  else
+  {
+    slot = &trees[0];
+
+    for (Tree& tree : trees)
+    {
+      if (tree.lastUsed < slot->lastUsed)
+        slot = &tree;
+    }
+  }
+
+  router->shortestPaths(source);
+
+  size_t numVertices = G.NumVertices();
+  slot->source = source;
+  slot->lastUsed = useCounter;
+  slot->dist.resize(numVertices);
+  slot->pred.resize(numVertices);
+
+  for (uint32_t v = 0; v < numVertices; v++)
+  {
+    slot->dist[v] = router->distance(v);
+    slot->pred[v] = router->predecessor(v);
+  }
+
+  return *slot;
+}
+
+
+//
+// route
+//
+// Returns the shortest route from source to target, read from the
+// cached tree of the source.  Settled is the number of vertices the
+// router settled to build the tree, or 0 if it was already cached.
+//
+RouteInfo ShortestPathCache::route(uint32_t source, uint32_t target)
+{
+  bool computed;
+  Tree& tree = lookup(source, computed);
+
+  RouteInfo route;
+  route.Settled = computed ? router->settledCount() : 0;
+
+  if (tree.dist[target] == INF)
+    return route;
+
+  route.Distance = tree.dist[target];
+
+  // trace back using predecessors, then reverse into source-first order:
+  for (uint32_t currV = target; currV != NO_VERTEX; currV = tree.pred[currV])
+    route.Path.push_back(currV);
+
+  reverse(route.Path.begin(), route.Path.end());
+
+  return route;
+}
+
+
+//
+// distance
+//
+// Returns the shortest distance from source to target, or INF if the
+// target cannot be reached.
+//
+double ShortestPathCache::distance(uint32_t source, uint32_t target)
+{
+  bool computed;
+
+  return lookup(source, computed).dist[target];
+}
+
+
+//
+// clear
+//
+// Drops all cached trees.
+//
+void ShortestPathCache::clear()
+{
+  trees.clear();
+}
+
+
+//
+// hits
+//
+// Returns the number of lookups answered from a cached tree.
+//
+size_t ShortestPathCache::hits() const
+{
+  return hitCount;
+}
+
+
+//
+// misses
+//
+// Returns the number of lookups that had to compute a tree.
+//
+size_t ShortestPathCache::misses() const
+{
+  return missCount;
+}
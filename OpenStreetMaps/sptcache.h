@@ -0,0 +1,66 @@
+/*sptcache.h*/
+
+//
+// Cache of single-source shortest-path trees.
+//
+// When the destination building turns out to be unreachable, the
+// application keeps trying the next closest building while the two
+// start nodes stay the same.  Rather than searching again from the same
+// start node for every candidate, the full shortest-path tree of each
+// start node is computed once and kept: every later route from that
+// node, to any target, is a lookup into its distance and predecessor
+// arrays.
+//
+// The trees belong to one version of the graph: once the graph changes,
+// they are all dropped and the router is rebuilt for the new graph, so
+// a tree computed before the change is never handed out.  Only the
+// most recently used trees are kept, since each one holds an entry per
+// vertex.  The router is only allocated by the first lookup, so a cache
+// that is never asked costs next to nothing.
+//
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "graph.h"
+#include "router.h"
+
+using namespace std;
+
+class ShortestPathCache {
+  private:
+    //
+    // Shortest-path tree of one source, by dense index.  Unreached
+    // vertices have distance INF.
+    //
+    struct Tree {
+      uint32_t source;
+      vector<double> dist;
+      vector<uint32_t> pred;
+      uint64_t lastUsed;       // use counter value at the last lookup
+    };
+
+    const graph<long long, double>& G;
+    uint64_t version;          // graph version of the router and the trees
+    unique_ptr<Router> router; // sized for that version, null until the first lookup
+    size_t capacity;           // maximum number of trees kept
+    vector<Tree> trees;
+    uint64_t useCounter;
+    size_t hitCount;
+    size_t missCount;
+
+    Tree& lookup(uint32_t source, bool& computed);
+
+  public:
+    ShortestPathCache(const graph<long long, double>& G, size_t capacity = 8);
+
+    RouteInfo route(uint32_t source, uint32_t target);
+    double distance(uint32_t source, uint32_t target);
+
+    void clear();
+    size_t hits() const;
+    size_t misses() const;
+};
@@ -19,10 +19,42 @@
 #include <queue>
 #include <set>
 #include <map>
+#include <memory>
 #include <string>
+#include <tuple>
 #include <fstream>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <filesystem>
+#include <regex>
 
 #include "graph.h"
+#include "dheap.h"
+#include "osm.h"
+#include "router.h"
+#include "ch.h"
+#include "sptcache.h"
+#include "mapcache.h"
+#include "mapgraph.h"
+#include "xmlstream.h"
+#include "geoindex.h"
+#include "dist.h"
+
+#if defined(__has_include)
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define TESTING_ZLIB
+#endif
+#if __has_include(<bzlib.h>)
+#include <bzlib.h>
+#define TESTING_BZIP2
+#endif
+#endif
 
 using namespace std;
 
@@ -59,7 +91,7 @@ void buildGraph(string filename, graph<string,int>& G)
   //
   file >> v;
 
-  while (v != "#")
+  while (file.good() && v != "#")
   {
     cout << "Inputting vertices " << v << endl;
     if (!G.addVertex(v))
@@ -76,7 +108,7 @@ void buildGraph(string filename, graph<string,int>& G)
 
   file >> src;
 
-  while (src != "#")
+  while (file.good() && src != "#")
   {
     file >> dest;
     file >> weight;
@@ -130,31 +162,2947 @@ void outputGraph(graph<string,int>& G)
   cout << endl;
 }
 
-
-int main()
+//
+// outputEdges:
+//
+// Outputs the edges of every vertex using the graph's visitor API,
+// which reads each (neighbor, weight) pair without extra lookups.
+//
+void outputEdges(graph<string,int>& G)
 {
-  graph<string,int> G;
-  string filename;
-  string startV;
+  cout << "**Edges: ";
+
+  for (string v : G.getVertices())
+  {
+    G.forEachNeighbor(v, [&](const string& n, int weight)
+    {
+      cout << "(" << v << "," << n << "," << weight << ") ";
+    });
+  }
 
-  cout << "Enter filename containing graph data> ";
-  cin >> filename;
   cout << endl;
+}
 
-  //
-  // Let's input the graph, and then output to see what we have:
-  //
-  cout << "Building graph:" << endl;
-  buildGraph(filename, G);
-  
-  cout << endl << "Outputting graph:" << endl;
-  outputGraph(G);
-  
-  cout << endl << "Dumping graph:" << endl;
-  G.dump(cout);
+
+//
+// check:
+//
+// Records the outcome of one test, printing what failed (only the
+// first few failures, since one bug can fail thousands of queries).
+// main reports the totals and exits with a nonzero status if any test
+// failed.
+//
+int numChecks = 0;
+int numFailed = 0;
+
+bool check(bool passed, string what)
+{
+  numChecks++;
+
+  if (!passed)
+  {
+    numFailed++;
+
+    if (numFailed <= 20)
+      cout << "**FAILED: " << what << endl;
+  }
+
+  return passed;
+}
+
+//
+// sameDistance:
+//
+// Distances summed in a different order can differ in the last bits,
+// so they are compared with a small relative tolerance.
+//
+bool sameDistance(double d1, double d2)
+{
+  if (d1 == INF || d2 == INF)
+    return d1 == d2;
+
+  return fabs(d1 - d2) <= 1e-9 * max(1.0, fabs(d2));
+}
+
+//
+// sameBits:
+//
+// Returns true if two numbers are the same down to the bit, so that -0
+// differs from 0 and a NaN equals itself.
+//
+template<typename T>
+bool sameBits(T value1, T value2)
+{
+  return memcmp(&value1, &value2, sizeof(T)) == 0;
+}
+
+//
+// buildRoutingGraph:
+//
+// Inputs the same file as buildGraph into a graph with the vertex and
+// weight types the routing engine uses, each letter standing for the
+// vertex ID of its character code, and freezes it.
+//
+void buildRoutingGraph(string filename, graph<long long,double>& G)
+{
+  ifstream file(filename);
+  string   v;
+
+  file >> v;
+
+  while (file.good() && v != "#")
+  {
+    G.addVertex(v[0]);
+    file >> v;
+  }
+
+  string src, dest;
+  double weight;
+
+  file >> src;
+
+  while (file.good() && src != "#")
+  {
+    file >> dest;
+    file >> weight;
+
+    G.addEdge(src[0], dest[0], weight);
+
+    file >> src;
+  }
+
+  G.freeze();
+}
+
+//
+// buildFixedGraph:
+//
+// The graph of graph.txt, built in code for the tests that need a small
+// directed graph of their own whatever file is given on stdin: one-way
+// edges, and a vertex (H) with no way out.
+//
+void buildFixedGraph(graph<long long,double>& G)
+{
+  for (char v : string("ABCDEFGH"))
+    G.addVertex(v);
+
+  vector<tuple<char,char,double>> edges = {
+    {'G', 'E', 100}, {'G', 'C', 125}, {'G', 'A', 12}, {'E', 'G', 80}, {'E', 'C', 20}, {'E', 'D', 30},
+    {'E', 'H', 60}, {'C', 'D', 7}, {'A', 'B', 115}, {'B', 'D', 1}, {'D', 'F', 27}, {'D', 'H', 37},
+    {'F', 'D', 27}, {'F', 'H', 20}
+  };
+
+  for (auto& edge : edges)
+    G.addEdge(get<0>(edge), get<1>(edge), get<2>(edge));
+
+  G.freeze();
+}
+
+//
+// writeTestMap:
+//
+// Writes a small synthetic campus to the given file: an N x N grid of
+// footways over slightly jittered nodes, step degrees apart, a footway
+// island the grid cannot reach, a service road (not a footway), and
+// university buildings, one of them on the island.  The jitter comes
+// from a fixed seed, so every run writes the same map.
+//
+void writeTestMap(string filename, int N, double step = 0.0004)
+{
+  ofstream file(filename);
+  minstd_rand generator(7);
+  long long nextNode = 1000;
+  long long nextWay = 5000;
+  char line[160];
+
+  const double lat0 = 41.870, lon0 = -87.650;
+
+  file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << endl;
+  file << "<osm version=\"0.6\" generator=\"testing\">" << endl;
+
+  auto node = [&](double lat, double lon)
+  {
+    nextNode++;
+    snprintf(line, sizeof(line), " <node id=\"%lld\" visible=\"true\" version=\"1\" lat=\"%.7f\" lon=\"%.7f\"/>",
+             nextNode, lat, lon);
+    file << line << endl;
+    return nextNode;
+  };
+
+  auto jitter = [&]()
+  {
+    return ((int)(generator() % 2001) - 1000) * step / 40000;
+  };
+
+  vector<vector<long long>> grid(N, vector<long long>(N));
+
+  for (int i = 0; i < N; i++)
+  {
+    for (int j = 0; j < N; j++)
+    {
+      double lat = lat0 + i * step + jitter();
+      double lon = lon0 + j * step + jitter();
+
+      grid[i][j] = node(lat, lon);
+    }
+  }
+
+  vector<long long> island;
+
+  for (int k = 0; k < 4; k++)
+    island.push_back(node(lat0 - 0.01 + k * step, lon0 - 0.01));
+
+  vector<pair<string, vector<long long>>> buildings;
+
+  for (int b = 0; b < max(3, N / 3); b++)
+  {
+    double lat = lat0 + (generator() % (N - 1) + 0.5) * step;
+    double lon = lon0 + (generator() % (N - 1) + 0.5) * step;
+    vector<long long> ring;
+
+    for (int corner = 0; corner < 4; corner++)
+      ring.push_back(node(lat + (corner < 2 ? -1e-4 : 1e-4), lon + (corner % 3 == 0 ? -1e-4 : 1e-4)));
+
+    buildings.push_back(make_pair("Hall " + to_string(b) + " &amp; Annex (H" + to_string(b) + ")", ring));
+  }
+
+  buildings.push_back(make_pair("Island Lab (ISL)",
+    vector<long long>{node(lat0 - 0.01, lon0 - 0.0095), node(lat0 - 0.0099, lon0 - 0.0095),
+                      node(lat0 - 0.0099, lon0 - 0.0094)}));
+
+  auto way = [&](const vector<long long>& nodes, const vector<pair<string,string>>& tags)
+  {
+    nextWay++;
+    file << " <way id=\"" << nextWay << "\" visible=\"true\" version=\"1\">" << endl;
+
+    for (long long id : nodes)
+      file << "  <nd ref=\"" << id << "\"/>" << endl;
+
+    for (auto& tag : tags)
+      file << "  <tag k=\"" << tag.first << "\" v=\"" << tag.second << "\"/>" << endl;
+
+    file << " </way>" << endl;
+  };
+
+  for (int i = 0; i < N; i++)
+    way(grid[i], {{"highway", "footway"}, {"surface", "paved"}});
+
+  for (int j = 0; j < N; j++)
+  {
+    vector<long long> column;
+
+    for (int i = 0; i < N; i++)
+      column.push_back(grid[i][j]);
+
+    way(column, {{"highway", "footway"}});
+  }
+
+  way(island, {{"highway", "footway"}});
+  way({grid[0][0], grid[1][1]}, {{"highway", "service"}});
+
+  for (auto& building : buildings)
+  {
+    vector<long long> ring = building.second;
+    ring.push_back(ring[0]);
+
+    way(ring, {{"building", "university"}, {"name", building.first}});
+  }
+
+  file << " <!-- trailing comment -->" << endl;
+  file << "</osm>" << endl;
+}
+
+//
+// loadTestMap:
+//
+// Reads a map with the DOM loader and builds the frozen footway graph
+// and the dense node positions from it, as the application does.
+//
+bool loadTestMap(string filename, map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways,
+                 vector<BuildingInfo>& Buildings, graph<long long,double>& G, vector<Coordinates>& NodeCoords)
+{
+  XMLDocument xmldoc;
+
+  if (!LoadOpenStreetMap(filename, xmldoc))
+    return false;
+
+  ReadMapNodes(xmldoc, Nodes);
+  ReadFootways(xmldoc, Footways);
+  ReadUniversityBuildings(xmldoc, Nodes, Buildings);
+
+  populateGraph(Nodes, Footways, Buildings, G);
+  G.freeze();
+
+  vector<uint32_t> FootwayNodes;
+  buildNodeTables(Nodes, Footways, G, NodeCoords, FootwayNodes);
+
+  return true;
+}
+
+//
+// referenceDistances:
+//
+// Distances from the source (dense index) to every vertex by a plain
+// Dijkstra over the graph's ID-based API, neighbors and getWeight, the
+// way the application routed before it had a routing engine.  The
+// engine's answers are checked against these.
+//
+vector<double> referenceDistances(const graph<long long,double>& G, uint32_t source)
+{
+  vector<double> dist(G.NumVertices(), INF);
+  vector<bool> visited(G.NumVertices(), false);
+  priority_queue<pair<double,uint32_t>, vector<pair<double,uint32_t>>, greater<pair<double,uint32_t>>> unvisited;
+
+  dist[source] = 0;
+  unvisited.push(make_pair(0.0, source));
+
+  while (!unvisited.empty())
+  {
+    uint32_t currV = unvisited.top().second;
+    unvisited.pop();
+
+    if (visited[currV])
+      continue;
+
+    visited[currV] = true;
+
+    long long currID = G.vertexAt(currV);
+
+    for (long long adjID : G.neighbors(currID))
+    {
+      double weight = 0;
+      uint32_t adjV = 0;
+
+      G.getWeight(currID, adjID, weight);
+      G.vertexIndex(adjID, adjV);
+
+      if (dist[currV] + weight < dist[adjV])
+      {
+        dist[adjV] = dist[currV] + weight;
+        unvisited.push(make_pair(dist[adjV], adjV));
+      }
+    }
+  }
+
+  return dist;
+}
+
+//
+// isPath:
+//
+// Returns true if the path runs from source to target along edges of
+// the graph, and its edges add up to the given distance.
+//
+bool isPath(const graph<long long,double>& G, const vector<uint32_t>& path,
+            uint32_t source, uint32_t target, double distance)
+{
+  if (path.empty() || path.front() != source || path.back() != target)
+    return false;
+
+  double total = 0;
+
+  for (size_t i = 1; i < path.size(); i++)
+  {
+    double weight = 0;
+
+    if (!G.getWeight(G.vertexAt(path[i - 1]), G.vertexAt(path[i]), weight))
+      return false;
+
+    total += weight;
+  }
+
+  return sameDistance(total, distance);
+}
+
+//
+// checkRoute:
+//
+// Checks the answer of a point-to-point query against the reference
+// distance: the same distance and a path that has it, or no path at
+// all if the target cannot be reached.
+//
+void checkRoute(const graph<long long,double>& G, const RouteInfo& route,
+                uint32_t source, uint32_t target, double expected, string what)
+{
+  string query = what + " " + to_string(source) + " -> " + to_string(target);
+
+  if (expected == INF)
+  {
+    check(route.Distance == INF && route.Path.empty(), query + " should be unreachable");
+    return;
+  }
+
+  check(sameDistance(route.Distance, expected),
+        query + ": distance " + to_string(route.Distance) + ", expected " + to_string(expected));
+  check(isPath(G, route.Path, source, target, route.Distance), query + ": bad path");
+}
+
+//
+// testFreezeFrom:
+//
+// A graph given as compacted arrays must come out as if built edge by
+// edge, and arrays that do not form a graph, such as rows running past
+// the end of the targets, must be rejected without reading past them
+// and leave the graph empty.
+//
+void testFreezeFrom()
+{
+  graph<long long,double> G;
+
+  check(G.freezeFrom({10, 20, 30}, {0, 2, 3, 3}, {1, 2, 0}, {1.5, 2.5, 3.5}), "freezeFrom: valid arrays");
+
+  double weight = 0;
+
+  check(G.isFrozen() && G.NumVertices() == 3 && G.NumEdges() == 3, "freezeFrom: counts");
+  check(G.getWeight(10, 20, weight) && weight == 1.5 && G.getWeight(10, 30, weight) && weight == 2.5
+        && G.getWeight(20, 10, weight) && weight == 3.5 && !G.getWeight(30, 10, weight), "freezeFrom: edges");
+
+  struct Arrays {
+    string what;
+    vector<long long> vertices;
+    vector<size_t> offsets;
+    vector<uint32_t> targets;
+    vector<double> weights;
+  };
+
+  vector<Arrays> bad = {
+    {"row past the targets", {10, 20}, {0, 100, 2}, {0, 1}, {1, 1}},
+    {"offsets falling", {10, 20, 30}, {0, 2, 1, 2}, {1, 2}, {1, 1}},
+    {"offsets not starting at 0", {10, 20}, {1, 1, 2}, {1, 0}, {1, 1}},
+    {"offsets not ending at the edge count", {10, 20}, {0, 1, 1}, {1, 0}, {1, 1}},
+    {"too few offsets", {10, 20}, {0, 2}, {1, 0}, {1, 1}},
+    {"no offsets", {}, {}, {}, {}},
+    {"weights missing", {10, 20}, {0, 1, 2}, {1, 0}, {1}},
+    {"vertices out of order", {20, 10}, {0, 1, 2}, {1, 0}, {1, 1}},
+    {"vertex repeated", {10, 10}, {0, 1, 2}, {1, 0}, {1, 1}},
+    {"target out of range", {10, 20}, {0, 1, 2}, {2, 0}, {1, 1}},
+    {"row out of order", {10, 20, 30}, {0, 2, 2, 2}, {2, 1}, {1, 1}},
+    {"edge repeated", {10, 20}, {0, 2, 2}, {1, 1}, {1, 1}}
+  };
+
+  for (Arrays& arrays : bad)
+  {
+    check(!G.freezeFrom(arrays.vertices, arrays.offsets, arrays.targets, arrays.weights),
+          "freezeFrom: accepted " + arrays.what);
+    check(G.NumVertices() == 0 && G.NumEdges() == 0, "freezeFrom: not emptied after " + arrays.what);
+  }
+
+  check(G.freezeFrom({}, {0}, {}, {}) && G.NumVertices() == 0, "freezeFrom: empty graph");
+}
+
+//
+// testHeap:
+//
+// Pushes keys into the indexed heap, lowering some of them and pushing
+// others again with larger keys (which must not change them), and
+// checks that the items come out in key order.
+//
+void testHeap()
+{
+  const uint32_t N = 1000;
+  minstd_rand generator(251);
+  dheap<double> heap(N);
+  vector<double> keys(N);
+
+  for (uint32_t item = 0; item < N; item++)
+  {
+    keys[item] = generator() % 5000;
+    heap.pushOrDecrease(item, keys[item]);
+  }
+
+  for (uint32_t item = 0; item < N; item += 3)
+  {
+    double lower = keys[item] - 1 - generator() % 100;
+    check(heap.pushOrDecrease(item, lower), "heap: decrease of item " + to_string(item));
+    keys[item] = lower;
+
+    check(!heap.pushOrDecrease(item, lower + 1), "heap: increase of item " + to_string(item));
+  }
+
+  check(heap.size() == N, "heap: size");
+
+  double lastKey = -INF;
+  vector<bool> popped(N, false);
+
+  while (!heap.empty())
+  {
+    double key = heap.topKey();
+    uint32_t item = heap.pop();
+
+    check(key >= lastKey && key == keys[item] && !popped[item], "heap: pop order at item " + to_string(item));
+    check(!heap.contains(item), "heap: popped item still contained");
+
+    popped[item] = true;
+    lastKey = key;
+  }
+
+  heap.pushOrDecrease(5, 1.0);
+  heap.clear();
+  check(heap.empty() && !heap.contains(5), "heap: clear");
+}
+
+//
+// testShortestPaths:
+//
+// Single-source Dijkstra from every vertex must match the reference
+// distances, and path() must walk a shortest path.  One router answers
+// every query, so its workspace is reused throughout.
+//
+void testShortestPaths(const graph<long long,double>& G, string name)
+{
+  Router router(G);
+
+  for (uint32_t source = 0; source < (uint32_t)G.NumVertices(); source++)
+  {
+    vector<double> expected = referenceDistances(G, source);
+
+    router.shortestPaths(source);
+
+    for (uint32_t target = 0; target < (uint32_t)G.NumVertices(); target++)
+    {
+      string query = name + " shortestPaths " + to_string(source) + " -> " + to_string(target);
+
+      check(sameDistance(router.distance(target), expected[target]), query + ": distance");
+      check(router.reached(target) == (expected[target] != INF), query + ": reached");
+
+      if (router.reached(target))
+        check(isPath(G, router.path(target), source, target, router.distance(target)), query + ": bad path");
+    }
+  }
+}
+
+//
+// testPointToPoint:
+//
+// Point-to-point Dijkstra, which stops at the target, and bidirectional
+// Dijkstra must both find a shortest path between every pair, and must
+// agree that a pair is unreachable.  The queries alternate between the
+// two on one router, so each starts from the other's workspace.
+//
+void testPointToPoint(const graph<long long,double>& G, string name)
+{
+  Router router(G);
+
+  for (uint32_t source = 0; source < (uint32_t)G.NumVertices(); source++)
+  {
+    vector<double> expected = referenceDistances(G, source);
+
+    for (uint32_t target = 0; target < (uint32_t)G.NumVertices(); target++)
+    {
+      checkRoute(G, router.shortestPath(source, target), source, target, expected[target],
+                 name + " shortestPath");
+      checkRoute(G, router.bidirectionalPath(source, target), source, target, expected[target],
+                 name + " bidirectionalPath");
+    }
+  }
+}
+//
+// testAStar:
+//
+// A* by the great-circle bound must find a shortest path between every
+// pair, even where edges are so short that their weights (from the acos
+// form of the distance) come out below the great-circle distance.
+//
+void testAStar(const graph<long long,double>& G, const vector<Coordinates>& NodeCoords, string name)
+{
+  Router router(G, NodeCoords);
+
+  for (uint32_t source = 0; source < (uint32_t)G.NumVertices(); source++)
+  {
+    vector<double> expected = referenceDistances(G, source);
+
+    for (uint32_t target = 0; target < (uint32_t)G.NumVertices(); target++)
+    {
+      checkRoute(G, router.astarPath(source, target), source, target, expected[target],
+                 name + " astarPath");
+    }
+  }
+}
+//
+// testHierarchy:
+//
+// The contraction hierarchy must find a shortest path between every
+// pair, both as built and after saving it and loading it back.
+//
+void testHierarchy(const graph<long long,double>& G, string name)
+{
+  ContractionHierarchy CH;
+  CH.build(G);
+
+  string chFilename = "testing-graph.ch";
+  check(CH.save(chFilename), name + " hierarchy: save");
+
+  ContractionHierarchy loaded;
+  check(loaded.load(chFilename, G), name + " hierarchy: load");
+  check(loaded.isBuilt() && loaded.numShortcuts() == CH.numShortcuts(), name + " hierarchy: shortcuts after load");
+
+  for (uint32_t source = 0; source < (uint32_t)G.NumVertices(); source++)
+  {
+    vector<double> expected = referenceDistances(G, source);
+
+    for (uint32_t target = 0; target < (uint32_t)G.NumVertices(); target++)
+    {
+      checkRoute(G, CH.query(source, target), source, target, expected[target], name + " hierarchy");
+      checkRoute(G, loaded.query(source, target), source, target, expected[target], name + " loaded hierarchy");
+    }
+  }
+
+  remove(chFilename.c_str());
+}
+
+//
+// copyPrefix:
+//
+// Copies the first size bytes of a file (all of it if size is larger)
+// to another file.
+//
+void copyPrefix(string from, string to, size_t size)
+{
+  ifstream input(from, ios::binary);
+  string contents((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+
+  ofstream output(to, ios::binary);
+  output.write(contents.data(), min(size, contents.size()));
+}
+
+//
+// copyDamaged:
+//
+// Copies a file to another with the lowest bit of the byte at offset
+// flipped.
+//
+void copyDamaged(string from, string to, size_t offset)
+{
+  ifstream input(from, ios::binary);
+  string contents((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+
+  contents[offset] ^= 1;
+
+  ofstream output(to, ios::binary);
+  output.write(contents.data(), contents.size());
+}
+
+//
+// testHierarchyFiles:
+//
+// A saved hierarchy must be rejected, leaving the hierarchy unbuilt,
+// if it was saved for another graph (one of a different size, or the
+// same map with its nodes moved, so only the weights differ), or if
+// the file is missing, cut short or has any byte damaged.  A hierarchy
+// of the empty graph is built, saved and loaded like any other.
+//
+void testHierarchyFiles(const graph<long long,double>& G, const graph<long long,double>& other)
+{
+  string chFilename = "testing-map.ch";
+  string cutFilename = "testing-cut.ch";
+  string movedFilename = "testing-moved.osm";
+
+  ContractionHierarchy CH;
+  CH.build(G);
+  check(CH.save(chFilename), "hierarchy files: save");
+
+  ContractionHierarchy loaded;
+  check(!loaded.load(chFilename, other) && !loaded.isBuilt(), "hierarchy files: loaded for a graph of another size");
+
+  writeTestMap(movedFilename, 12, 0.0005);
+
+  map<long long, Coordinates> Nodes;
+  vector<FootwayInfo> Footways;
+  vector<BuildingInfo> Buildings;
+  graph<long long,double> moved;
+  vector<Coordinates> NodeCoords;
+
+  loadTestMap(movedFilename, Nodes, Footways, Buildings, moved, NodeCoords);
+  check(moved.NumVertices() == G.NumVertices() && moved.getVertices() == G.getVertices(),
+        "hierarchy files: moved map has the same vertices");
+  check(!loaded.load(chFilename, moved) && !loaded.isBuilt(), "hierarchy files: loaded for a moved map");
+
+  check(!loaded.load("testing-missing.ch", G), "hierarchy files: loaded a missing file");
+
+  ifstream file(chFilename, ios::binary | ios::ate);
+  size_t size = file.tellg();
+
+  for (size_t cut = 0; cut < size; cut += max((size_t)1, size / 16))
+  {
+    copyPrefix(chFilename, cutFilename, cut);
+    check(!loaded.load(cutFilename, G) && !loaded.isBuilt(),
+          "hierarchy files: loaded a file cut at " + to_string(cut) + " of " + to_string(size) + " bytes");
+  }
+
+  copyPrefix(chFilename, cutFilename, size - 1);
+  check(!loaded.load(cutFilename, G), "hierarchy files: loaded a file missing its last byte");
+
+  //
+  // a flipped bit in the edges or offsets can leave every index in
+  // range, so only the checksum catches most of these:
+  //
+  for (size_t offset = 0; offset < size; offset += max((size_t)1, size / 64))
+  {
+    copyDamaged(chFilename, cutFilename, offset);
+    check(!loaded.load(cutFilename, G) && !loaded.isBuilt(),
+          "hierarchy files: loaded a file damaged at " + to_string(offset) + " of " + to_string(size) + " bytes");
+  }
+
+  check(loaded.load(chFilename, G) && loaded.isBuilt(), "hierarchy files: load after rejections");
+
+  copyDamaged(chFilename, cutFilename, size - 1);
+  check(!loaded.load(cutFilename, G) && !loaded.isBuilt(), "hierarchy files: still built after a failed load");
+
+  check(loaded.load(chFilename, G) && loaded.isBuilt(), "hierarchy files: load after rejections");
+
+  ContractionHierarchy unbuilt;
+  check(!unbuilt.isBuilt() && !unbuilt.save(cutFilename), "hierarchy files: saved an unbuilt hierarchy");
+
+  graph<long long,double> empty;
+  empty.freeze();
+
+  ContractionHierarchy none;
+  none.build(empty);
+  check(none.isBuilt() && none.numShortcuts() == 0, "hierarchy files: built for the empty graph");
+  check(none.save(cutFilename), "hierarchy files: save for the empty graph");
+  check(unbuilt.load(cutFilename, empty) && unbuilt.isBuilt(), "hierarchy files: load for the empty graph");
+  check(!unbuilt.load(cutFilename, G) && !unbuilt.isBuilt(), "hierarchy files: loaded the empty graph's for another");
+
+  remove(chFilename.c_str());
+  remove(cutFilename.c_str());
+  remove(movedFilename.c_str());
+}
+//
+// testLandmarks:
+//
+// Every landmark bound must be a lower bound on the true distance, and
+// ALT queries must find a shortest path between every pair.
+//
+void testLandmarks(const graph<long long,double>& G, const vector<Coordinates>& NodeCoords, string name)
+{
+  LandmarkSet L;
+  L.build(G, NodeCoords, 8);
+  check(L.size() > 0 && L.size() <= 8 && L.vertices().size() == L.size(), name + " landmarks: size");
+
+  Router router(G);
+  router.useLandmarks(L);
+
+  for (uint32_t source = 0; source < (uint32_t)G.NumVertices(); source++)
+  {
+    vector<double> expected = referenceDistances(G, source);
+
+    for (uint32_t target = 0; target < (uint32_t)G.NumVertices(); target++)
+    {
+      if (expected[target] != INF)
+      {
+        check(L.lowerBound(source, target) <= expected[target] * (1 + 1e-9),
+              name + " landmarks: bound " + to_string(source) + " -> " + to_string(target));
+      }
+
+      checkRoute(G, router.altPath(source, target), source, target, expected[target], name + " altPath");
+    }
+  }
+}
+//
+// testTreeCache:
+//
+// Routes read from cached shortest-path trees must match the reference,
+// whether the tree was just computed, cached, or recomputed after it
+// was evicted or the cache cleared.  The hit and miss counts show which
+// of these happened.
+//
+void testTreeCache(const graph<long long,double>& G, string name)
+{
+  uint32_t N = G.NumVertices();
+  ShortestPathCache Trees(G, 2);
+  vector<vector<double>> expected;
+
+  for (uint32_t source = 0; source < N; source++)
+    expected.push_back(referenceDistances(G, source));
+
+  // every source once: one miss to compute its tree, then hits
+  for (uint32_t source = 0; source < N; source++)
+  {
+    for (uint32_t target = 0; target < N; target++)
+      checkRoute(G, Trees.route(source, target), source, target, expected[source][target], name + " tree cache");
+  }
+
+  check(Trees.misses() == N && Trees.hits() == (size_t)N * (N - 1), name + " tree cache: counts");
+
+  // three sources in turn through two slots: every lookup evicts the tree needed next
+  size_t misses = Trees.misses();
+  uint32_t sources[] = {0, N / 2, N - 1};
+
+  for (uint32_t target = 0; target < N; target++)
+  {
+    for (uint32_t source : sources)
+      checkRoute(G, Trees.route(source, target), source, target, expected[source][target], name + " evicting tree cache");
+  }
+
+  check(Trees.misses() - misses == 3 * (size_t)N, name + " tree cache: evictions");
+
+  Trees.clear();
+  misses = Trees.misses();
+
+  for (uint32_t target = 0; target < N; target++)
+  {
+    check(sameDistance(Trees.distance(N / 2, target), expected[N / 2][target]),
+          name + " cleared tree cache: distance to " + to_string(target));
+  }
+
+  check(Trees.misses() - misses == 1, name + " tree cache: clear");
+}
+
+//
+// testTreeCacheVersions:
+//
+// A cache kept while its graph is rebuilt must drop the trees of the
+// old graph and route on the new one, also when the new graph has more
+// vertices than the router was first sized for.
+//
+void testTreeCacheVersions()
+{
+  graph<long long,double> G;
+
+  // a path of n vertices, one way cheaper than the other, and a shortcut:
+  auto build = [&G](uint32_t n)
+  {
+    G.clear();
+
+    for (uint32_t v = 0; v < n; v++)
+      G.addVertex(100 + v);
+
+    for (uint32_t v = 0; v + 1 < n; v++)
+    {
+      G.addEdge(100 + v, 100 + v + 1, 1.0 + v % 3);
+      G.addEdge(100 + v + 1, 100 + v, 2.0);
+    }
+
+    G.addEdge(100, 100 + n - 1, n / 2.0);
+    G.freeze();
+  };
+
+  build(4);
+  ShortestPathCache Trees(G, 4);
+
+  check(sameDistance(Trees.distance(0, 3), referenceDistances(G, 0)[3]), "rebuilt tree cache: first graph");
+
+  for (uint32_t n : {40, 3, 200})
+  {
+    build(n);
+
+    size_t misses = Trees.misses();
+    string name = "rebuilt tree cache, " + to_string(n) + " vertices";
+
+    for (uint32_t source : {(uint32_t)0, n - 1})
+    {
+      vector<double> expected = referenceDistances(G, source);
+
+      for (uint32_t target = 0; target < n; target++)
+        checkRoute(G, Trees.route(source, target), source, target, expected[target], name);
+    }
+
+    check(Trees.misses() - misses == 2, name + ": counts");
+  }
+}
+//
+// testComponents:
+//
+// Builds the map's graph again, this time with its component index,
+// and checks that two nodes are in one component exactly when the
+// reference finds a path between them, before and after the index is
+// flattened.
+//
+void testComponents(map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways,
+                    vector<BuildingInfo>& Buildings, string name)
+{
+  graph<long long,double> G;
+  ComponentIndex Components;
+
+  populateGraph(Nodes, Footways, Buildings, G, &Components);
+  G.freeze();
+
+  uint32_t N = G.NumVertices();
+  check(Components.size() == N, name + " components: size");
+
+  size_t numComponents = 0;
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+    string state = (pass == 0) ? " components" : " flattened components";
+
+    for (uint32_t v1 = 0; v1 < N; v1++)
+    {
+      vector<double> expected = referenceDistances(G, v1);
+      size_t reachable = 0;
+      bool first = true;   // v1 is the lowest numbered node of its component
+
+      for (uint32_t v2 = 0; v2 < N; v2++)
+      {
+        bool connected = expected[v2] != INF;
+
+        check(Components.connected(v1, v2) == connected,
+              name + state + ": " + to_string(v1) + " and " + to_string(v2));
+
+        if (connected)
+        {
+          reachable++;
+          first = first && v2 >= v1;
+        }
+      }
+
+      check(Components.componentSize(v1) == reachable, name + state + ": size of " + to_string(v1));
+
+      if (pass == 0 && first)
+        numComponents++;
+    }
+
+    check(Components.count() == numComponents, name + state + ": count");
+
+    Components.flatten();
+  }
+}
+//
+// nearestByScan:
+//
+// The items of the positions sorted from nearest to farthest from
+// (lat, lon), by the same distance the spatial index uses, with ties
+// going to the position listed first.  This is the linear scan the
+// index has to reproduce.  If distances is given, it receives the
+// distance of each item in the same order.
+//
+vector<uint32_t> nearestByScan(const vector<Coordinates>& positions, const vector<uint32_t>& items,
+                               double lat, double lon, vector<double>* distances = nullptr)
+{
+  TrigCoordinates query = toTrigCoordinates(lat, lon);
+  vector<pair<double,size_t>> order;
+
+  for (size_t i = 0; i < positions.size(); i++)
+  {
+    double dist = distBetween2Points(query, toTrigCoordinates(positions[i].Lat, positions[i].Lon));
+
+    order.push_back(make_pair(isnan(dist) ? 0 : dist, i));
+  }
+
+  sort(order.begin(), order.end());
+
+  vector<uint32_t> sorted;
+
+  for (auto& entry : order)
+  {
+    sorted.push_back(items[entry.second]);
+
+    if (distances != nullptr)
+      distances->push_back(entry.first);
+  }
+
+  return sorted;
+}
+
+//
+// testPositions:
+//
+// Positions to index for the spatial index tests: the map's nodes, and
+// again the first few of them under other items, so that some queries
+// are ties.  Items are numbered apart from their positions.
+//
+void testPositions(const vector<Coordinates>& NodeCoords, vector<Coordinates>& positions, vector<uint32_t>& items)
+{
+  positions = NodeCoords;
+
+  for (size_t i = 0; i < 10 && i < NodeCoords.size(); i++)
+    positions.push_back(NodeCoords[i]);
+
+  for (size_t i = 0; i < positions.size(); i++)
+    items.push_back(1000 + 7 * (uint32_t)i);
+}
+
+//
+// testQueries:
+//
+// Query positions for the spatial index tests: every indexed position,
+// points scattered over and around the map, and a few far away.
+//
+vector<Coordinates> testQueries(const vector<Coordinates>& positions)
+{
+  vector<Coordinates> queries = positions;
+  minstd_rand generator(11);
+
+  for (int i = 0; i < 200; i++)
+  {
+    double lat = 41.860 + (generator() % 10000) * 0.000002;
+    double lon = -87.662 + (generator() % 10000) * 0.000002;
+
+    queries.push_back(Coordinates(0, lat, lon));
+  }
+
+  queries.push_back(Coordinates(0, 0.0, 0.0));
+  queries.push_back(Coordinates(0, -41.870, 92.350));
+  queries.push_back(Coordinates(0, 89.999, -87.650));
+
+  return queries;
+}
+
+//
+// testNearest:
+//
+// The spatial index must return the same nearest item as a scan, and
+// nothing at all when it is empty.
+//
+void testNearest(const vector<Coordinates>& NodeCoords, string name)
+{
+  vector<Coordinates> positions;
+  vector<uint32_t> items;
+  testPositions(NodeCoords, positions, items);
+
+  GeoIndex index;
+  index.build(positions, items);
+  check(index.size() == positions.size(), name + " nearest: size");
+
+  for (const Coordinates& query : testQueries(positions))
+  {
+    check(index.nearest(query.Lat, query.Lon) == nearestByScan(positions, items, query.Lat, query.Lon)[0],
+          name + " nearest: to (" + to_string(query.Lat) + ", " + to_string(query.Lon) + ")");
+  }
+
+  GeoIndex empty;
+  empty.build(vector<Coordinates>(), vector<uint32_t>());
+  check(empty.size() == 0 && empty.nearest(41.87, -87.65) == GeoIndex::NO_ITEM, name + " nearest: empty index");
+}
+//
+// testNearestOrder:
+//
+// The k nearest items, and the items a cursor enumerates one at a
+// time, must come in the order of a full sort by distance.
+//
+void testNearestOrder(const vector<Coordinates>& NodeCoords, string name)
+{
+  vector<Coordinates> positions;
+  vector<uint32_t> items;
+  testPositions(NodeCoords, positions, items);
+
+  GeoIndex index;
+  index.build(positions, items);
+
+  for (const Coordinates& query : testQueries(positions))
+  {
+    string where = " to (" + to_string(query.Lat) + ", " + to_string(query.Lon) + ")";
+    vector<double> distances;
+    vector<uint32_t> sorted = nearestByScan(positions, items, query.Lat, query.Lon, &distances);
+
+    for (size_t k : {(size_t)1, (size_t)5, sorted.size() + 5})
+    {
+      vector<uint32_t> expected(sorted.begin(), sorted.begin() + min(k, sorted.size()));
+
+      check(index.kNearest(query.Lat, query.Lon, k) == expected, name + " kNearest: " + to_string(k) + where);
+    }
+
+    GeoIndex::NearestCursor cursor = index.nearestFirst(query.Lat, query.Lon);
+
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+      uint32_t item = cursor.next();
+
+      check(item == sorted[i] && cursor.distance() == distances[i],
+            name + " nearestFirst: item " + to_string(i) + where);
+    }
+
+    check(cursor.next() == GeoIndex::NO_ITEM && cursor.next() == GeoIndex::NO_ITEM,
+          name + " nearestFirst: end" + where);
+  }
+
+  GeoIndex empty;
+  empty.build(vector<Coordinates>(), vector<uint32_t>());
+
+  GeoIndex::NearestCursor cursor = empty.nearestFirst(41.87, -87.65);
+  check(cursor.next() == GeoIndex::NO_ITEM, name + " nearestFirst: empty index");
+  check(empty.kNearest(41.87, -87.65, 3).empty(), name + " kNearest: empty index");
+}
+
+//
+// exactNearest:
+//
+// The index of the point nearest to (lat, lon) by a plain scan with
+// distBetween2Points, the first one on ties.  A NaN distance counts as
+// it does in nearestOf: 0 for (nearly) the same point, half the earth
+// around for (nearly) its antipode.
+//
+size_t exactNearest(double lat, double lon, const vector<double>& lats, const vector<double>& lons)
+{
+  size_t found = lats.size();
+  double minDist = 0;
+
+  for (size_t i = 0; i < lats.size(); i++)
+  {
+    double dist = distBetween2Points(lat, lon, lats[i], lons[i]);
+
+    if (isnan(dist))
+    {
+      TrigCoordinates p1 = toTrigCoordinates(lat, lon);
+      TrigCoordinates p2 = toTrigCoordinates(lats[i], lons[i]);
+
+      dist = (p1.X * p2.X + p1.Y * p2.Y + p1.SinLat * p2.SinLat > 0) ? 0 : 3963.1 * acos(-1.0);
+    }
+
+    if (found == lats.size() || dist < minDist)
+    {
+      minDist = dist;
+      found = i;
+    }
+  }
+
+  return found;
+}
+
+//
+// testDistanceKernels:
+//
+// Every approximate distance kernel the CPU can run must agree with
+// the scalar loop, for point counts around the vector widths and at
+// unaligned addresses, without writing past the output: SSE2 exactly,
+// AVX2 up to the rounding FMA saves.  nearestOf must return the point
+// an exact scan does, also for queries far from the points and for
+// points near the pole or across the date line, where the
+// approximation is poor.
+//
+void testDistanceKernels(const vector<Coordinates>& NodeCoords)
+{
+  minstd_rand generator(14);
+  auto uniform = [&](double low, double high) { return low + (high - low) * (generator() / (double)generator.max()); };
+
+  check(hasDistKernel(DistKernel::SCALAR), "distance kernels: no scalar kernel");
+
+  vector<pair<DistKernel,string>> kernels = {
+    {DistKernel::SCALAR, "scalar"}, {DistKernel::SSE2, "SSE2"}, {DistKernel::AVX2, "AVX2"}
+  };
+
+  const double SENTINEL = -1;
+
+  for (size_t n : {0, 1, 3, 4, 5, 7, 8, 9, 255, 256, 1003})
+  {
+    for (size_t offset : {0, 1})
+    {
+      vector<double> lats(offset + n), lons(offset + n);
+
+      for (size_t i = offset; i < offset + n; i++)
+      {
+        bool far = (i % 5 == 0);
+
+        lats[i] = far ? uniform(-90, 90) : uniform(41.82, 41.92);
+        lons[i] = far ? uniform(-180, 180) : uniform(-87.70, -87.60);
+      }
+
+      double lat = uniform(41.82, 41.92);
+      double lon = uniform(-87.70, -87.60);
+
+      vector<double> expected(offset + n + 4, SENTINEL);
+      approxDistancesWith(DistKernel::SCALAR, lat, lon, lats.data() + offset, lons.data() + offset, n, expected.data() + offset);
+
+      string what = "distance kernels: " + to_string(n) + " points at offset " + to_string(offset);
+
+      for (auto& kernel : kernels)
+      {
+        if (!hasDistKernel(kernel.first))
+          continue;
+
+        vector<double> dists(offset + n + 4, SENTINEL);
+        approxDistancesWith(kernel.first, lat, lon, lats.data() + offset, lons.data() + offset, n, dists.data() + offset);
+
+        bool same = true;
+
+        for (size_t i = 0; i < dists.size(); i++)
+        {
+          if (kernel.first == DistKernel::AVX2 && i >= offset && i < offset + n)
+            same = same && fabs(dists[i] - expected[i]) <= 1e-15 * expected[i];
+          else
+            same = same && sameBits(dists[i], expected[i]);
+        }
+
+        check(same, what + ", " + kernel.second + " against scalar");
+      }
+
+      vector<double> dists(offset + n + 4, SENTINEL);
+      approxDistancesFrom(lat, lon, lats.data() + offset, lons.data() + offset, n, dists.data() + offset);
+
+      DistKernel best = hasDistKernel(DistKernel::AVX2) ? DistKernel::AVX2
+                      : hasDistKernel(DistKernel::SSE2) ? DistKernel::SSE2 : DistKernel::SCALAR;
+
+      vector<double> bestDists(offset + n + 4, SENTINEL);
+      approxDistancesWith(best, lat, lon, lats.data() + offset, lons.data() + offset, n, bestDists.data() + offset);
+
+      bool same = true;
+
+      for (size_t i = 0; i < dists.size(); i++)
+        same = same && sameBits(dists[i], bestDists[i]);
+
+      check(same, what + ", approxDistancesFrom uses the best kernel");
+    }
+  }
+
+  //
+  // nearestOf: the map's nodes (with some twice) and the spatial index
+  // queries, then point sets where the flat approximation is poor:
+  //
+  vector<Coordinates> positions;
+  vector<uint32_t> items;
+  testPositions(NodeCoords, positions, items);
+
+  vector<pair<string,vector<Coordinates>>> pointSets;
+  pointSets.push_back({"map", positions});
+
+  vector<Coordinates> polar, northern, dateLine, world;
+
+  for (int i = 0; i < 500; i++)
+  {
+    polar.push_back(Coordinates(0, uniform(89.5, 90), uniform(-180, 180)));
+    northern.push_back(Coordinates(0, uniform(69.9, 70.1), uniform(19.8, 20.2)));
+    dateLine.push_back(Coordinates(0, uniform(59.9, 60.1), (i % 2 == 0) ? uniform(179.9, 180) : uniform(-180, -179.9)));
+    world.push_back(Coordinates(0, uniform(-90, 90), uniform(-180, 180)));
+  }
+
+  //
+  // points whose antipodes distBetween2Points measures as NaN, with the
+  // antipodes and points a third of the way around as the point set:
+  //
+  vector<Coordinates> antipodal = {
+    Coordinates(0, 41.835913, -87.605661), Coordinates(0, 41.885428, -87.622659), Coordinates(0, 41.862609, -87.664004)
+  };
+  vector<Coordinates> antipodes;
+
+  for (Coordinates& position : antipodal)
+  {
+    check(isnan(distBetween2Points(position.Lat, position.Lon, -position.Lat, position.Lon + 180)),
+          "nearestOf: antipode measures as a number");
+
+    antipodes.push_back(Coordinates(0, -position.Lat, position.Lon + 180));
+    antipodes.push_back(Coordinates(0, -position.Lat, position.Lon + 120));
+  }
+
+  pointSets.push_back({"polar", polar});
+  pointSets.push_back({"northern", northern});
+  pointSets.push_back({"date line", dateLine});
+  pointSets.push_back({"world", world});
+  pointSets.push_back({"antipodes", antipodes});
+
+  for (auto& pointSet : pointSets)
+  {
+    vector<double> lats, lons;
+
+    for (Coordinates& position : pointSet.second)
+    {
+      lats.push_back(position.Lat);
+      lons.push_back(position.Lon);
+    }
+
+    vector<Coordinates> queries = testQueries(pointSet.second);
+
+    for (int i = 0; i < 100; i++)
+    {
+      queries.push_back(Coordinates(0, uniform(-90, 90), uniform(-180, 180)));
+      queries.push_back(Coordinates(0, uniform(89, 90), uniform(-180, 180)));
+    }
+
+    queries.push_back(Coordinates(0, 90, 0));
+    queries.push_back(Coordinates(0, -90, 0));
+    queries.push_back(Coordinates(0, 60, 180));
+    queries.push_back(Coordinates(0, 60, -180));
+    queries.push_back(Coordinates(0, -70, -160));
+    queries.insert(queries.end(), antipodal.begin(), antipodal.end());
+
+    // the antipodes of a few points:
+    for (size_t i = 0; i < pointSet.second.size(); i += 37)
+    {
+      Coordinates& position = pointSet.second[i];
+      queries.push_back(Coordinates(0, -position.Lat, position.Lon > 0 ? position.Lon - 180 : position.Lon + 180));
+    }
+
+    for (Coordinates& query : queries)
+    {
+      size_t found = nearestOf(query.Lat, query.Lon, lats.data(), lons.data(), lats.size());
+
+      check(found == exactNearest(query.Lat, query.Lon, lats, lons),
+            "nearestOf: " + pointSet.first + " points, query (" + to_string(query.Lat) + ", " + to_string(query.Lon) + ")");
+    }
+  }
+
+  check(nearestOf(41.87, -87.65, nullptr, nullptr, 0) == 0, "nearestOf: no points");
+}
+
+//
+// testTrigDistances:
+//
+// distBetween2Points on precomputed points must give exactly what it
+// gives on latitudes and longitudes, bit for bit (NaN included), for
+// every pair of the map's nodes (each node with itself too), for
+// antipodes and the poles, and for points all over the world.
+//
+void testTrigDistances(const vector<Coordinates>& NodeCoords)
+{
+  vector<Coordinates> points = NodeCoords;
+
+  points.push_back(Coordinates(0, 41.835913, -87.605661));
+  points.push_back(Coordinates(0, -41.835913, 92.394339));
+  points.push_back(Coordinates(0, 0.0, 0.0));
+  points.push_back(Coordinates(0, 0.0, 180.0));
+  points.push_back(Coordinates(0, 0.0, -180.0));
+  points.push_back(Coordinates(0, 90.0, 0.0));
+  points.push_back(Coordinates(0, -90.0, 0.0));
+  points.push_back(Coordinates(0, 60.0, 179.9999));
+  points.push_back(Coordinates(0, 60.0, -179.9999));
+
+  minstd_rand generator(15);
+
+  for (int i = 0; i < 200; i++)
+  {
+    double lat = -90 + 180 * (generator() / (double)generator.max());
+    double lon = -180 + 360 * (generator() / (double)generator.max());
+
+    points.push_back(Coordinates(0, lat, lon));
+  }
+
+  vector<TrigCoordinates> trig;
+
+  for (Coordinates& point : points)
+    trig.push_back(toTrigCoordinates(point.Lat, point.Lon));
+
+  size_t numNaN = 0;
+
+  for (size_t i = 0; i < points.size(); i++)
+  {
+    bool same = true;
+
+    for (size_t j = 0; j < points.size(); j++)
+    {
+      double dist = distBetween2Points(points[i].Lat, points[i].Lon, points[j].Lat, points[j].Lon);
+
+      same = same && sameBits(distBetween2Points(trig[i], trig[j]), dist);
+      numNaN += isnan(dist);
+    }
+
+    check(same, "trig distances: from (" + to_string(points[i].Lat) + ", " + to_string(points[i].Lon) + ")");
+  }
+
+  // the NaN cases are covered too:
+  check(numNaN > 0, "trig distances: no NaN distances compared");
+}
+
+//
+// readWithDom:
+//
+// Reads the nodes, footways and buildings of a map with the DOM loader.
+//
+bool readWithDom(string filename, map<long long, Coordinates>& Nodes, vector<FootwayInfo>& Footways,
+                 vector<BuildingInfo>& Buildings, MapCounts& Counts)
+{
+  XMLDocument xmldoc;
+
+  if (!LoadOpenStreetMap(filename, xmldoc))
+    return false;
+
+  Counts.Nodes = ReadMapNodes(xmldoc, Nodes);
+  Counts.Footways = ReadFootways(xmldoc, Footways);
+  Counts.Buildings = ReadUniversityBuildings(xmldoc, Nodes, Buildings);
+
+  return true;
+}
+
+//
+// checkSameMap:
+//
+// Checks that a loader read the same nodes, footways and buildings, in
+// the same order, and counted them the same as the DOM loader.
+//
+void checkSameMap(string what,
+                  const map<long long, Coordinates>& Nodes, const vector<FootwayInfo>& Footways,
+                  const vector<BuildingInfo>& Buildings, const MapCounts& Counts,
+                  const map<long long, Coordinates>& DomNodes, const vector<FootwayInfo>& DomFootways,
+                  const vector<BuildingInfo>& DomBuildings, const MapCounts& DomCounts)
+{
+  bool sameNodes = Nodes.size() == DomNodes.size();
+
+  for (auto node = Nodes.begin(), domNode = DomNodes.begin(); sameNodes && node != Nodes.end(); ++node, ++domNode)
+  {
+    sameNodes = node->first == domNode->first && node->second.ID == domNode->second.ID
+      && node->second.Lat == domNode->second.Lat && node->second.Lon == domNode->second.Lon;
+  }
+
+  check(sameNodes, what + ": nodes");
+
+  bool sameFootways = Footways.size() == DomFootways.size();
+
+  for (size_t i = 0; sameFootways && i < Footways.size(); i++)
+  {
+    sameFootways = Footways[i].ID == DomFootways[i].ID && Footways[i].Nodes == DomFootways[i].Nodes;
+  }
+
+  check(sameFootways, what + ": footways");
+
+  bool sameBuildings = Buildings.size() == DomBuildings.size();
+
+  for (size_t i = 0; sameBuildings && i < Buildings.size(); i++)
+  {
+    sameBuildings = Buildings[i].Fullname == DomBuildings[i].Fullname && Buildings[i].Abbrev == DomBuildings[i].Abbrev
+      && Buildings[i].Coords.ID == DomBuildings[i].Coords.ID
+      && Buildings[i].Coords.Lat == DomBuildings[i].Coords.Lat && Buildings[i].Coords.Lon == DomBuildings[i].Coords.Lon;
+  }
+
+  check(sameBuildings, what + ": buildings");
+
+  check(Counts.Nodes == DomCounts.Nodes && Counts.Footways == DomCounts.Footways
+        && Counts.Buildings == DomCounts.Buildings, what + ": counts");
+}
+
+//
+// writeFile:
+//
+// Writes the given text to a file, for small handwritten maps.
+//
+void writeFile(string filename, string contents)
+{
+  ofstream file(filename, ios::binary);
+  file << contents;
+}
+
+//
+// testStreamLoader:
+//
+// The streaming loader must read a map exactly as the DOM loader does,
+// and must fail on maps that are malformed or whose nodes and ways
+// lack the attributes routing needs.
+//
+void testStreamLoader(string filename)
+{
+  map<long long, Coordinates> DomNodes;
+  vector<FootwayInfo> DomFootways;
+  vector<BuildingInfo> DomBuildings;
+  MapCounts DomCounts;
+
+  check(readWithDom(filename, DomNodes, DomFootways, DomBuildings, DomCounts), "DOM loader: " + filename);
+
+  map<long long, Coordinates> Nodes;
+  vector<FootwayInfo> Footways;
+  vector<BuildingInfo> Buildings;
+  MapCounts Counts;
+
+  check(StreamOpenStreetMap(filename, Nodes, Footways, Buildings, Counts, false, 1), "stream loader: " + filename);
+  checkSameMap("stream loader", Nodes, Footways, Buildings, Counts, DomNodes, DomFootways, DomBuildings, DomCounts);
+
+  string badFilename = "testing-bad.osm";
+  string header = "<?xml version=\"1.0\"?>\n<osm>\n <node id=\"1\" lat=\"41.87\" lon=\"-87.65\"/>\n";
+
+  vector<pair<string,string>> badMaps = {
+    {"node without lat", header + " <node id=\"2\" lon=\"-87.65\"/>\n</osm>\n"},
+    {"node without id", header + " <node lat=\"41.87\" lon=\"-87.65\"/>\n</osm>\n"},
+    {"way without id", header + " <way>\n  <nd ref=\"1\"/>\n </way>\n</osm>\n"},
+    {"nd without ref", header + " <way id=\"7\">\n  <nd ref=\"1\"/>\n  <nd/>\n </way>\n</osm>\n"},
+    {"unclosed element", header + " <way id=\"7\">\n  <nd ref=\"1\"/>\n"},
+    {"cut off tag", header + " <node id=\"2\" lat=\"41"},
+    {"repeated attribute", header + " <node id=\"2\" lat=\"41.87\" lat=\"41.88\" lon=\"-87.65\"/>\n</osm>\n"},
+    {"second root element", header + "</osm>\n<osm/>\n"},
+    {"second osm element", header + "</osm>\n<osm>\n <node id=\"2\" lat=\"41.87\" lon=\"-87.65\"/>\n</osm>\n"},
+    {"no osm element", "<?xml version=\"1.0\"?>\n<map/>\n"},
+    {"empty file", ""}
+  };
+
+  for (auto& bad : badMaps)
+  {
+    writeFile(badFilename, bad.second);
+
+    for (bool mapFile : {false, true})
+    {
+      map<long long, Coordinates> BadNodes;
+      vector<FootwayInfo> BadFootways;
+      vector<BuildingInfo> BadBuildings;
+      MapCounts BadCounts;
+
+      check(!StreamOpenStreetMap(badFilename, BadNodes, BadFootways, BadBuildings, BadCounts, mapFile, 1),
+            string(mapFile ? "mapped" : "stream") + " loader: read a map with a " + bad.first);
+    }
+  }
+
+  //
+  // the pieces of a map the parallel loader reads hold many top-level
+  // elements, which a fragment may and a document may not:
+  //
+  string piece = " <node id=\"1\"/>\n <node id=\"2\"/>\n";
+
+  for (bool fragment : {false, true})
+  {
+    MemorySource source(piece.data(), piece.size());
+    XmlPullParser parser(source);
+
+    if (fragment)
+      parser.parseFragment();
+
+    XmlPullParser::Event event;
+    int starts = 0;
+
+    while ((event = parser.next()) == XmlPullParser::START_ELEMENT || event == XmlPullParser::END_ELEMENT)
+    {
+      if (event == XmlPullParser::START_ELEMENT)
+        starts++;
+    }
+
+    check(fragment ? (event == XmlPullParser::END_DOCUMENT && starts == 2)
+                   : (event == XmlPullParser::PARSE_ERROR && starts == 1),
+          string("stream parser: two top-level elements in a ") + (fragment ? "fragment" : "document"));
+  }
+
+  MemorySource blank(" \n", 2);
+  XmlPullParser emptyFragment(blank);
+  emptyFragment.parseFragment();
+
+  check(emptyFragment.next() == XmlPullParser::END_DOCUMENT, "stream parser: no elements in a fragment");
+
+  map<long long, Coordinates> MissingNodes;
+  vector<FootwayInfo> MissingFootways;
+  vector<BuildingInfo> MissingBuildings;
+  MapCounts MissingCounts;
+
+  check(!StreamOpenStreetMap("testing-missing.osm", MissingNodes, MissingFootways, MissingBuildings, MissingCounts),
+        "stream loader: read a missing file");
+
+  remove(badFilename.c_str());
+}
+//
+// readFile:
+//
+// Returns the contents of a file.
+//
+string readFile(string filename)
+{
+  ifstream file(filename, ios::binary);
+
+  return string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+}
+
+//
+// testMappedLoader:
+//
+// A mapped file must hand out exactly the bytes of the file, whether
+// parsed in place or read in pieces, and the loader parsing the
+// mapping in place must read a map as the DOM loader does, also when
+// the last tag ends at the very end of the mapping.
+//
+void testMappedLoader(string filename)
+{
+  string contents = readFile(filename);
+
+  {
+    MappedFileSource source(filename);
+    const char* data = nullptr;
+    size_t size = 0;
+
+    check(source.isOpen() && source.contents(data, size) && string(data, size) == contents,
+          "mapped file: contents");
+
+    string pieces;
+    char buffer[1000];
+    size_t count;
+
+    while ((count = source.read(buffer, sizeof(buffer))) > 0)
+      pieces.append(buffer, count);
+
+    check(pieces == contents, "mapped file: read");
+  }
+
+  MappedFileSource missing("testing-missing.osm");
+  check(!missing.isOpen(), "mapped file: opened a missing file");
+
+  string endFilename = "testing-end.osm";
+  writeFile(endFilename, contents.substr(0, contents.find_last_not_of("\n") + 1));
+
+  for (string mapFilename : {filename, endFilename})
+  {
+    map<long long, Coordinates> DomNodes;
+    vector<FootwayInfo> DomFootways;
+    vector<BuildingInfo> DomBuildings;
+    MapCounts DomCounts;
+
+    check(readWithDom(mapFilename, DomNodes, DomFootways, DomBuildings, DomCounts), "DOM loader: " + mapFilename);
+
+    map<long long, Coordinates> Nodes;
+    vector<FootwayInfo> Footways;
+    vector<BuildingInfo> Buildings;
+    MapCounts Counts;
+
+    check(StreamOpenStreetMap(mapFilename, Nodes, Footways, Buildings, Counts, true, 1), "mapped loader: " + mapFilename);
+    checkSameMap("mapped loader " + mapFilename, Nodes, Footways, Buildings, Counts,
+                 DomNodes, DomFootways, DomBuildings, DomCounts);
+  }
+
+  remove(endFilename.c_str());
+}
+//
+// compileMap:
+//
+// Reads a map with the streaming loader and builds from it what the
+// application builds before it saves a compiled map: the frozen graph
+// and its components, the node positions, and the buildings snapped to
+// footway nodes.
+//
+bool compileMap(string filename, graph<long long,double>& G, vector<Coordinates>& NodeCoords,
+                vector<BuildingInfo>& Buildings, MapCounts& Counts, ComponentIndex& Components)
+{
+  map<long long, Coordinates> Nodes;
+  vector<FootwayInfo> Footways;
+
+  if (!StreamOpenStreetMap(filename, Nodes, Footways, Buildings, Counts))
+    return false;
+
+  populateGraph(Nodes, Footways, Buildings, G, &Components);
+  G.freeze();
+
+  vector<uint32_t> FootwayNodes;
+  buildNodeTables(Nodes, Footways, G, NodeCoords, FootwayNodes);
+
+  GeoIndex FootwayIndex;
+  buildFootwayIndex(NodeCoords, FootwayNodes, FootwayIndex);
+  snapBuildings(Buildings, FootwayIndex);
+
+  return true;
+}
+
+//
+// testCompiledMap:
+//
+// A compiled map must load back into the same graph, positions,
+// buildings, counts and components it was saved from.  It must be
+// rejected, leaving everything empty, once the map file has changed
+// size or modification time, or if the compiled file is damaged or
+// cut short.
+//
+void testCompiledMap(string filename)
+{
+  string compiledFilename = "testing-map.bin";
+  string damagedFilename = "testing-damaged.bin";
+
+  graph<long long,double> G;
+  vector<Coordinates> NodeCoords;
+  vector<BuildingInfo> Buildings;
+  MapCounts Counts;
+  ComponentIndex Components;
+
+  check(compileMap(filename, G, NodeCoords, Buildings, Counts, Components), "compiled map: compile " + filename);
+  check(saveCompiledMap(compiledFilename, filename, G, NodeCoords, Buildings, Counts), "compiled map: save");
+
+  graph<long long,double> LoadedG;
+  vector<Coordinates> LoadedCoords;
+  vector<BuildingInfo> LoadedBuildings;
+  MapCounts LoadedCounts;
+  ComponentIndex LoadedComponents;
+
+  check(loadCompiledMap(compiledFilename, filename, LoadedG, LoadedCoords, LoadedBuildings, LoadedCounts, LoadedComponents),
+        "compiled map: load");
+
+  bool sameGraph = LoadedG.isFrozen() && LoadedG.getVertices() == G.getVertices() && LoadedG.NumEdges() == G.NumEdges();
+
+  for (uint32_t v = 0; sameGraph && v < (uint32_t)G.NumVertices(); v++)
+  {
+    vector<pair<uint32_t,double>> edges, loadedEdges;
+
+    for (auto edge : G.edges(v))
+      edges.push_back(make_pair(edge.neighbor, edge.weight));
+
+    for (auto edge : LoadedG.edges(v))
+      loadedEdges.push_back(make_pair(edge.neighbor, edge.weight));
+
+    sameGraph = loadedEdges == edges;
+  }
+
+  check(sameGraph, "compiled map: graph");
+
+  bool sameCoords = LoadedCoords.size() == NodeCoords.size();
+
+  for (size_t i = 0; sameCoords && i < NodeCoords.size(); i++)
+  {
+    sameCoords = LoadedCoords[i].ID == NodeCoords[i].ID && LoadedCoords[i].Lat == NodeCoords[i].Lat
+      && LoadedCoords[i].Lon == NodeCoords[i].Lon;
+  }
+
+  check(sameCoords, "compiled map: node positions");
+
+  bool sameBuildings = LoadedBuildings.size() == Buildings.size();
+
+  for (size_t i = 0; sameBuildings && i < Buildings.size(); i++)
+  {
+    sameBuildings = LoadedBuildings[i].Fullname == Buildings[i].Fullname && LoadedBuildings[i].Abbrev == Buildings[i].Abbrev
+      && LoadedBuildings[i].Coords.ID == Buildings[i].Coords.ID && LoadedBuildings[i].Coords.Lat == Buildings[i].Coords.Lat
+      && LoadedBuildings[i].Coords.Lon == Buildings[i].Coords.Lon && LoadedBuildings[i].NearestNode == Buildings[i].NearestNode;
+  }
+
+  check(sameBuildings, "compiled map: buildings");
+  check(LoadedCounts.Nodes == Counts.Nodes && LoadedCounts.Footways == Counts.Footways
+        && LoadedCounts.Buildings == Counts.Buildings, "compiled map: counts");
+
+  bool sameComponents = LoadedComponents.size() == Components.size() && LoadedComponents.count() == Components.count();
+
+  for (uint32_t v1 = 0; sameComponents && v1 < (uint32_t)G.NumVertices(); v1++)
+  {
+    for (uint32_t v2 = 0; sameComponents && v2 < (uint32_t)G.NumVertices(); v2++)
+      sameComponents = LoadedComponents.connected(v1, v2) == Components.connected(v1, v2);
+  }
+
+  check(sameComponents, "compiled map: components");
+
+  //
+  // damaged copies of the compiled map, each of which must be rejected:
+  //
+  string contents = readFile(compiledFilename);
+  vector<pair<string,string>> damaged = {
+    {"cut short", contents.substr(0, contents.size() / 2)},
+    {"missing its last byte", contents.substr(0, contents.size() - 1)},
+    {"with a byte appended", contents + "x"},
+    {"with a header byte changed", contents},
+    {"with a payload byte changed", contents},
+    {"that is empty", ""}
+  };
+
+  damaged[3].second[0] ^= 0x20;
+  damaged[4].second[contents.size() * 2 / 3] ^= 0x01;
+
+  auto rejected = [&](string what, string compiled, string source)
+  {
+    check(!loadCompiledMap(compiled, source, LoadedG, LoadedCoords, LoadedBuildings, LoadedCounts, LoadedComponents)
+          && LoadedG.NumVertices() == 0 && LoadedCoords.empty() && LoadedBuildings.empty() && LoadedComponents.size() == 0,
+          "compiled map: loaded " + what);
+  };
+
+  for (auto& copy : damaged)
+  {
+    writeFile(damagedFilename, copy.second);
+    rejected("a file " + copy.first, damagedFilename, filename);
+  }
+
+  rejected("a missing file", "testing-missing.bin", filename);
+  rejected("for a missing map", compiledFilename, "testing-missing.osm");
+
+  // the map file touched, then edited:
+  string changedFilename = "testing-changed.osm";
+  writeFile(changedFilename, readFile(filename));
+  check(saveCompiledMap(compiledFilename, changedFilename, G, NodeCoords, Buildings, Counts), "compiled map: save again");
+
+  filesystem::last_write_time(changedFilename, filesystem::last_write_time(changedFilename) - chrono::seconds(10));
+  rejected("for a map with a new modification time", compiledFilename, changedFilename);
+
+  check(saveCompiledMap(compiledFilename, changedFilename, G, NodeCoords, Buildings, Counts), "compiled map: save again");
+  writeFile(changedFilename, readFile(filename) + " ");
+  rejected("for a map of a new size", compiledFilename, changedFilename);
+
+  remove(compiledFilename.c_str());
+  remove(damagedFilename.c_str());
+  remove(changedFilename.c_str());
+}
+
+//
+// testSnapBuildings:
+//
+// Every building must be snapped to the footway node a scan finds
+// nearest, ties going to the node listed first, whether the buildings
+// are split over one thread or several, and to NO_VERTEX when there
+// are no footway nodes at all.
+//
+void testSnapBuildings(string filename)
+{
+  map<long long, Coordinates> Nodes;
+  vector<FootwayInfo> Footways;
+  vector<BuildingInfo> MapBuildings;
+  MapCounts Counts;
+  graph<long long,double> G;
+
+  check(readWithDom(filename, Nodes, Footways, MapBuildings, Counts), "snap: read " + filename);
+
+  populateGraph(Nodes, Footways, MapBuildings, G);
+  G.freeze();
+
+  vector<Coordinates> NodeCoords;
+  vector<uint32_t> FootwayNodes;
+  buildNodeTables(Nodes, Footways, G, NodeCoords, FootwayNodes);
+
+  GeoIndex FootwayIndex;
+  buildFootwayIndex(NodeCoords, FootwayNodes, FootwayIndex);
+
+  // the footway nodes, each at its first occurrence, for the scan:
+  vector<bool> added(NodeCoords.size(), false);
+  vector<Coordinates> positions;
+  vector<uint32_t> nodes;
+
+  for (uint32_t node : FootwayNodes)
+  {
+    if (!added[node])
+    {
+      added[node] = true;
+      positions.push_back(NodeCoords[node]);
+      nodes.push_back(node);
+    }
+  }
+
+  //
+  // buildings over and around the map, every tenth on a footway node,
+  // and a few far away:
+  //
+  double minLat = 90, maxLat = -90, minLon = 180, maxLon = -180;
+
+  for (Coordinates& position : positions)
+  {
+    minLat = min(minLat, position.Lat);
+    maxLat = max(maxLat, position.Lat);
+    minLon = min(minLon, position.Lon);
+    maxLon = max(maxLon, position.Lon);
+  }
+
+  minstd_rand generator(13);
+  vector<BuildingInfo> Buildings;
+
+  for (int i = 0; i < 1000; i++)
+  {
+    double lat = minLat - 0.002 + (maxLat - minLat + 0.004) * (generator() % 10000) / 10000.0;
+    double lon = minLon - 0.002 + (maxLon - minLon + 0.004) * (generator() % 10000) / 10000.0;
+
+    if (i % 10 == 0)
+    {
+      Coordinates& position = positions[generator() % positions.size()];
+      lat = position.Lat;
+      lon = position.Lon;
+    }
+
+    Buildings.push_back(BuildingInfo("Building " + to_string(i), "B" + to_string(i), 900000 + i, lat, lon));
+  }
+
+  Buildings.push_back(BuildingInfo("Far", "F1", 901000, 0.0, 0.0));
+  Buildings.push_back(BuildingInfo("Farther", "F2", 901001, -41.870, 92.350));
+  Buildings.push_back(BuildingInfo("Polar", "F3", 901002, 89.999, -87.650));
+
+  vector<uint32_t> expected;
+
+  for (BuildingInfo& building : Buildings)
+    expected.push_back(nearestByScan(positions, nodes, building.Coords.Lat, building.Coords.Lon)[0]);
+
+  for (size_t count : {0, 1, 63, 64, 65, 130, 1003})
+  {
+    for (unsigned threads : {1, 2, 3, 4, 8, 16, 0})
+    {
+      vector<BuildingInfo> Snapped(Buildings.begin(), Buildings.begin() + count);
+
+      for (BuildingInfo& building : Snapped)
+        building.NearestNode = 12345;
+
+      snapBuildings(Snapped, FootwayIndex, threads);
+
+      bool same = true;
+
+      for (size_t i = 0; i < count; i++)
+        same = same && Snapped[i].NearestNode == expected[i];
+
+      check(same, "snap: " + to_string(count) + " buildings, " + to_string(threads) + " threads");
+    }
+  }
+
+  GeoIndex EmptyIndex;
+  EmptyIndex.build(vector<Coordinates>(), vector<uint32_t>());
+
+  for (unsigned threads : {1, 4})
+  {
+    vector<BuildingInfo> Snapped = Buildings;
+    snapBuildings(Snapped, EmptyIndex, threads);
+
+    bool none = true;
+
+    for (BuildingInfo& building : Snapped)
+      none = none && building.NearestNode == NO_VERTEX;
+
+    check(none, "snap: no footway nodes, " + to_string(threads) + " threads");
+  }
+}
+//
+// testParallelLoader:
+//
+// Maps large enough to be split are read on several threads, and must
+// come out exactly as the DOM loader reads them: a plain map, one with
+// a comment (which is read serially instead), and one in which nodes
+// are defined twice, far enough apart to land in different pieces, so
+// the later definition has to win across pieces.  A map with a broken
+// node in the middle must fail with any number of threads.
+//
+void testParallelLoader()
+{
+  string filename = "testing-large.osm";
+  writeTestMap(filename, 150);
+
+  string contents = readFile(filename);
+  string comment = " <!-- trailing comment -->\n";
+  string plain = contents;
+  plain.erase(plain.find(comment), comment.size());
+
+  string firstWay = " <way ";
+  string repeated = plain;
+  size_t firstNode = repeated.find(" <node ");
+  repeated.insert(repeated.find(firstWay),
+    regex_replace(repeated.substr(firstNode, repeated.find(" <node ", firstNode + 1000) - firstNode),
+                  regex("lat=\"41"), "lat=\"42"));
+
+  vector<pair<string,string>> maps = {
+    {"plain map", plain},
+    {"map with a comment", contents},
+    {"map with repeated nodes", repeated}
+  };
+
+  for (auto& large : maps)
+  {
+    writeFile(filename, large.second);
+
+    map<long long, Coordinates> DomNodes;
+    vector<FootwayInfo> DomFootways;
+    vector<BuildingInfo> DomBuildings;
+    MapCounts DomCounts;
+
+    check(large.second.size() >= (2 << 20) && readWithDom(filename, DomNodes, DomFootways, DomBuildings, DomCounts),
+          "DOM loader: " + large.first);
+
+    for (unsigned threads : {2u, 3u, 4u, 8u})
+    {
+      string what = "parallel loader, " + to_string(threads) + " threads, " + large.first;
+
+      map<long long, Coordinates> Nodes;
+      vector<FootwayInfo> Footways;
+      vector<BuildingInfo> Buildings;
+      MapCounts Counts;
+
+      check(StreamOpenStreetMap(filename, Nodes, Footways, Buildings, Counts, true, threads), what);
+      checkSameMap(what, Nodes, Footways, Buildings, Counts, DomNodes, DomFootways, DomBuildings, DomCounts);
+    }
+  }
+
+  string broken = plain;
+  size_t middle = broken.find(" lat=", broken.size() / 3);
+  broken.replace(middle, 5, " lan=");
+
+  string twoRoots = plain + "<osm>\n" + plain.substr(plain.find(" <node "));
+
+  vector<pair<string,string>> brokenMaps = {
+    {"node without lat", broken},
+    {"second osm element", twoRoots}
+  };
+
+  for (auto& bad : brokenMaps)
+  {
+    writeFile(filename, bad.second);
+
+    for (unsigned threads : {1u, 2u, 4u})
+    {
+      map<long long, Coordinates> Nodes;
+      vector<FootwayInfo> Footways;
+      vector<BuildingInfo> Buildings;
+      MapCounts Counts;
+
+      check(!StreamOpenStreetMap(filename, Nodes, Footways, Buildings, Counts, true, threads),
+            "parallel loader, " + to_string(threads) + " threads: read a map with a " + bad.first);
+    }
+  }
+
+  remove(filename.c_str());
+}
+//
+// testNumberParsing:
+//
+// The attribute number conversions must give the same results as the
+// sscanf calls they replace, for ordinary numbers and for the forms
+// they hand back to sscanf (a leading '+', hexadecimal floating point,
+// values out of range).  ToFixedDecimal must give exactly what strtod
+// gives for the plain decimals it accepts, and leave the value alone
+// for everything else.
+//
+void testNumberParsing()
+{
+  const char* numbers[] = {
+    "0", "-0", "+5", "42", "  42", " \t-7.25", "\v5", "12abc", "1,5", "007",
+    ".5", "5.", "-.5", ".", "-", "", "abc", "0x10", "0x1p3", "-0X1.8P1",
+    "1e400", "-1e400", "1e-400", "3.4e39", "99999999999", "-99999999999",
+    "2147483647", "-2147483648", "2147483648", "4294967295", "4294967296", "-1",
+    "9223372036854775807", "9223372036854775808", "18446744073709551615", "18446744073709551616",
+    "nan", "inf", "-inf", "3.14159265358979323846", "1.7976931348623157e308",
+    "2.2250738585072014e-308", "4.9e-324", "41.8781136", "-87.6297982", "1.5e3", "1E-2"
+  };
+
+  for (const char* str : numbers)
+  {
+    string quoted = string(" of \"") + str + "\"";
+
+    int int1 = -7, int2 = -7;
+    check(XMLUtil::ToInt(str, &int1) == (sscanf(str, "%d", &int2) == 1) && int1 == int2, "ToInt" + quoted);
+
+    unsigned unsigned1 = 7, unsigned2 = 7;
+    check(XMLUtil::ToUnsigned(str, &unsigned1) == (sscanf(str, "%u", &unsigned2) == 1) && unsigned1 == unsigned2,
+          "ToUnsigned" + quoted);
+
+    int64_t int64 = -7;
+    long long longLong = -7;
+    check(XMLUtil::ToInt64(str, &int64) == (sscanf(str, "%lld", &longLong) == 1) && int64 == longLong,
+          "ToInt64" + quoted);
+
+    uint64_t uint64 = 7;
+    unsigned long long unsignedLongLong = 7;
+    check(XMLUtil::ToUnsigned64(str, &uint64) == (sscanf(str, "%llu", &unsignedLongLong) == 1) && uint64 == unsignedLongLong,
+          "ToUnsigned64" + quoted);
+
+    float float1 = -7, float2 = -7;
+    check(XMLUtil::ToFloat(str, &float1) == (sscanf(str, "%f", &float2) == 1) && sameBits(float1, float2),
+          "ToFloat" + quoted);
+
+    double double1 = -7, double2 = -7;
+    check(XMLUtil::ToDouble(str, &double1) == (sscanf(str, "%lf", &double2) == 1) && sameBits(double1, double2),
+          "ToDouble" + quoted);
+  }
+
+  //
+  // plain decimals, which ToFixedDecimal must convert exactly:
+  //
+  vector<string> decimals = {"0", "-0", "0.0", "-0.0", ".5", "-.5", "5.", "007", "1", "-1",
+                             "999999999999999", "-99999999999999.9", "0.00000000000001", "41.8781136", "-87.6297982"};
+  minstd_rand generator(20);
+  char buffer[40];
+
+  for (int i = 0; i < 20000; i++)
+  {
+    double lat = (generator() % 1800000001) / 1e7 - 90;
+    snprintf(buffer, sizeof(buffer), (i % 2 == 0) ? "%.7f" : "%.3f", lat);
+    decimals.push_back(buffer);
+
+    snprintf(buffer, sizeof(buffer), "%llu.%llu", (unsigned long long)(generator() % 100000000),
+             (unsigned long long)(generator() % 10000000));
+    decimals.push_back(buffer);
+  }
+
+  for (const string& decimal : decimals)
+  {
+    double value = -7;
+
+    check(XMLUtil::ToFixedDecimal(decimal.data(), decimal.data() + decimal.size(), &value)
+          && sameBits(value, strtod(decimal.c_str(), nullptr)), "ToFixedDecimal of \"" + decimal + "\"");
+  }
+
+  //
+  // everything else is left to ToDouble:
+  //
+  vector<string> others = {"", "-", ".", "-.", "+5", " 5", "5 ", "1e5", "1.2.3", "--1", "0x1p3", "nan", "inf",
+                           "1234567890123456", "0.000000000000001", "-0.1234567890123456", "12a", "4,5"};
+
+  for (const string& other : others)
+  {
+    double value = -7;
+
+    check(!XMLUtil::ToFixedDecimal(other.data(), other.data() + other.size(), &value) && value == -7,
+          "ToFixedDecimal of \"" + other + "\" should fail");
+  }
+
+  // only [str, end) is read:
+  double value = -7;
+  check(XMLUtil::ToFixedDecimal("41.8781136\" lon", "41.8781136\" lon" + 10, &value) && value == strtod("41.8781136", nullptr),
+        "ToFixedDecimal of a number followed by more text");
+}
+//
+// lookupSignature:
+//
+// Describes what the name lookups of a document find: for each element
+// name, the IDs of the children of the root (and of the first way) with
+// that name, forward and backward, and for each of those the value of
+// each attribute name.  Two documents with the same elements and
+// attributes have the same signature, however their names were set.
+//
+string lookupSignature(const XMLDocument& doc)
+{
+  const char* elementNames[] = {"osm", "node", "way", "nd", "tag", "relation", "bridge", "missing"};
+  const char* attributeNames[] = {"id", "lat", "lon", "ref", "k", "v", "ele", "missing"};
+  string signature;
+
+  const XMLElement* root = doc.FirstChildElement("osm");
+
+  if (root == nullptr || doc.FirstChildElement("missing") != nullptr)
+    return "no root";
+
+  const XMLElement* way = root->FirstChildElement("way");
+
+  for (const XMLElement* parent : {root, way})
+  {
+    for (const char* name : elementNames)
+    {
+      signature += string(name) + ":";
+
+      if (parent == nullptr)
+        continue;
+
+      for (const XMLElement* e = parent->FirstChildElement(name); e != nullptr; e = e->NextSiblingElement(name))
+      {
+        signature += " <";
+
+        for (const char* attributeName : attributeNames)
+        {
+          const XMLAttribute* attribute = e->FindAttribute(attributeName);
+
+          if (attribute != nullptr)
+            signature += string(attributeName) + "=" + attribute->Value() + " ";
+
+          if ((e->Attribute(attributeName) != nullptr) != (attribute != nullptr))
+            signature += "(Attribute differs) ";
+        }
+
+        signature += to_string(e->IntAttribute("id", -1)) + ">";
+      }
+
+      signature += " /";
+
+      for (const XMLElement* e = parent->LastChildElement(name); e != nullptr; e = e->PreviousSiblingElement(name))
+        signature += " " + string(e->Attribute("id", nullptr) != nullptr ? e->Attribute("id") : "?");
+
+      signature += "\n";
+    }
+  }
+
+  return signature;
+}
+
+//
+// editDocument:
+//
+// Changes a parsed document in two steps (phase 0 and phase 1), so
+// that names can be set in between with interning turned on or off:
+// adds elements and attributes, renames an element, and replaces and
+// deletes attributes.
+//
+void editDocument(XMLDocument& doc, int phase)
+{
+  XMLElement* root = doc.FirstChildElement("osm");
+
+  if (phase == 0)
+  {
+    XMLElement* node = doc.NewElement("node");
+    node->SetAttribute("id", 5);
+    node->SetAttribute("lat", "41.5");
+    node->SetAttribute("lon", "-87.5");
+    root->InsertEndChild(node);
+
+    XMLElement* bridge = doc.NewElement("bridge");
+    bridge->SetAttribute("id", 6);
+    root->InsertFirstChild(bridge);
+
+    root->FirstChildElement("node")->SetAttribute("lat", "42");
+    root->FirstChildElement("node")->SetAttribute("ele", "180");
+  }
+  else
+  {
+    root->FirstChildElement("relation")->SetName("node");
+    root->FirstChildElement("bridge")->SetAttribute("lat", "0");
+    root->LastChildElement("node")->DeleteAttribute("lon");
+    root->FirstChildElement("way")->FirstChildElement("tag")->SetAttribute("k", "highway");
+
+    XMLElement* tag = doc.NewElement("tag");
+    tag->SetAttribute("k", "name");
+    tag->SetAttribute("v", "Quad");
+    root->FirstChildElement("way")->InsertEndChild(tag);
+  }
+}
+
+//
+// testInternedNames:
+//
+// Name lookups must find the same elements and attributes whether the
+// names were interned or not, in every mix: parsed with interning on
+// or off, then edited with it on or off in each of two phases.  The
+// lookups by atom must agree with those by name, and atoms must stay
+// the same across Clear().
+//
+void testInternedNames()
+{
+  const char* text =
+    "<?xml version=\"1.0\"?>\n"
+    "<osm version=\"0.6\">\n"
+    " <node id=\"1\" lat=\"41.1\" lon=\"-87.1\"/>\n"
+    " <way id=\"2\"><nd ref=\"1\"/><nd ref=\"3\"/><tag k=\"a\" v=\"b\"/></way>\n"
+    " <node id=\"3\" lat=\"41.3\" lon=\"-87.3\">text</node>\n"
+    " <relation id=\"4\"/>\n"
+    "</osm>\n";
+
+  XMLDocument reference;
+  reference.Parse(text);
+
+  string parsed = lookupSignature(reference);
+  editDocument(reference, 0);
+  string edited = lookupSignature(reference);
+  editDocument(reference, 1);
+  string expected = lookupSignature(reference);
+
+  check(parsed != edited && edited != expected, "interned names: edits change the signature");
+
+  for (int mix = 0; mix < 8; mix++)
+  {
+    bool parseInterned = mix & 1, firstInterned = mix & 2, secondInterned = mix & 4;
+    string what = string("interned names: parsed ") + (parseInterned ? "on" : "off") +
+      ", edited " + (firstInterned ? "on" : "off") + " then " + (secondInterned ? "on" : "off");
+
+    XMLDocument doc;
+    doc.SetInternNames(parseInterned);
+    check(doc.Parse(text) == XML_SUCCESS && lookupSignature(doc) == parsed, what + ": parsed");
+
+    doc.SetInternNames(firstInterned);
+    editDocument(doc, 0);
+    check(lookupSignature(doc) == edited, what + ": first edit");
+
+    doc.SetInternNames(secondInterned);
+    editDocument(doc, 1);
+    check(lookupSignature(doc) == expected, what + ": second edit");
+
+    doc.SetInternNames(!secondInterned);
+    check(lookupSignature(doc) == expected, what + ": interning switched afterwards");
+  }
+
+  //
+  // lookups by atom, with every name interned:
+  //
+  XMLDocument doc;
+  doc.SetInternNames(true);
+  doc.Parse(text);
+  editDocument(doc, 0);
+  editDocument(doc, 1);
+
+  XMLElement* root = doc.FirstChildElement("osm");
+  int nodeAtom = doc.NameAtom("node");
+
+  check(nodeAtom != 0 && root->NameAtom() == doc.NameAtom("osm") && nodeAtom != root->NameAtom(), "interned names: atoms");
+  check(doc.NameAtom("missing") == 0 && root->FirstChildElementByAtom(0) == nullptr, "interned names: unknown name");
+
+  vector<const XMLElement*> byName, byAtom;
+
+  for (const XMLElement* e = root->FirstChildElement("node"); e != nullptr; e = e->NextSiblingElement("node"))
+    byName.push_back(e);
+
+  for (const XMLElement* e = root->FirstChildElementByAtom(nodeAtom); e != nullptr; e = e->NextSiblingElementByAtom(nodeAtom))
+    byAtom.push_back(e);
+
+  check(byName.size() == 4 && byAtom == byName, "interned names: elements by atom");
+
+  const XMLAttribute* lat = byName[0]->FindAttributeByAtom(doc.NameAtom("lat"));
+  check(lat != nullptr && lat == byName[0]->FindAttribute("lat") && lat->NameAtom() == doc.NameAtom("lat"),
+        "interned names: attribute by atom");
+
+  doc.Clear();
+  check(doc.NameAtom("node") == nodeAtom && doc.Parse(text) == XML_SUCCESS && lookupSignature(doc) == parsed,
+        "interned names: atoms kept across Clear()");
+}
+//
+// testScanners:
+//
+// The text, name and whitespace scanners look at 16 or 32 bytes at a
+// time from an aligned address, so each is run with its input starting
+// at every offset within a 64 byte block and ending at every length
+// past the next few blocks.  Whitespace is scanned in a buffer aligned
+// here, against a byte-at-a-time count; names, text and line numbers
+// are checked through parsed documents, where a prefix of each length
+// shifts them through the parser's (aligned) buffer.
+//
+void testScanners()
+{
+  //
+  // whitespace, stopped by every byte value:
+  //
+  alignas(64) char buffer[256];
+
+  for (int offset = 0; offset < 64; offset++)
+  {
+    for (int length = 0; length < 100; length++)
+    {
+      for (int stop = 0; stop < 256; stop++)
+      {
+        if (length % 7 != 0 && stop != 'x')
+          continue;
+
+        char* p = buffer + offset;
+        int newlines = 0;
+
+        for (int i = 0; i < length; i++)
+        {
+          p[i] = " \t\n \r\n\f\v"[(i * 5 + offset) % 8];
+          newlines += (p[i] == '\n');
+        }
+
+        p[length] = (char)stop;
+        p[length + 1] = '\0';
+
+        int expectedLength = length;
+        int expectedLines = newlines;
+
+        while (XMLUtil::IsWhiteSpace(p[expectedLength]))
+        {
+          expectedLines += (p[expectedLength] == '\n');
+          expectedLength++;
+        }
+
+        int lines = 0;
+        const char* end = XMLUtil::SkipWhiteSpace((const char*)p, &lines);
+
+        check(end == p + expectedLength && lines == expectedLines,
+              "scanners: whitespace at offset " + to_string(offset) + ", length " + to_string(length) +
+              ", stopped by " + to_string(stop));
+      }
+    }
+  }
+
+  //
+  // names, and names with a byte of each kind put in somewhere:
+  //
+  const char nameBytes[] = "aZz:_.-09AY\xc3\xa9@[`{!?;/";
+
+  for (int pad = 0; pad < 64; pad++)
+  {
+    for (int length = 1; length < 72; length++)
+    {
+      string name;
+
+      for (int i = 0; i < length; i++)
+        name += (i == 0) ? "r_:N"[pad % 4] : "aZz:_.-09AY\xc3\xa9"[(i + pad) % 13];
+
+      string prefix = string(pad, ' ');
+      XMLDocument doc;
+      doc.Parse((prefix + "<" + name + " a=\"1\"/>").c_str());
+
+      check(!doc.Error() && doc.RootElement() != nullptr && doc.RootElement()->Name() == name
+            && doc.RootElement()->IntAttribute("a") == 1,
+            "scanners: name of length " + to_string(length) + " after " + to_string(pad) + " spaces");
+
+      for (size_t b = 0; length > 1 && b + 1 < sizeof(nameBytes); b++)
+      {
+        string odd = name;
+        odd[1 + (length * 7 + b) % (length - 1)] = nameBytes[b];
+
+        bool valid = true;
+
+        for (size_t i = 1; i < odd.size(); i++)
+          valid = valid && XMLUtil::IsNameChar(odd[i]);
+
+        doc.Parse((prefix + "<" + odd + " a=\"1\"/>").c_str());
+
+        check(valid ? (!doc.Error() && doc.RootElement()->Name() == odd) : doc.Error(),
+              "scanners: name with byte " + to_string((unsigned char)nameBytes[b]) + " of length " + to_string(length) +
+              " after " + to_string(pad) + " spaces");
+      }
+    }
+  }
+
+  //
+  // text and attribute values, with entities, line breaks and UTF-8:
+  //
+  const char* units[] = {"a", "b", "\n", "\xc3\xa9", "&amp;", "\r\n", " ", "z", "9", "&lt;", "\t"};
+  const char* decoded[] = {"a", "b", "\n", "\xc3\xa9", "&", "\n", " ", "z", "9", "<", "\t"};
+  minstd_rand generator(22);
+
+  for (int pad = 0; pad < 64; pad++)
+  {
+    for (int length = 1; length < 100; length++)
+    {
+      string raw, text, value, rawValue;
+
+      while ((int)raw.size() < length)
+      {
+        int unit = generator() % 11;
+        raw += units[unit];
+        text += decoded[unit];
+
+        if (unit != 2 && unit != 5 && unit != 10)
+        {
+          rawValue += units[unit];
+          value += decoded[unit];
+        }
+      }
+
+      int newlines = count(text.begin(), text.end(), '\n');
+      string prefix = string(pad, '\n');
+
+      XMLDocument doc;
+      doc.Parse((prefix + "<r v=\"" + rawValue + "\">" + raw + "<e/></r>").c_str());
+
+      const XMLElement* root = doc.RootElement();
+      string what = "scanners: text of length " + to_string(length) + " after " + to_string(pad) + " lines";
+
+      // text that is all whitespace is skipped, as it always was:
+      if (text.find_first_not_of(" \t\n") == string::npos)
+        check(!doc.Error() && root != nullptr && root->GetText() == nullptr, what);
+      else
+        check(!doc.Error() && root != nullptr && root->GetText() != nullptr && root->GetText() == text, what);
+      check(root != nullptr && root->Attribute("v") != nullptr && root->Attribute("v") == value, what + ": attribute");
+      check(root != nullptr && root->GetLineNum() == pad + 1 && root->FirstChildElement("e") != nullptr
+            && root->FirstChildElement("e")->GetLineNum() == pad + 1 + newlines, what + ": line numbers");
+    }
+  }
+}
+//
+// elementDump:
+//
+// Describes the elements under a node: each element's name, line and
+// attributes (with their lines), nested as in the document.  Counts
+// the other nodes (text, comments, declarations...) in others.
+//
+string elementDump(const XMLNode* parent, int& others)
+{
+  string dump;
+
+  for (const XMLNode* node = parent->FirstChild(); node != nullptr; node = node->NextSibling())
+  {
+    const XMLElement* element = node->ToElement();
+
+    if (element == nullptr)
+    {
+      others++;
+      continue;
+    }
+
+    dump += string("<") + element->Name() + "@" + to_string(element->GetLineNum());
+
+    for (const XMLAttribute* a = element->FirstAttribute(); a != nullptr; a = a->Next())
+      dump += string(" ") + a->Name() + "=" + a->Value() + "@" + to_string(a->GetLineNum());
+
+    dump += ">" + elementDump(element, others) + "</>";
+  }
+
+  return dump;
+}
+
+//
+// testElementsOnly:
+//
+// A document parsed elements-only must have the same elements and
+// attributes, on the same lines, as one parsed in full, and nothing
+// else.  A malformed document must fail with the same error on the
+// same line either way, except that a declaration in the wrong place
+// is not checked for.  One document is used for both modes, switching
+// between parses, and must answer as fresh documents do.
+//
+void testElementsOnly(string mapFilename)
+{
+  vector<string> documents = {
+    "<?xml version=\"1.0\"?>\n<!DOCTYPE osm>\n<!-- map -->\n<osm>\n <node id=\"1\"\n  lat=\"2\"/>\n"
+      " text &amp; more\n <![CDATA[ <not> an element ]]>\n <way id=\"3\"><nd ref=\"1\"/>\n</way>\n</osm>\n<!-- end -->\n",
+    "<r/>\n<s/>\n",
+    "<r>unknown &bogus; entity</r>",
+    "<r>\n<s>\n</r>\n",
+    "<r></s>",
+    "<r>\n\n",
+    "<r>\n<!-- unterminated\n</r>\n",
+    "<r>\n\n<![CDATA[ x </r>\n",
+    "<r>\n<!DOCTYPE unterminated\n",
+    "<?xml version=\"1.0\"\n<r/>\n",
+    "<r a=\"1\" a=\"2\"/>",
+    "<r>\n<s a=1/>\n</r>",
+    "<r>\n <s a=\"1\"\n b=\"2\"></s>\n</t>\n",
+    "<r>\n text <\n</r>\n",
+    "<r><s>text</s><!-- comment --><![CDATA[<x>]]>\n</r",
+    "<r>text</r>\ntrailing text\n",
+    "",
+    "   \n  \n",
+    "<!-- only a comment -->\n"
+  };
+
+  documents.push_back(readFile(mapFilename));
+
+  XMLDocument reused;
+
+  for (size_t i = 0; i < documents.size(); i++)
+  {
+    string what = "elements only: document " + to_string(i);
+
+    XMLDocument full;
+    XMLDocument lean;
+    lean.SetElementsOnly(true);
+
+    full.Parse(documents[i].c_str());
+    lean.Parse(documents[i].c_str());
+
+    check(lean.ElementsOnly() && lean.ErrorID() == full.ErrorID() && lean.ErrorLineNum() == full.ErrorLineNum(),
+          what + ": error " + to_string(lean.ErrorID()) + " on line " + to_string(lean.ErrorLineNum()) +
+          ", expected " + to_string(full.ErrorID()) + " on line " + to_string(full.ErrorLineNum()));
+
+    int fullOthers = 0, leanOthers = 0;
+    string fullDump = elementDump(&full, fullOthers);
+
+    if (!full.Error())
+    {
+      check(elementDump(&lean, leanOthers) == fullDump && leanOthers == 0, what + ": elements");
+    }
+
+    for (bool elementsOnly : {true, false, true})
+    {
+      reused.SetElementsOnly(elementsOnly);
+      reused.Parse(documents[i].c_str());
+
+      int reusedOthers = 0;
+      string reusedDump = elementDump(&reused, reusedOthers);
+
+      check(reused.ErrorID() == full.ErrorID() && reused.ErrorLineNum() == full.ErrorLineNum()
+            && (full.Error() || (reusedDump == fullDump && (elementsOnly ? reusedOthers == 0 : reusedOthers == fullOthers))),
+            what + ": reused document, elements only " + (elementsOnly ? "on" : "off"));
+    }
+  }
+
+  // declarations are only found where they are skipped over:
+  const char* misplaced = "<r>\n<?xml version=\"1.0\"?>\n</r>\n";
+
+  XMLDocument full;
+  XMLDocument lean;
+  lean.SetElementsOnly(true);
+
+  check(full.Parse(misplaced) == XML_ERROR_PARSING_DECLARATION && lean.Parse(misplaced) == XML_SUCCESS,
+        "elements only: misplaced declaration");
+
+  // text is not kept:
+  lean.Parse("<r>text<s/>more</r>");
+  check(!lean.Error() && lean.RootElement()->GetText() == nullptr && lean.RootElement()->FirstChildElement("s") != nullptr,
+        "elements only: text");
+}
+//
+// printed:
+//
+// Returns the document printed back out as XML, which reflects every
+// node, or its error.
+//
+string printed(const XMLDocument& doc)
+{
+  if (doc.Error())
+    return "error " + to_string(doc.ErrorID()) + " on line " + to_string(doc.ErrorLineNum());
+
+  XMLPrinter printer;
+  doc.Print(&printer);
+
+  return printer.CStr();
+}
+
+//
+// testDocumentReuse:
+//
+// One document loading many inputs in turn, keeping its memory across
+// Clear(), giving it up with ReleaseMemory(), with blocks of other
+// sizes, or taking them from an arena (too small, large enough, or
+// misaligned), must read each input exactly as a fresh document does.
+// The inputs alternate between large and small and include malformed
+// ones, so leftovers of an earlier load would show.
+//
+void testDocumentReuse(string mapFilename)
+{
+  vector<string> inputs = {
+    readFile(mapFilename),
+    "<r a=\"1\">short</r>",
+    "<r><s>unclosed</r>",
+    "<?xml version=\"1.0\"?>\n<r>\n <s b=\"&lt;2&gt;\"><![CDATA[data]]></s>\n <!-- c -->\n</r>\n",
+    readFile(mapFilename).substr(0, 5000) + "</way></osm>",
+    "<r/>"
+  };
+
+  vector<string> expected;
+
+  for (const string& input : inputs)
+  {
+    XMLDocument fresh;
+    fresh.Parse(input.c_str());
+    expected.push_back(printed(fresh));
+  }
+
+  vector<char> small(64 * 1024), large(16 * 1024 * 1024);
+
+  for (int setup = 0; setup < 7; setup++)
+  {
+    string what = "document reuse " + to_string(setup);
+    XMLDocument doc;
+
+    switch (setup)
+    {
+      case 1: doc.SetPoolBlockSize(64); break;
+      case 2: doc.SetPoolBlockSize(1 << 20); break;
+      case 3: doc.SetArena(small.data(), small.size()); break;
+      case 4: doc.SetArena(large.data(), large.size()); break;
+      case 5: doc.SetArena(large.data() + 3, large.size() - 3); break;
+      case 6: doc.SetArena(small.data() + 1, small.size() - 1); doc.SetPoolBlockSize(100); break;
+    }
+
+    for (int round = 0; round < 3; round++)
+    {
+      for (size_t i = 0; i < inputs.size(); i++)
+      {
+        doc.Parse(inputs[i].c_str());
+        check(printed(doc) == expected[i], what + ", round " + to_string(round) + ", input " + to_string(i));
+
+        // edit the document, so the next load starts from more than it parsed:
+        if (!doc.Error())
+          doc.RootElement()->InsertEndChild(doc.NewElement("added"))->ToElement()->SetAttribute("x", (int)i);
+
+        if (round == 1)
+        {
+          doc.ReleaseMemory();
+          check(doc.RootElement() == nullptr && !doc.Error(), what + ": released");
+        }
+        else if (round == 2 && i % 2 == 0)
+        {
+          doc.Clear();
+        }
+      }
+    }
+
+    check(doc.LoadFile(mapFilename.c_str()) == XML_SUCCESS && printed(doc) == expected[0], what + ": LoadFile");
+
+    // stop taking blocks from the arena, and load again:
+    doc.SetArena(nullptr, 0);
+    doc.Parse(inputs[3].c_str());
+    check(printed(doc) == expected[3], what + ": arena taken away");
+
+    doc.ReleaseMemory();
+    doc.Parse(inputs[0].c_str());
+    check(printed(doc) == expected[0], what + ": after arena taken away and memory released");
+  }
+}
+
+//
+// readSource:
+//
+// Returns everything a byte source hands out, asking for chunk bytes
+// at a time.
+//
+string readSource(ByteSource& source, size_t chunk)
+{
+  string text;
+  vector<char> buffer(chunk);
+  size_t count;
+
+  while ((count = source.read(buffer.data(), chunk)) > 0)
+    text.append(buffer.data(), count);
+
+  return text;
+}
+
+#ifdef TESTING_ZLIB
+//
+// gzipped:
+//
+// Compresses text into one gzip member.
+//
+string gzipped(const string& text)
+{
+  z_stream stream = {};
+  deflateInit2(&stream, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+  string packed(deflateBound(&stream, text.size()), '\0');
+
+  stream.next_in = (Bytef*)text.data();
+  stream.avail_in = (uInt)text.size();
+  stream.next_out = (Bytef*)&packed[0];
+  stream.avail_out = (uInt)packed.size();
+
+  deflate(&stream, Z_FINISH);
+  packed.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  return packed;
+}
+#endif
+
+#ifdef TESTING_BZIP2
+//
+// bzipped:
+//
+// Compresses text into one bzip2 stream.
+//
+string bzipped(const string& text)
+{
+  unsigned int size = (unsigned int)(text.size() + text.size() / 100 + 600);
+  string packed(size, '\0');
+
+  BZ2_bzBuffToBuffCompress(&packed[0], &size, (char*)text.data(), (unsigned int)text.size(), 9, 0, 0);
+  packed.resize(size);
+
+  return packed;
+}
+#endif
+
+//
+// testCompressedInput:
+//
+// A gzip or bzip2 compressed map must be recognized by its first bytes
+// and read exactly as the plain map, also when it is a series of
+// streams such as parallel compressors write, some of them empty.  A
+// compressed file cut short must hand out no more than a prefix of the
+// map, and the loaders must reject it, as they must reject garbage
+// behind the magic bytes.
+//
+void testCompressedInput(string mapFilename)
+{
+  map<long long, Coordinates> DomNodes;
+  vector<FootwayInfo> DomFootways;
+  vector<BuildingInfo> DomBuildings;
+  MapCounts DomCounts;
+
+  check(readWithDom(mapFilename, DomNodes, DomFootways, DomBuildings, DomCounts), "DOM loader: " + mapFilename);
+  check(fileCompression(mapFilename) == Compression::NONE, "compression: plain map");
+  check(fileCompression("testing-missing.osm") == Compression::NONE, "compression: missing file");
+
+  check(!GzipSource("testing-missing.osm.gz").isOpen(), "gzip source: opened a missing file");
+  check(!Bzip2Source("testing-missing.osm.bz2").isOpen(), "bzip2 source: opened a missing file");
+
+  string text = readFile(mapFilename);
+  string packedFilename = "testing-packed.osm";
+
+  //
+  // each format with its compressor, magic bytes and source:
+  //
+  struct Format {
+    string name;
+    Compression compression;
+    string (*pack)(const string&);
+    string magic;
+    unique_ptr<ByteSource> (*open)(const string&);
+  };
+
+  vector<Format> formats;
+
+#ifdef TESTING_ZLIB
+  formats.push_back({"gzip", Compression::GZIP, gzipped, "\x1f\x8b\x08\x00",
+    [](const string& filename) -> unique_ptr<ByteSource> { return make_unique<GzipSource>(filename); }});
+#endif
+#ifdef TESTING_BZIP2
+  formats.push_back({"bzip2", Compression::BZIP2, bzipped, "BZh9",
+    [](const string& filename) -> unique_ptr<ByteSource> { return make_unique<Bzip2Source>(filename); }});
+#endif
+
+  // where the map is split into streams, including empty ones:
+  vector<vector<size_t>> splits = {
+    {},
+    {text.size() / 2},
+    {0, 1, text.size() / 3, text.size() / 3, text.size() - 1},
+    {text.size() / 4, text.size() / 4 + 1, text.size() * 3 / 4 + 7}
+  };
+
+  for (const Format& format : formats)
+  {
+    for (const vector<size_t>& split : splits)
+    {
+      string packed;
+      size_t start = 0;
+
+      for (size_t end : split)
+      {
+        packed += format.pack(text.substr(start, end - start));
+        start = end;
+      }
+
+      packed += format.pack(text.substr(start));
+      writeFile(packedFilename, packed);
+
+      string what = format.name + " with " + to_string(split.size() + 1) + " streams";
+
+      check(fileCompression(packedFilename) == format.compression, what + ": compression");
+
+      for (size_t chunk : {1, 7, 4096, 1 << 20})
+      {
+        check(readSource(*format.open(packedFilename), chunk) == text,
+              what + ": read " + to_string(chunk) + " bytes at a time");
+      }
+
+      for (bool mapFile : {false, true})
+      {
+        map<long long, Coordinates> Nodes;
+        vector<FootwayInfo> Footways;
+        vector<BuildingInfo> Buildings;
+        MapCounts Counts;
+
+        check(StreamOpenStreetMap(packedFilename, Nodes, Footways, Buildings, Counts, mapFile, 2),
+              what + ": stream loader");
+        checkSameMap(what + " stream loader", Nodes, Footways, Buildings, Counts,
+                     DomNodes, DomFootways, DomBuildings, DomCounts);
+      }
+
+      map<long long, Coordinates> Nodes;
+      vector<FootwayInfo> Footways;
+      vector<BuildingInfo> Buildings;
+      MapCounts Counts;
+
+      check(readWithDom(packedFilename, Nodes, Footways, Buildings, Counts), what + ": DOM loader");
+      checkSameMap(what + " DOM loader", Nodes, Footways, Buildings, Counts,
+                   DomNodes, DomFootways, DomBuildings, DomCounts);
+
+      //
+      // cut short: whatever comes out is the start of the map, and while
+      // the map is clearly incomplete the loaders fail:
+      //
+      for (size_t cut = 0; cut < packed.size(); cut += max((size_t)1, packed.size() / 16))
+      {
+        writeFile(packedFilename, packed.substr(0, cut));
+
+        string prefix = readSource(*format.open(packedFilename), 4096);
+        check(text.compare(0, prefix.size(), prefix) == 0,
+              what + ": cut at " + to_string(cut) + " bytes, read more than the map");
+
+        if (cut > packed.size() * 3 / 4)
+          continue;
+
+        check(prefix.size() < text.size(), what + ": cut at " + to_string(cut) + " bytes, read all of the map");
+
+        map<long long, Coordinates> CutNodes;
+        vector<FootwayInfo> CutFootways;
+        vector<BuildingInfo> CutBuildings;
+        MapCounts CutCounts;
+
+        check(!StreamOpenStreetMap(packedFilename, CutNodes, CutFootways, CutBuildings, CutCounts, false, 1),
+              what + ": stream loader read a map cut at " + to_string(cut) + " bytes");
+        check(!readWithDom(packedFilename, CutNodes, CutFootways, CutBuildings, CutCounts),
+              what + ": DOM loader read a map cut at " + to_string(cut) + " bytes");
+      }
+    }
+
+    //
+    // garbage behind the magic bytes, and a valid stream followed by a
+    // damaged one:
+    //
+    minstd_rand generator(25);
+
+    for (size_t size : {0, 1, 10, 100, 10000})
+    {
+      string garbage;
+
+      for (size_t i = 0; i < size; i++)
+        garbage += (char)(generator() & 0xff);
+
+      for (string damaged : {format.magic + garbage, format.pack(text.substr(0, text.size() / 2)) + format.magic + garbage})
+      {
+        writeFile(packedFilename, damaged);
+
+        string what = format.name + " with " + to_string(size) + " bytes of garbage";
+
+        check(fileCompression(packedFilename) == format.compression, what + ": compression");
+
+        map<long long, Coordinates> BadNodes;
+        vector<FootwayInfo> BadFootways;
+        vector<BuildingInfo> BadBuildings;
+        MapCounts BadCounts;
+
+        check(!StreamOpenStreetMap(packedFilename, BadNodes, BadFootways, BadBuildings, BadCounts, false, 1),
+              what + ": stream loader read the map");
+        check(!readWithDom(packedFilename, BadNodes, BadFootways, BadBuildings, BadCounts),
+              what + ": DOM loader read the map");
+      }
+    }
+  }
+
+  remove(packedFilename.c_str());
+}
+
+int main()
+{
+  graph<string,int> G;
+  string filename;
+  string startV;
+
+  cout << "Enter filename containing graph data> ";
+  cin >> filename;
+  cout << endl;
+
+  //
+  // Let's input the graph, and then output to see what we have:
+  //
+  cout << "Building graph:" << endl;
+  buildGraph(filename, G);
+  
+  cout << endl << "Outputting graph:" << endl;
+  outputGraph(G);
+  
+  cout << endl << "Dumping graph:" << endl;
+  G.dump(cout);
+
+  //
+  // Freeze into the CSR layout, the output should be unchanged:
+  //
+  G.freeze();
+
+  cout << endl << "Outputting frozen graph:" << endl;
+  outputGraph(G);
+
+  cout << endl << "Visiting frozen edges:" << endl;
+  outputEdges(G);
+
+  cout << endl << "Dumping frozen graph:" << endl;
+  G.dump(cout);
+
+  //
+  // Check the routing engine against plain Dijkstra, on the graph
+  // above and on a small generated map:
+  //
+  cout << endl << "Running checks:" << endl;
+
+  graph<long long,double> R;
+  buildRoutingGraph(filename, R);
+
+  graph<long long,double> S;
+  buildFixedGraph(S);
+
+  string mapFilename = "testing-map.osm";
+  writeTestMap(mapFilename, 12);
+
+  map<long long, Coordinates> Nodes;
+  vector<FootwayInfo> Footways;
+  vector<BuildingInfo> Buildings;
+  graph<long long,double> M;
+  vector<Coordinates> NodeCoords;
+
+  check(loadTestMap(mapFilename, Nodes, Footways, Buildings, M, NodeCoords), "map: load " + mapFilename);
+
+  testFreezeFrom();
+  testHeap();
+  testShortestPaths(R, filename);
+  testShortestPaths(M, "map");
+  testPointToPoint(R, filename);
+  testPointToPoint(M, "map");
+  testAStar(M, NodeCoords, "map");
+  testLandmarks(M, NodeCoords, "map");
+  testTreeCache(S, "fixed graph");
+  testTreeCache(M, "map");
+  testTreeCacheVersions();
+  testComponents(Nodes, Footways, Buildings, "map");
+  testNearest(NodeCoords, "map");
+  testNearestOrder(NodeCoords, "map");
+  testDistanceKernels(NodeCoords);
+  testTrigDistances(NodeCoords);
+
+  testStreamLoader(mapFilename);
+  testMappedLoader(mapFilename);
+  testCompiledMap(mapFilename);
+  testSnapBuildings(mapFilename);
+  testParallelLoader();
+
+  testNumberParsing();
+  testInternedNames();
+  testScanners();
+  testElementsOnly(mapFilename);
+  testDocumentReuse(mapFilename);
+  testCompressedInput(mapFilename);
+
+  //
+  // The same campus shrunk so that footway edges are about a meter long:
+  //
+  string fineFilename = "testing-fine.osm";
+  writeTestMap(fineFilename, 8, 0.00001);
+
+  {
+    map<long long, Coordinates> FineNodes;
+    vector<FootwayInfo> FineFootways;
+    vector<BuildingInfo> FineBuildings;
+    graph<long long,double> F;
+    vector<Coordinates> FineCoords;
+
+    check(loadTestMap(fineFilename, FineNodes, FineFootways, FineBuildings, F, FineCoords),
+          "map: load " + fineFilename);
+    testAStar(F, FineCoords, "fine map");
+  }
+
+  remove(fineFilename.c_str());
+
+  testHierarchy(S, "fixed graph");
+  testHierarchy(M, "map");
+  testHierarchyFiles(M, S);
+
+  remove(mapFilename.c_str());
+
+  cout << "**Checks: " << numChecks - numFailed << " of " << numChecks << " passed" << endl;
 
   //
   // done:
   //
-  return 0;
+  return numFailed == 0 ? 0 : 1;
 }
@@ -32,6 +32,25 @@ distribution.
 #   include <cstdarg>
 #endif
 
+// std::from_chars converts numbers without sscanf's locale lookups and
+// format parsing; the floating point overloads need a recent library.
+#if __cplusplus >= 201703L && defined(__has_include)
+#   if __has_include(<charconv>)
+#       include <charconv>
+#       include <type_traits>
+#       if defined(__cpp_lib_to_chars)
+#           define TIXML_FROM_CHARS
+#       endif
+#   endif
+#endif
+
+// The text, name and whitespace scanners check 16 bytes at a time with
+// SSE2 (part of every x86-64 CPU), or 32 with AVX2 where the CPU has it.
+#if defined(__GNUC__) && defined(__x86_64__)
+#   include <immintrin.h>
+#   define TIXML_X86_SIMD
+#endif
+
 #if defined(_MSC_VER) && (_MSC_VER >= 1400 ) && (!defined WINCE)
 	// Microsoft Visual Studio, version 2005 and higher. Not WinCE.
 	/*int _snprintf_s(
@@ -204,6 +223,203 @@ void StrPair::SetStr( const char* str, int flags )
 }
 
 
+// Scanners for the parse loops below. Each one starts at p and returns
+// the first byte that stops it, adding the newlines it passed to *lines
+// (if lines is not null):
+//
+//   ScanText        stops at endChar or the terminating null
+//   ScanName        stops at the first byte that is not a name character
+//   ScanWhiteSpace  stops at the first byte that is not ASCII whitespace
+//
+// The SIMD versions only ever load whole aligned blocks, which cannot
+// cross into the next page, so reading a little before p or past the
+// null is safe (though not to AddressSanitizer). ScanName and
+// ScanWhiteSpace only skip bytes that IsNameChar() and IsWhiteSpace()
+// accept in any locale; the scalar loops they feed pick up from there.
+#ifdef TIXML_X86_SIMD
+
+#define TIXML_SCAN_ATTRIBUTES __attribute__((no_sanitize_address))
+
+static inline int CountLines( unsigned newlines, unsigned before )
+{
+    return __builtin_popcount( newlines & ( ( 1ull << before ) - 1 ) );
+}
+
+// Byte masks, 0xff where a byte stops ScanText, is a name character or is
+// whitespace.
+static inline __m128i TextStopsSSE2( __m128i bytes, __m128i endChar )
+{
+    return _mm_or_si128( _mm_cmpeq_epi8( bytes, endChar ), _mm_cmpeq_epi8( bytes, _mm_setzero_si128() ) );
+}
+
+static inline __m128i NameCharsSSE2( __m128i bytes )
+{
+    // Bytes 128 and up are negative as signed chars, and names (see
+    // IsNameStartChar) take all of them.
+    const __m128i folded = _mm_or_si128( bytes, _mm_set1_epi8( 0x20 ) );
+    __m128i name = _mm_cmplt_epi8( bytes, _mm_setzero_si128() );
+    name = _mm_or_si128( name, _mm_and_si128( _mm_cmpgt_epi8( folded, _mm_set1_epi8( 'a' - 1 ) ),
+                                              _mm_cmplt_epi8( folded, _mm_set1_epi8( 'z' + 1 ) ) ) );
+    name = _mm_or_si128( name, _mm_and_si128( _mm_cmpgt_epi8( bytes, _mm_set1_epi8( '0' - 1 ) ),
+                                              _mm_cmplt_epi8( bytes, _mm_set1_epi8( '9' + 1 ) ) ) );
+    name = _mm_or_si128( name, _mm_or_si128( _mm_cmpeq_epi8( bytes, _mm_set1_epi8( ':' ) ),
+                                             _mm_cmpeq_epi8( bytes, _mm_set1_epi8( '_' ) ) ) );
+    return _mm_or_si128( name, _mm_or_si128( _mm_cmpeq_epi8( bytes, _mm_set1_epi8( '.' ) ),
+                                             _mm_cmpeq_epi8( bytes, _mm_set1_epi8( '-' ) ) ) );
+}
+
+static inline __m128i WhiteSpaceSSE2( __m128i bytes )
+{
+    // ' ', and '\t' through '\r'
+    return _mm_or_si128( _mm_cmpeq_epi8( bytes, _mm_set1_epi8( ' ' ) ),
+                         _mm_and_si128( _mm_cmpgt_epi8( bytes, _mm_set1_epi8( '\t' - 1 ) ),
+                                        _mm_cmplt_epi8( bytes, _mm_set1_epi8( '\r' + 1 ) ) ) );
+}
+
+__attribute__((target("avx2")))
+static inline __m256i TextStopsAVX2( __m256i bytes, __m256i endChar )
+{
+    return _mm256_or_si256( _mm256_cmpeq_epi8( bytes, endChar ), _mm256_cmpeq_epi8( bytes, _mm256_setzero_si256() ) );
+}
+
+__attribute__((target("avx2")))
+static inline __m256i NameCharsAVX2( __m256i bytes )
+{
+    const __m256i folded = _mm256_or_si256( bytes, _mm256_set1_epi8( 0x20 ) );
+    __m256i name = _mm256_cmpgt_epi8( _mm256_setzero_si256(), bytes );
+    name = _mm256_or_si256( name, _mm256_and_si256( _mm256_cmpgt_epi8( folded, _mm256_set1_epi8( 'a' - 1 ) ),
+                                                    _mm256_cmpgt_epi8( _mm256_set1_epi8( 'z' + 1 ), folded ) ) );
+    name = _mm256_or_si256( name, _mm256_and_si256( _mm256_cmpgt_epi8( bytes, _mm256_set1_epi8( '0' - 1 ) ),
+                                                    _mm256_cmpgt_epi8( _mm256_set1_epi8( '9' + 1 ), bytes ) ) );
+    name = _mm256_or_si256( name, _mm256_or_si256( _mm256_cmpeq_epi8( bytes, _mm256_set1_epi8( ':' ) ),
+                                                   _mm256_cmpeq_epi8( bytes, _mm256_set1_epi8( '_' ) ) ) );
+    return _mm256_or_si256( name, _mm256_or_si256( _mm256_cmpeq_epi8( bytes, _mm256_set1_epi8( '.' ) ),
+                                                   _mm256_cmpeq_epi8( bytes, _mm256_set1_epi8( '-' ) ) ) );
+}
+
+__attribute__((target("avx2")))
+static inline __m256i WhiteSpaceAVX2( __m256i bytes )
+{
+    return _mm256_or_si256( _mm256_cmpeq_epi8( bytes, _mm256_set1_epi8( ' ' ) ),
+                            _mm256_and_si256( _mm256_cmpgt_epi8( bytes, _mm256_set1_epi8( '\t' - 1 ) ),
+                                              _mm256_cmpgt_epi8( _mm256_set1_epi8( '\r' + 1 ), bytes ) ) );
+}
+
+// The scan loops, one per width. STOPS(bytes) gives the mask of bytes
+// the scan stops at.
+#define TIXML_SCAN_LOOP( WIDTH, VEC, LOAD, MOVEMASK, EQ, SET1, STOPS )                  \
+    const unsigned offset = static_cast<unsigned>( reinterpret_cast<uintptr_t>( p ) & ( WIDTH - 1 ) ); \
+    const char* block = p - offset;                                                     \
+    unsigned skip = ~0u << offset;                                                      \
+    for( ;; ) {                                                                         \
+        const VEC bytes = LOAD( reinterpret_cast<const VEC*>( block ) );               \
+        const unsigned stops = static_cast<unsigned>( MOVEMASK( STOPS ) ) & skip;       \
+        const unsigned newlines = lines ? static_cast<unsigned>( MOVEMASK( EQ( bytes, SET1( '\n' ) ) ) ) & skip : 0; \
+        if ( stops ) {                                                                  \
+            const unsigned at = __builtin_ctz( stops );                                 \
+            if ( lines ) {                                                              \
+                *lines += CountLines( newlines, at );                                   \
+            }                                                                           \
+            return block + at;                                                          \
+        }                                                                               \
+        if ( lines ) {                                                                  \
+            *lines += __builtin_popcount( newlines );                                   \
+        }                                                                               \
+        block += WIDTH;                                                                 \
+        skip = ~0u;                                                                     \
+    }
+
+TIXML_SCAN_ATTRIBUTES
+static const char* ScanTextSSE2( const char* p, char endChar, int* lines )
+{
+    const __m128i end = _mm_set1_epi8( endChar );
+    TIXML_SCAN_LOOP( 16, __m128i, _mm_load_si128, _mm_movemask_epi8, _mm_cmpeq_epi8, _mm_set1_epi8,
+                     TextStopsSSE2( bytes, end ) )
+}
+
+TIXML_SCAN_ATTRIBUTES
+static const char* ScanNameSSE2( const char* p )
+{
+    int* const lines = 0;
+    TIXML_SCAN_LOOP( 16, __m128i, _mm_load_si128, _mm_movemask_epi8, _mm_cmpeq_epi8, _mm_set1_epi8,
+                     _mm_xor_si128( NameCharsSSE2( bytes ), _mm_set1_epi8( -1 ) ) )
+}
+
+TIXML_SCAN_ATTRIBUTES
+static const char* ScanWhiteSpaceSSE2( const char* p, int* lines )
+{
+    TIXML_SCAN_LOOP( 16, __m128i, _mm_load_si128, _mm_movemask_epi8, _mm_cmpeq_epi8, _mm_set1_epi8,
+                     _mm_xor_si128( WhiteSpaceSSE2( bytes ), _mm_set1_epi8( -1 ) ) )
+}
+
+__attribute__((target("avx2"))) TIXML_SCAN_ATTRIBUTES
+static const char* ScanTextAVX2( const char* p, char endChar, int* lines )
+{
+    const __m256i end = _mm256_set1_epi8( endChar );
+    TIXML_SCAN_LOOP( 32, __m256i, _mm256_load_si256, _mm256_movemask_epi8, _mm256_cmpeq_epi8, _mm256_set1_epi8,
+                     TextStopsAVX2( bytes, end ) )
+}
+
+__attribute__((target("avx2"))) TIXML_SCAN_ATTRIBUTES
+static const char* ScanNameAVX2( const char* p )
+{
+    int* const lines = 0;
+    TIXML_SCAN_LOOP( 32, __m256i, _mm256_load_si256, _mm256_movemask_epi8, _mm256_cmpeq_epi8, _mm256_set1_epi8,
+                     _mm256_xor_si256( NameCharsAVX2( bytes ), _mm256_set1_epi8( -1 ) ) )
+}
+
+__attribute__((target("avx2"))) TIXML_SCAN_ATTRIBUTES
+static const char* ScanWhiteSpaceAVX2( const char* p, int* lines )
+{
+    TIXML_SCAN_LOOP( 32, __m256i, _mm256_load_si256, _mm256_movemask_epi8, _mm256_cmpeq_epi8, _mm256_set1_epi8,
+                     _mm256_xor_si256( WhiteSpaceAVX2( bytes ), _mm256_set1_epi8( -1 ) ) )
+}
+
+#undef TIXML_SCAN_LOOP
+
+static const bool hasAVX2 = __builtin_cpu_supports( "avx2" );
+
+static inline const char* ScanText( const char* p, char endChar, int* lines )
+{
+    return hasAVX2 ? ScanTextAVX2( p, endChar, lines ) : ScanTextSSE2( p, endChar, lines );
+}
+
+static inline const char* ScanName( const char* p )
+{
+    return hasAVX2 ? ScanNameAVX2( p ) : ScanNameSSE2( p );
+}
+
+const char* XMLUtil::ScanWhiteSpace( const char* p, int* curLineNumPtr )
+{
+    return hasAVX2 ? ScanWhiteSpaceAVX2( p, curLineNumPtr ) : ScanWhiteSpaceSSE2( p, curLineNumPtr );
+}
+
+#else
+
+static inline const char* ScanText( const char* p, char endChar, int* lines )
+{
+    while ( *p && *p != endChar ) {
+        if ( *p == '\n' && lines ) {
+            ++(*lines);
+        }
+        ++p;
+    }
+    return p;
+}
+
+static inline const char* ScanName( const char* p )
+{
+    return p;
+}
+
+const char* XMLUtil::ScanWhiteSpace( const char* p, int* )
+{
+    return p;
+}
+
+#endif
+
+
 char* StrPair::ParseText( char* p, const char* endTag, int strFlags, int* curLineNumPtr )
 {
     TIXMLASSERT( p );
@@ -214,9 +430,9 @@ char* StrPair::ParseText( char* p, const char* endTag, int strFlags, int* curLin
     const char  endChar = *endTag;
     size_t length = strlen( endTag );
 
-    // Inner loop of text parsing.
-    while ( *p ) {
-        if ( *p == endChar && strncmp( p, endTag, length ) == 0 ) {
+    // Inner loop of text parsing: jump to each endChar in turn.
+    while ( *( p = const_cast<char*>( ScanText( p, endChar, curLineNumPtr ) ) ) ) {
+        if ( strncmp( p, endTag, length ) == 0 ) {
             Set( start, p, strFlags );
             return p + length;
         } else if (*p == '\n') {
@@ -239,7 +455,7 @@ char* StrPair::ParseName( char* p )
     }
 
     char* const start = p;
-    ++p;
+    p = const_cast<char*>( ScanName( p + 1 ) );
     while ( *p && XMLUtil::IsNameChar( *p ) ) {
         ++p;
     }
@@ -287,8 +503,13 @@ const char* StrPair::GetStr()
         _flags ^= NEEDS_FLUSH;
 
         if ( _flags ) {
-            const char* p = _start;	// the read pointer
             char* q = _start;	// the write pointer
+            // Nothing changes before the first '&', CR or LF, so the
+            // rewriting can start there; most strings have none.
+            while( q < _end && *q != '&' && *q != CR && *q != LF ) {
+                ++q;
+            }
+            const char* p = q;	// the read pointer
 
             while( p < _end ) {
                 if ( (_flags & NEEDS_NEWLINE_NORMALIZATION) && *p == CR ) {
@@ -608,8 +829,42 @@ void XMLUtil::ToStr( uint64_t v, char* buffer, int bufferSize )
     TIXML_SNPRINTF(buffer, bufferSize, "%llu", (long long)v);
 }
 
+#ifdef TIXML_FROM_CHARS
+/*
+	Converts the number at the start of str with std::from_chars. It accepts
+	the same ordinary numbers as the sscanf formats below: leading white space,
+	an optional '-', and any text after the number, which is ignored. It
+	returns false for the rarer forms, so the caller can fall back to sscanf:
+	a leading '+', hexadecimal floating point, and values out of range.
+*/
+template<typename T>
+static bool FromChars( const char* str, T* value )
+{
+    while ( XMLUtil::IsWhiteSpace( *str ) ) {
+        ++str;
+    }
+    const char* end = str + strlen( str );
+    T result = 0;
+    const std::from_chars_result converted = std::from_chars( str, end, result );
+    if ( converted.ec != std::errc() ) {
+        return false;
+    }
+    if ( std::is_floating_point<T>::value && converted.ptr < end && ( *converted.ptr == 'x' || *converted.ptr == 'X' ) ) {
+        return false;
+    }
+    *value = result;
+    return true;
+}
+#endif
+
+
 bool XMLUtil::ToInt( const char* str, int* value )
 {
+#ifdef TIXML_FROM_CHARS
+    if ( FromChars( str, value ) ) {
+        return true;
+    }
+#endif
     if ( TIXML_SSCANF( str, "%d", value ) == 1 ) {
         return true;
     }
@@ -618,6 +873,11 @@ bool XMLUtil::ToInt( const char* str, int* value )
 
 bool XMLUtil::ToUnsigned( const char* str, unsigned *value )
 {
+#ifdef TIXML_FROM_CHARS
+    if ( FromChars( str, value ) ) {
+        return true;
+    }
+#endif
     if ( TIXML_SSCANF( str, "%u", value ) == 1 ) {
         return true;
     }
@@ -652,6 +912,11 @@ bool XMLUtil::ToBool( const char* str, bool* value )
 
 bool XMLUtil::ToFloat( const char* str, float* value )
 {
+#ifdef TIXML_FROM_CHARS
+    if ( FromChars( str, value ) ) {
+        return true;
+    }
+#endif
     if ( TIXML_SSCANF( str, "%f", value ) == 1 ) {
         return true;
     }
@@ -661,6 +926,14 @@ bool XMLUtil::ToFloat( const char* str, float* value )
 
 bool XMLUtil::ToDouble( const char* str, double* value )
 {
+    if ( ToFixedDecimal( str, str + strlen( str ), value ) ) {
+        return true;
+    }
+#ifdef TIXML_FROM_CHARS
+    if ( FromChars( str, value ) ) {
+        return true;
+    }
+#endif
     if ( TIXML_SSCANF( str, "%lf", value ) == 1 ) {
         return true;
     }
@@ -668,8 +941,71 @@ bool XMLUtil::ToDouble( const char* str, double* value )
 }
 
 
+/*
+	Parses a plain decimal number, such as the 7-decimal latitudes and
+	longitudes in OpenStreetMap files. The number is an optional '-', then
+	digits, then optionally a '.' and more digits, and it must fill
+	[str, end). With at most 15 digits, the digits form an exactly
+	representable integer, and the power of ten to divide by is exact too.
+	The one division therefore rounds to the same double that strtod gives.
+	Anything else (white space, exponents, longer numbers) returns false
+	without touching value, and the caller should use ToDouble instead.
+*/
+bool XMLUtil::ToFixedDecimal( const char* str, const char* end, double* value )
+{
+    static const double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+        1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+    };
+    static const int MAX_DIGITS = 15;
+
+    const char* p = str;
+    bool negative = false;
+    if ( p < end && *p == '-' ) {
+        negative = true;
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fraction = -1;	// digits after the '.', -1 until there is one
+    for ( ; p < end; ++p ) {
+        if ( *p >= '0' && *p <= '9' ) {
+            if ( ++digits > MAX_DIGITS ) {
+                return false;
+            }
+            mantissa = mantissa * 10 + ( *p - '0' );
+            if ( fraction >= 0 ) {
+                ++fraction;
+            }
+        }
+        else if ( *p == '.' && fraction < 0 ) {
+            fraction = 0;
+        }
+        else {
+            return false;
+        }
+    }
+    if ( digits == 0 ) {
+        return false;
+    }
+
+    double result = static_cast<double>( mantissa );
+    if ( fraction > 0 ) {
+        result /= powersOf10[fraction];
+    }
+    *value = negative ? -result : result;
+    return true;
+}
+
+
 bool XMLUtil::ToInt64(const char* str, int64_t* value)
 {
+#ifdef TIXML_FROM_CHARS
+	if (FromChars(str, value)) {
+		return true;
+	}
+#endif
 	long long v = 0;	// horrible syntax trick to make the compiler happy about %lld
 	if (TIXML_SSCANF(str, "%lld", &v) == 1) {
 		*value = static_cast<int64_t>(v);
@@ -680,6 +1016,11 @@ bool XMLUtil::ToInt64(const char* str, int64_t* value)
 
 
 bool XMLUtil::ToUnsigned64(const char* str, uint64_t* value) {
+#ifdef TIXML_FROM_CHARS
+    if(FromChars(str, value)) {
+        return true;
+    }
+#endif
     unsigned long long v = 0;	// horrible syntax trick to make the compiler happy about %llu
     if(TIXML_SSCANF(str, "%llu", &v) == 1) {
         *value = (uint64_t)v;
@@ -696,6 +1037,13 @@ char* XMLDocument::Identify( char* p, XMLNode** node )
     char* const start = p;
     int const startLine = _parseCurLineNum;
     p = XMLUtil::SkipWhiteSpace( p, &_parseCurLineNum );
+    if ( _elementsOnly && *p ) {
+        p = SkipToElement( p );
+        if ( !p ) {
+            *node = 0;
+            return start;   // the error is set
+        }
+    }
     if( !*p ) {
         *node = 0;
         TIXMLASSERT( p );
@@ -759,6 +1107,67 @@ char* XMLDocument::Identify( char* p, XMLNode** node )
 }
 
 
+// For elements-only parsing: skips the declarations, comments, CDATA
+// sections, DTDs and text from p up to the next element, without
+// creating nodes for them. Returns where the element (or the end of the
+// document) is, or 0 after setting the error parsing the skipped node
+// would have.
+char* XMLDocument::SkipToElement( char* p )
+{
+    for( ;; ) {
+        p = XMLUtil::SkipWhiteSpace( p, &_parseCurLineNum );
+
+        const char* endTag = "<";
+        int headerLen = 0;
+        XMLError error = XML_ERROR_PARSING_TEXT;
+        if ( !*p ) {
+            return p;
+        }
+        else if ( XMLUtil::StringEqual( p, "<?", 2 ) ) {
+            endTag = "?>";
+            headerLen = 2;
+            error = XML_ERROR_PARSING_DECLARATION;
+        }
+        else if ( XMLUtil::StringEqual( p, "<!--", 4 ) ) {
+            endTag = "-->";
+            headerLen = 4;
+            error = XML_ERROR_PARSING_COMMENT;
+        }
+        else if ( XMLUtil::StringEqual( p, "<![CDATA[", 9 ) ) {
+            endTag = "]]>";
+            headerLen = 9;
+            error = XML_ERROR_PARSING_CDATA;
+        }
+        else if ( XMLUtil::StringEqual( p, "<!", 2 ) ) {
+            endTag = ">";
+            headerLen = 2;
+            error = XML_ERROR_PARSING_UNKNOWN;
+        }
+        else if ( *p == '<' ) {
+            return p;
+        }
+
+        const int lineNum = _parseCurLineNum;
+        StrPair skipped;
+        p = skipped.ParseText( p + headerLen, endTag, 0, &_parseCurLineNum );
+        if ( p && *endTag == '<' ) {
+            // text ends where the next node starts
+            if ( !*p ) {
+                error = XML_ERROR_PARSING;
+                p = 0;
+            }
+            else {
+                --p;
+            }
+        }
+        if ( !p ) {
+            SetError( error, lineNum, 0 );
+            return 0;
+        }
+    }
+}
+
+
 bool XMLDocument::Accept( XMLVisitor* visitor ) const
 {
     TIXMLASSERT( visitor );
@@ -783,6 +1192,7 @@ XMLNode::XMLNode( XMLDocument* doc ) :
     _firstChild( 0 ), _lastChild( 0 ),
     _prev( 0 ), _next( 0 ),
 	_userData( 0 ),
+    _nameAtom( 0 ),
     _memPool( 0 )
 {
 }
@@ -812,6 +1222,7 @@ void XMLNode::SetValue( const char* str, bool staticMem )
     else {
         _value.SetStr( str );
     }
+    _nameAtom = ( ToElement() && _document->_internNames ) ? _document->InternName( str ) : 0;
 }
 
 XMLNode* XMLNode::DeepClone(XMLDocument* target) const
@@ -975,8 +1386,9 @@ XMLNode* XMLNode::InsertAfterChild( XMLNode* afterThis, XMLNode* addThis )
 
 const XMLElement* XMLNode::FirstChildElement( const char* name ) const
 {
+    const int atom = name ? _document->LookupAtom( name ) : -1;
     for( const XMLNode* node = _firstChild; node; node = node->_next ) {
-        const XMLElement* element = node->ToElementWithName( name );
+        const XMLElement* element = node->ToElementWithName( name, atom );
         if ( element ) {
             return element;
         }
@@ -987,8 +1399,9 @@ const XMLElement* XMLNode::FirstChildElement( const char* name ) const
 
 const XMLElement* XMLNode::LastChildElement( const char* name ) const
 {
+    const int atom = name ? _document->LookupAtom( name ) : -1;
     for( const XMLNode* node = _lastChild; node; node = node->_prev ) {
-        const XMLElement* element = node->ToElementWithName( name );
+        const XMLElement* element = node->ToElementWithName( name, atom );
         if ( element ) {
             return element;
         }
@@ -999,8 +1412,9 @@ const XMLElement* XMLNode::LastChildElement( const char* name ) const
 
 const XMLElement* XMLNode::NextSiblingElement( const char* name ) const
 {
+    const int atom = name ? _document->LookupAtom( name ) : -1;
     for( const XMLNode* node = _next; node; node = node->_next ) {
-        const XMLElement* element = node->ToElementWithName( name );
+        const XMLElement* element = node->ToElementWithName( name, atom );
         if ( element ) {
             return element;
         }
@@ -1009,10 +1423,33 @@ const XMLElement* XMLNode::NextSiblingElement( const char* name ) const
 }
 
 
+const XMLElement* XMLNode::FirstChildElementByAtom( int atom ) const
+{
+    for( const XMLNode* node = _firstChild; node; node = node->_next ) {
+        if ( atom != 0 && node->_nameAtom == atom ) {
+            return node->ToElement();
+        }
+    }
+    return 0;
+}
+
+
+const XMLElement* XMLNode::NextSiblingElementByAtom( int atom ) const
+{
+    for( const XMLNode* node = _next; node; node = node->_next ) {
+        if ( atom != 0 && node->_nameAtom == atom ) {
+            return node->ToElement();
+        }
+    }
+    return 0;
+}
+
+
 const XMLElement* XMLNode::PreviousSiblingElement( const char* name ) const
 {
+    const int atom = name ? _document->LookupAtom( name ) : -1;
     for( const XMLNode* node = _prev; node; node = node->_prev ) {
-        const XMLElement* element = node->ToElementWithName( name );
+        const XMLElement* element = node->ToElementWithName( name, atom );
         if ( element ) {
             return element;
         }
@@ -1164,7 +1601,8 @@ void XMLNode::InsertChildPreamble( XMLNode* insertThis ) const
 	}
 }
 
-const XMLElement* XMLNode::ToElementWithName( const char* name ) const
+// atom is the atom of name, or -1 if the document does not intern names
+const XMLElement* XMLNode::ToElementWithName( const char* name, int atom ) const
 {
     const XMLElement* element = this->ToElement();
     if ( element == 0 ) {
@@ -1173,6 +1611,9 @@ const XMLElement* XMLNode::ToElementWithName( const char* name ) const
     if ( name == 0 ) {
         return element;
     }
+    if ( atom >= 0 && _nameAtom != 0 ) {
+        return ( _nameAtom == atom ) ? element : 0;
+    }
     if ( XMLUtil::StringEqual( element->Name(), name ) ) {
        return element;
     }
@@ -1565,8 +2006,25 @@ XMLElement::~XMLElement()
 
 const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
 {
+    const int atom = _document->LookupAtom( name );
     for( XMLAttribute* a = _rootAttribute; a; a = a->_next ) {
-        if ( XMLUtil::StringEqual( a->Name(), name ) ) {
+        if ( atom >= 0 && a->_nameAtom != 0 ) {
+            if ( a->_nameAtom == atom ) {
+                return a;
+            }
+        }
+        else if ( XMLUtil::StringEqual( a->Name(), name ) ) {
+            return a;
+        }
+    }
+    return 0;
+}
+
+
+const XMLAttribute* XMLElement::FindAttributeByAtom( int atom ) const
+{
+    for( XMLAttribute* a = _rootAttribute; a; a = a->_next ) {
+        if ( atom != 0 && a->_nameAtom == atom ) {
             return a;
         }
     }
@@ -1853,10 +2311,16 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
 {
     XMLAttribute* last = 0;
     XMLAttribute* attrib = 0;
+    const int atom = _document->LookupAtom( name );
     for( attrib = _rootAttribute;
             attrib;
             last = attrib, attrib = attrib->_next ) {
-        if ( XMLUtil::StringEqual( attrib->Name(), name ) ) {
+        if ( atom >= 0 && attrib->_nameAtom != 0 ) {
+            if ( attrib->_nameAtom == atom ) {
+                break;
+            }
+        }
+        else if ( XMLUtil::StringEqual( attrib->Name(), name ) ) {
             break;
         }
     }
@@ -1872,6 +2336,9 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
             _rootAttribute = attrib;
         }
         attrib->SetName( name );
+        if ( _document->_internNames ) {
+            attrib->_nameAtom = _document->InternName( name );
+        }
     }
     return attrib;
 }
@@ -1917,7 +2384,15 @@ char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
             const int attrLineNum = attrib->_parseLineNum;
 
             p = attrib->ParseDeep( p, _document->ProcessEntities(), curLineNumPtr );
-            if ( !p || Attribute( attrib->Name() ) ) {
+            bool duplicate = false;
+            if ( p && _document->_internNames ) {
+                attrib->_nameAtom = _document->InternName( attrib->Name() );
+                duplicate = FindAttributeByAtom( attrib->_nameAtom ) != 0;
+            }
+            else if ( p ) {
+                duplicate = Attribute( attrib->Name() ) != 0;
+            }
+            if ( !p || duplicate ) {
                 DeleteAttribute( attrib );
                 _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "XMLElement name=%s", Name() );
                 return 0;
@@ -2031,6 +2506,11 @@ char* XMLElement::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr
     }
 
     p = ParseAttributes( p, curLineNumPtr );
+    // Name() terminates the name in place, so it can only be read once the
+    // attributes after it have been parsed
+    if ( p && _document->_internNames ) {
+        _nameAtom = _document->InternName( Name() );
+    }
     if ( !p || !*p || _closingType != OPEN ) {
         return p;
     }
@@ -2124,27 +2604,39 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
     XMLNode( 0 ),
     _writeBOM( false ),
     _processEntities( processEntities ),
+    _elementsOnly( false ),
     _errorID(XML_SUCCESS),
     _whitespaceMode( whitespaceMode ),
     _errorStr(),
     _errorLineNum( 0 ),
     _charBuffer( 0 ),
+    _charBufferSize( 0 ),
     _parseCurLineNum( 0 ),
 	_parsingDepth(0),
     _unlinked(),
+    _arena(),
     _elementPool(),
     _attributePool(),
     _textPool(),
-    _commentPool()
+    _commentPool(),
+    _internNames( false ),
+    _atomNames(),
+    _atomStarts(),
+    _atomTable()
 {
     // avoid VC++ C4355 warning about 'this' in initializer list (C4355 is off by default in VS2012+)
     _document = this;
+    _elementPool.SetArena( &_arena );
+    _attributePool.SetArena( &_arena );
+    _textPool.SetArena( &_arena );
+    _commentPool.SetArena( &_arena );
 }
 
 
 XMLDocument::~XMLDocument()
 {
     Clear();
+    delete [] _charBuffer;
 }
 
 
@@ -2161,6 +2653,78 @@ void XMLDocument::MarkInUse(const XMLNode* const node)
 	}
 }
 
+int XMLDocument::NameAtom( const char* name ) const
+{
+    return FindAtom( name, 0 );
+}
+
+
+// Returns the atom of name, or 0 if it has not been interned. If slot is
+// not null, it is set to where name is (or would go) in _atomTable.
+int XMLDocument::FindAtom( const char* name, int* slot ) const
+{
+    const int size = _atomTable.Size();
+    if ( size == 0 ) {
+        if ( slot ) {
+            *slot = -1;
+        }
+        return 0;
+    }
+
+    unsigned hash = 2166136261u;	// FNV-1a
+    for( const char* q = name; *q; ++q ) {
+        hash ^= static_cast<unsigned char>( *q );
+        hash *= 16777619u;
+    }
+
+    int i = static_cast<int>( hash & static_cast<unsigned>( size - 1 ) );
+    while( _atomTable[i] != 0 ) {
+        const int atom = _atomTable[i];
+        if ( XMLUtil::StringEqual( &_atomNames[_atomStarts[atom - 1]], name ) ) {
+            if ( slot ) {
+                *slot = i;
+            }
+            return atom;
+        }
+        i = ( i + 1 ) & ( size - 1 );
+    }
+    if ( slot ) {
+        *slot = i;
+    }
+    return 0;
+}
+
+
+int XMLDocument::InternName( const char* name )
+{
+    int slot = 0;
+    int atom = FindAtom( name, &slot );
+    if ( atom ) {
+        return atom;
+    }
+
+    // Keep the table at most half full, so probe sequences stay short.
+    if ( ( _atomStarts.Size() + 1 ) * 2 > _atomTable.Size() ) {
+        const int size = _atomTable.Size() ? _atomTable.Size() * 2 : 64;
+        _atomTable.Clear();
+        memset( _atomTable.PushArr( size ), 0, size * sizeof( int ) );
+        for( int a = 1; a <= _atomStarts.Size(); ++a ) {
+            int free = 0;
+            FindAtom( &_atomNames[_atomStarts[a - 1]], &free );
+            _atomTable[free] = a;
+        }
+        FindAtom( name, &slot );
+    }
+
+    const int length = static_cast<int>( strlen( name ) ) + 1;
+    _atomStarts.Push( _atomNames.Size() );
+    memcpy( _atomNames.PushArr( length ), name, length );
+    atom = _atomStarts.Size();
+    _atomTable[slot] = atom;
+    return atom;
+}
+
+
 void XMLDocument::Clear()
 {
     DeleteChildren();
@@ -2173,8 +2737,6 @@ void XMLDocument::Clear()
 #endif
     ClearError();
 
-    delete [] _charBuffer;
-    _charBuffer = 0;
 	_parsingDepth = 0;
 
 #if 0
@@ -2192,6 +2754,50 @@ void XMLDocument::Clear()
         TIXMLASSERT( _commentPool.CurrentAllocs()   == _commentPool.Untracked() );
     }
 #endif
+
+    // Every node is gone, including any a failed parse left in the pools,
+    // so the pools can start again from their first items.
+    _elementPool.Reset();
+    _attributePool.Reset();
+    _textPool.Reset();
+    _commentPool.Reset();
+}
+
+
+void XMLDocument::ReleaseMemory()
+{
+    Clear();
+
+    _elementPool.Clear();
+    _attributePool.Clear();
+    _textPool.Clear();
+    _commentPool.Clear();
+    _arena.Rewind();
+
+    delete [] _charBuffer;
+    _charBuffer = 0;
+    _charBufferSize = 0;
+}
+
+
+void XMLDocument::SetPoolBlockSize( int bytes )
+{
+    _elementPool.SetBlockSize( bytes );
+    _attributePool.SetBlockSize( bytes );
+    _textPool.SetBlockSize( bytes );
+    _commentPool.SetBlockSize( bytes );
+}
+
+
+// Makes _charBuffer at least size bytes, keeping the one an earlier
+// document was read into if it is big enough.
+void XMLDocument::ReserveCharBuffer( size_t size )
+{
+    if ( size > _charBufferSize ) {
+        delete [] _charBuffer;
+        _charBuffer = new char[size];
+        _charBufferSize = size;
+    }
 }
 
 
@@ -2339,8 +2945,7 @@ XMLError XMLDocument::LoadFile( FILE* fp )
     }
 
     const size_t size = static_cast<size_t>(filelength);
-    TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[size+1];
+    ReserveCharBuffer( size+1 );
     const size_t read = fread( _charBuffer, 1, size, fp );
     if ( read != size ) {
         SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
@@ -2395,8 +3000,7 @@ XMLError XMLDocument::Parse( const char* p, size_t len )
     if ( len == static_cast<size_t>(-1) ) {
         len = strlen( p );
     }
-    TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[ len+1 ];
+    ReserveCharBuffer( len+1 );
     memcpy( _charBuffer, p, len );
     _charBuffer[len] = 0;
 
@@ -2404,12 +3008,16 @@ XMLError XMLDocument::Parse( const char* p, size_t len )
     if ( Error() ) {
         // clean up now essentially dangling memory.
         // and the parse fail can put objects in the
-        // pools that are dead and inaccessible.
+        // pools that are dead and inaccessible. Reset them
+        // rather than free them, so their blocks are reused.
         DeleteChildren();
-        _elementPool.Clear();
-        _attributePool.Clear();
-        _textPool.Clear();
-        _commentPool.Clear();
+        while( _unlinked.Size()) {
+            DeleteNode(_unlinked[0]);
+        }
+        _elementPool.Reset();
+        _attributePool.Reset();
+        _textPool.Reset();
+        _commentPool.Reset();
     }
     return _errorID;
 }
@@ -322,6 +322,54 @@ private:
 };
 
 
+/*
+	A region of memory supplied by the user (see XMLDocument::SetArena())
+	that the pools of a document take their blocks from, in order, before
+	they go to the heap.
+*/
+class MemArena
+{
+public:
+    MemArena() : _start( 0 ), _next( 0 ), _end( 0 ) {}
+
+    void Set( void* memory, size_t size ) {
+        _start = static_cast<char*>( memory );
+        _next = _start;
+        _end = _start ? _start + size : 0;
+    }
+
+    // Returns size bytes, aligned for any item, or null if the rest of
+    // the region is too small.
+    void* Alloc( size_t size ) {
+        if ( !_next ) {
+            return 0;
+        }
+        const size_t misalign = reinterpret_cast<uintptr_t>( _next ) % ALIGNMENT;
+        char* const block = misalign ? _next + ( ALIGNMENT - misalign ) : _next;
+        if ( block > _end || static_cast<size_t>( _end - block ) < size ) {
+            return 0;
+        }
+        _next = block + size;
+        return block;
+    }
+
+    // Makes the whole region available again; only once nothing uses it.
+    void Rewind() {
+        _next = _start;
+    }
+
+    enum { ALIGNMENT = 16 };
+
+private:
+    MemArena( const MemArena& ); // not supported
+    void operator=( const MemArena& ); // not supported
+
+    char* _start;
+    char* _next;
+    char* _end;
+};
+
+
 /*
 	Parent virtual class of a pool for fast allocation
 	and deallocation of objects.
@@ -346,16 +394,18 @@ template< int ITEM_SIZE >
 class MemPoolT : public MemPool
 {
 public:
-    MemPoolT() : _blockPtrs(), _root(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
+    MemPoolT() : _blocks(), _root(0), _itemsPerBlock(ITEMS_PER_BLOCK), _arena(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
     ~MemPoolT() {
         MemPoolT< ITEM_SIZE >::Clear();
     }
 
     void Clear() {
-        // Delete the blocks.
-        while( !_blockPtrs.Empty()) {
-            Block* lastBlock = _blockPtrs.Pop();
-            delete lastBlock;
+        // Delete the blocks (those from the arena go back with it).
+        while( !_blocks.Empty()) {
+            Block lastBlock = _blocks.Pop();
+            if ( lastBlock.owned ) {
+                delete [] lastBlock.items;
+            }
         }
         _root = 0;
         _currentAllocs = 0;
@@ -364,6 +414,32 @@ public:
         _nUntracked = 0;
     }
 
+    // Frees every item at once, keeping the blocks. The free list is
+    // rebuilt in block order, so the items are handed out again in the
+    // same order as from new blocks. Only call this once no item is used.
+    void Reset() {
+        Item* next = 0;
+        for( int b = _blocks.Size() - 1; b >= 0; --b ) {
+            Item* const items = _blocks[b].items;
+            for( int i = _blocks[b].count - 1; i >= 0; --i ) {
+                items[i].next = next;
+                next = &items[i];
+            }
+        }
+        _root = next;
+        _currentAllocs = 0;
+        _nUntracked = 0;
+    }
+
+    // Sets the size of the blocks allocated from now on, in bytes.
+    void SetBlockSize( int bytes ) {
+        _itemsPerBlock = bytes > ITEM_SIZE ? bytes / ITEM_SIZE : 1;
+    }
+
+    void SetArena( MemArena* arena ) {
+        _arena = arena;
+    }
+
     virtual int ItemSize() const	{
         return ITEM_SIZE;
     }
@@ -374,14 +450,20 @@ public:
     virtual void* Alloc() {
         if ( !_root ) {
             // Need a new block.
-            Block* block = new Block();
-            _blockPtrs.Push( block );
+            Block block;
+            block.count = _itemsPerBlock;
+            block.items = _arena ? static_cast<Item*>( _arena->Alloc( block.count * sizeof( Item ) ) ) : 0;
+            block.owned = ( block.items == 0 );
+            if ( block.owned ) {
+                block.items = new Item[block.count];
+            }
+            _blocks.Push( block );
 
-            Item* blockItems = block->items;
-            for( int i = 0; i < ITEMS_PER_BLOCK - 1; ++i ) {
+            Item* blockItems = block.items;
+            for( int i = 0; i < block.count - 1; ++i ) {
                 blockItems[i].next = &(blockItems[i + 1]);
             }
-            blockItems[ITEMS_PER_BLOCK - 1].next = 0;
+            blockItems[block.count - 1].next = 0;
             _root = blockItems;
         }
         Item* const result = _root;
@@ -412,7 +494,7 @@ public:
     void Trace( const char* name ) {
         printf( "Mempool %s watermark=%d [%dk] current=%d size=%d nAlloc=%d blocks=%d\n",
                 name, _maxAllocs, _maxAllocs * ITEM_SIZE / 1024, _currentAllocs,
-                ITEM_SIZE, _nAllocs, _blockPtrs.Size() );
+                ITEM_SIZE, _nAllocs, _blocks.Size() );
     }
 
     void SetTracked() {
@@ -434,6 +516,7 @@ public:
 	//		64k:	4000	21000
     // Declared public because some compilers do not accept to use ITEMS_PER_BLOCK
     // in private part if ITEMS_PER_BLOCK is private
+    // (It is the default; see SetBlockSize().)
     enum { ITEMS_PER_BLOCK = (4 * 1024) / ITEM_SIZE };
 
 private:
@@ -445,10 +528,14 @@ private:
         char    itemData[ITEM_SIZE];
     };
     struct Block {
-        Item items[ITEMS_PER_BLOCK];
+        Item*   items;
+        int     count;
+        bool    owned;      // allocated with new, rather than from the arena
     };
-    DynArray< Block*, 10 > _blockPtrs;
+    DynArray< Block, 10 > _blocks;
     Item* _root;
+    int _itemsPerBlock;
+    MemArena* _arena;
 
     int _currentAllocs;
     int _nAllocs;
@@ -553,6 +640,9 @@ public:
     static const char* SkipWhiteSpace( const char* p, int* curLineNumPtr )	{
         TIXMLASSERT( p );
 
+        if ( IsWhiteSpace(*p) ) {
+            p = ScanWhiteSpace( p, curLineNumPtr );
+        }
         while( IsWhiteSpace(*p) ) {
             if (curLineNumPtr && *p == '\n') {
                 ++(*curLineNumPtr);
@@ -566,6 +656,10 @@ public:
         return const_cast<char*>( SkipWhiteSpace( const_cast<const char*>(p), curLineNumPtr ) );
     }
 
+    // Skips a run of ASCII whitespace, many bytes at a time where the CPU
+    // allows; SkipWhiteSpace() finishes off anything it leaves.
+    static const char* ScanWhiteSpace( const char* p, int* curLineNumPtr );
+
     // Anything in the high order range of UTF-8 is assumed to not be whitespace. This isn't
     // correct, but simple, and usually works.
     static bool IsWhiteSpace( char p )					{
@@ -627,6 +721,8 @@ public:
     static bool ToDouble( const char* str, double* value );
 	static bool ToInt64(const char* str, int64_t* value);
     static bool ToUnsigned64(const char* str, uint64_t* value);
+    // exact fast path for plain decimals such as lat/lon, see tinyxml2.cpp
+    static bool ToFixedDecimal( const char* str, const char* end, double* value );
 	// Changes what is serialized for a boolean value.
 	// Default to "true" and "false". Shouldn't be changed
 	// unless you have a special testing or compatibility need.
@@ -827,6 +923,20 @@ public:
         return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->NextSiblingElement( name ) );
     }
 
+    /** Get the first child element, or the next sibling element, whose
+        name has the given atom (see XMLDocument::SetInternNames()). This
+        compares integers only; an atom of 0 matches nothing.
+    */
+    const XMLElement* FirstChildElementByAtom( int atom ) const;
+    const XMLElement* NextSiblingElementByAtom( int atom ) const;
+
+    XMLElement* FirstChildElementByAtom( int atom ) {
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->FirstChildElementByAtom( atom ) );
+    }
+    XMLElement* NextSiblingElementByAtom( int atom ) {
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->NextSiblingElementByAtom( atom ) );
+    }
+
     /**
     	Add a child node as the last (right) child.
 		If the child node is already part of the document,
@@ -957,13 +1067,14 @@ protected:
     XMLNode*		_next;
 
 	void*			_userData;
+    int             _nameAtom;  // atom of an element's interned name, 0 if not interned
 
 private:
     MemPool*		_memPool;
     void Unlink( XMLNode* child );
     static void DeleteNode( XMLNode* node );
     void InsertChildPreamble( XMLNode* insertThis ) const;
-    const XMLElement* ToElementWithName( const char* name ) const;
+    const XMLElement* ToElementWithName( const char* name, int atom ) const;
 
     XMLNode( const XMLNode& );	// not supported
     XMLNode& operator=( const XMLNode& );	// not supported
@@ -1138,6 +1249,11 @@ public:
     /// The name of the attribute.
     const char* Name() const;
 
+    /// The atom of the name, if the document interns names, or 0.
+    int NameAtom() const {
+        return _nameAtom;
+    }
+
     /// The value of the attribute.
     const char* Value() const;
 
@@ -1234,7 +1350,7 @@ public:
 private:
     enum { BUF_SIZE = 200 };
 
-    XMLAttribute() : _name(), _value(),_parseLineNum( 0 ), _next( 0 ), _memPool( 0 ) {}
+    XMLAttribute() : _name(), _value(),_parseLineNum( 0 ), _nameAtom( 0 ), _next( 0 ), _memPool( 0 ) {}
     virtual ~XMLAttribute()	{}
 
     XMLAttribute( const XMLAttribute& );	// not supported
@@ -1246,6 +1362,7 @@ private:
     mutable StrPair _name;
     mutable StrPair _value;
     int             _parseLineNum;
+    int             _nameAtom;	// atom of the interned name, 0 if not interned
     XMLAttribute*   _next;
     MemPool*        _memPool;
 };
@@ -1267,6 +1384,10 @@ public:
     void SetName( const char* str, bool staticMem=false )	{
         SetValue( str, staticMem );
     }
+    /// The atom of the name, if the document interns names, or 0.
+    int NameAtom() const {
+        return _nameAtom;
+    }
 
     virtual XMLElement* ToElement()				{
         return this;
@@ -1506,6 +1627,8 @@ public:
     }
     /// Query a specific attribute in the list.
     const XMLAttribute* FindAttribute( const char* name ) const;
+    /// Query a specific attribute by the atom of its name, comparing integers only.
+    const XMLAttribute* FindAttributeByAtom( int atom ) const;
 
     /** Convenience function for easy access to the text inside an element. Although easy
     	and concise, GetText() is limited compared to getting the XMLText child
@@ -1782,6 +1905,42 @@ public:
         return _whitespaceMode;
     }
 
+    /**
+    	Turns elements-only parsing on or off (it is off by default). While
+    	it is on, Parse() and LoadFile() build only elements and their
+    	attributes. Text, CDATA sections, comments, declarations and DTDs
+    	are skipped over without allocating nodes for them, so GetText()
+    	finds nothing. What is skipped must still be terminated, but
+    	declarations are not checked for where they appear.
+    */
+    void SetElementsOnly( bool elementsOnly ) {
+        _elementsOnly = elementsOnly;
+    }
+    bool ElementsOnly() const {
+        return _elementsOnly;
+    }
+
+    /**
+    	Turns name interning on or off (it is off by default). While it is
+    	on, each element and attribute name that is parsed or set maps to a
+    	small integer atom. FirstChildElement(), NextSiblingElement(),
+    	FindAttribute() and the other name lookups then compare atoms
+    	instead of strings. Names set while interning was off keep being
+    	compared as strings. Atoms stay valid for the life of the document,
+    	across Clear().
+    */
+    void SetInternNames( bool internNames ) {
+        _internNames = internNames;
+    }
+    bool InternNames() const {
+        return _internNames;
+    }
+    /**
+    	Returns the atom of a name, or 0 if no element or attribute with that
+    	name has been interned, in which case no lookup by atom will match.
+    */
+    int NameAtom( const char* name ) const;
+
     /**
     	Returns true if this document has a leading Byte Order Mark of UTF8.
     */
@@ -1893,9 +2052,36 @@ public:
         return _errorLineNum;
     }
 
-    /// Clear the document, resetting it to the initial state.
+    /**
+    	Clear the document, resetting it to the initial state. The memory
+    	for its nodes and text is kept to parse the next document into, so
+    	loading many files with one XMLDocument does not go back to the
+    	heap for each of them; ReleaseMemory() gives it up.
+    */
     void Clear();
 
+    /// Clear the document, and free the memory Clear() keeps.
+    void ReleaseMemory();
+
+    /**
+    	Sets the size, in bytes, of the blocks the document allocates its
+    	nodes and attributes in from now on (4k by default). Large documents
+    	parse a little faster with larger blocks.
+    */
+    void SetPoolBlockSize( int bytes );
+
+    /**
+    	Gives the document a region of memory to take its blocks of nodes
+    	and attributes from, before it goes to the heap. The memory must
+    	stay valid until the document is destroyed or ReleaseMemory() is
+    	called, which starts again from the beginning of the region. Until
+    	then, do not hand the same memory to SetArena() again; pass null to
+    	stop taking new blocks from it.
+    */
+    void SetArena( void* memory, size_t size ) {
+        _arena.Set( memory, size );
+    }
+
 	/**
 		Copies this document to a target document.
 		The target will be completely cleared before the copy.
@@ -1924,11 +2110,13 @@ private:
 
     bool			_writeBOM;
     bool			_processEntities;
+    bool			_elementsOnly;
     XMLError		_errorID;
     Whitespace		_whitespaceMode;
     mutable StrPair	_errorStr;
     int             _errorLineNum;
     char*			_charBuffer;
+    size_t			_charBufferSize;	// allocated, kept across Clear()
     int				_parseCurLineNum;
 	int				_parsingDepth;
 	// Memory tracking does add some overhead.
@@ -1939,14 +2127,32 @@ private:
 	// and the performance is the same.
 	DynArray<XMLNode*, 10> _unlinked;
 
+    MemArena _arena;	// declared before the pools that use it
     MemPoolT< sizeof(XMLElement) >	 _elementPool;
     MemPoolT< sizeof(XMLAttribute) > _attributePool;
     MemPoolT< sizeof(XMLText) >		 _textPool;
     MemPoolT< sizeof(XMLComment) >	 _commentPool;
 
+    // Interned names: atom n (from 1) is the null terminated string at
+    // _atomNames[_atomStarts[n-1]]. _atomTable is an open addressing hash
+    // table of atoms, 0 for an empty slot, its size a power of 2.
+    bool			_internNames;
+    DynArray<char, 256> _atomNames;
+    DynArray<int, 64>	_atomStarts;
+    DynArray<int, 64>	_atomTable;
+
 	static const char* _errorNames[XML_ERROR_COUNT];
 
+    int InternName( const char* name );
+    int FindAtom( const char* name, int* slot ) const;
+    // atom to compare names with, or -1 if names are not interned
+    int LookupAtom( const char* name ) const {
+        return _internNames ? NameAtom( name ) : -1;
+    }
+
     void Parse();
+    char* SkipToElement( char* p );
+    void ReserveCharBuffer( size_t size );
 
     void SetError( XMLError error, int lineNum, const char* format, ... );
 
@@ -0,0 +1,1044 @@
+/*xmlstream.cpp*/
+
+//
+// Streaming (pull) XML parser, see xmlstream.h.
+//
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "xmlstream.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define XMLSTREAM_MMAP
+#endif
+
+#if defined(__has_include)
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define XMLSTREAM_ZLIB
+#endif
+#if __has_include(<bzlib.h>)
+#include <bzlib.h>
+#define XMLSTREAM_BZIP2
+#endif
+#endif
+
+using namespace std;
+
+
+//
+// contents
+//
+// By default a source is read in chunks and has no contents in memory.
+//
+bool ByteSource::contents(const char*& data, size_t& size) const
+{
+  data = nullptr;
+  size = 0;
+  return false;
+}
+
+
+//
+// FileSource
+//
+FileSource::FileSource(const string& filename)
+{
+  file = fopen(filename.c_str(), "rb");
+}
+
+
+FileSource::~FileSource()
+{
+  if (file != nullptr)
+    fclose(file);
+}
+
+
+//
+// isOpen
+//
+// Returns true if the file could be opened.
+//
+bool FileSource::isOpen() const
+{
+  return file != nullptr;
+}
+
+
+//
+// read
+//
+size_t FileSource::read(char* buffer, size_t size)
+{
+  if (file == nullptr)
+    return 0;
+
+  return fread(buffer, 1, size, file);
+}
+
+
+//
+// MappedFileSource
+//
+MappedFileSource::MappedFileSource(const string& filename)
+  : data(nullptr), size(0), offset(0), mapped(false)
+{
+#ifdef XMLSTREAM_MMAP
+  int fd = open(filename.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return;
+
+  struct stat info;
+
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+  {
+    size = info.st_size;
+
+    if (size == 0)
+    {
+      mapped = true;  // nothing to map, but a valid (empty) file
+    }
+    else
+    {
+      void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (mapping != MAP_FAILED)
+      {
+        // parsed front to back once: let the kernel read ahead
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = (const char*)mapping;
+        mapped = true;
+      }
+    }
+  }
+
+  close(fd);  // the mapping stays valid
+#endif
+}
+
+
+MappedFileSource::~MappedFileSource()
+{
+#ifdef XMLSTREAM_MMAP
+  if (data != nullptr)
+    munmap((void*)data, size);
+#endif
+}
+
+
+//
+// isOpen
+//
+// Returns true if the file was mapped.
+//
+bool MappedFileSource::isOpen() const
+{
+  return mapped;
+}
+
+
+//
+// read
+//
+// Copies the next bytes of the mapping, for callers that want chunks.
+//
+size_t MappedFileSource::read(char* buffer, size_t count)
+{
+  // an empty file has no mapping, and data is null
+  if (!mapped || offset == size)
+    return 0;
+
+  count = min(count, size - offset);
+  memcpy(buffer, data + offset, count);
+  offset += count;
+
+  return count;
+}
+
+
+//
+// contents
+//
+// Returns the whole mapped file.
+//
+bool MappedFileSource::contents(const char*& data, size_t& size) const
+{
+  data = this->data;
+  size = this->size;
+  return mapped && this->data != nullptr;
+}
+
+
+//
+// MemorySource
+//
+MemorySource::MemorySource(const char* data, size_t size)
+  : data(data), size(size), offset(0)
+{
+}
+
+
+//
+// read
+//
+size_t MemorySource::read(char* buffer, size_t count)
+{
+  if (offset == size)
+    return 0;
+
+  count = min(count, size - offset);
+  memcpy(buffer, data + offset, count);
+  offset += count;
+
+  return count;
+}
+
+
+//
+// contents
+//
+bool MemorySource::contents(const char*& data, size_t& size) const
+{
+  data = this->data;
+  size = this->size;
+  return true;
+}
+
+
+//
+// GzipSource
+//
+// zlib reads the file through a buffer of its own, and inflates from it
+// into the caller's buffer.
+//
+static const unsigned GZIP_BUFFER_BYTES = 128 * 1024;
+
+GzipSource::GzipSource(const string& filename)
+  : file(nullptr)
+{
+#ifdef XMLSTREAM_ZLIB
+  gzFile gz = gzopen(filename.c_str(), "rb");
+
+  if (gz != nullptr)
+  {
+    gzbuffer(gz, GZIP_BUFFER_BYTES);
+    file = gz;
+  }
+#endif
+}
+
+
+GzipSource::~GzipSource()
+{
+#ifdef XMLSTREAM_ZLIB
+  if (file != nullptr)
+    gzclose((gzFile)file);
+#endif
+}
+
+
+//
+// isOpen
+//
+bool GzipSource::isOpen() const
+{
+  return file != nullptr;
+}
+
+
+//
+// read
+//
+size_t GzipSource::read(char* buffer, size_t size)
+{
+#ifdef XMLSTREAM_ZLIB
+  if (file == nullptr)
+    return 0;
+
+  // gzread counts in unsigned ints:
+  int count = gzread((gzFile)file, buffer, (unsigned)min(size, (size_t)1 << 30));
+
+  if (count > 0)
+    return count;
+
+  gzclose((gzFile)file);   // at the end, or damaged
+  file = nullptr;
+#endif
+  return 0;
+}
+
+
+//
+// Bzip2Source
+//
+Bzip2Source::Bzip2Source(const string& filename)
+  : file(nullptr), stream(nullptr)
+{
+#ifdef XMLSTREAM_BZIP2
+  file = fopen(filename.c_str(), "rb");
+
+  if (file != nullptr && !openStream(nullptr, 0))
+  {
+    fclose(file);
+    file = nullptr;
+  }
+#endif
+}
+
+
+Bzip2Source::~Bzip2Source()
+{
+  closeStream();
+
+  if (file != nullptr)
+    fclose(file);
+}
+
+
+//
+// openStream / closeStream
+//
+// Starts decompressing the next bzip2 stream in the file, beginning
+// with the bytes the previous stream read past its end.
+//
+bool Bzip2Source::openStream(const char* unused, int numUnused)
+{
+#ifdef XMLSTREAM_BZIP2
+  int error = BZ_OK;
+
+  stream = BZ2_bzReadOpen(&error, file, 0, 0, (void*)unused, numUnused);
+
+  if (error != BZ_OK)
+  {
+    closeStream();
+    return false;
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+void Bzip2Source::closeStream()
+{
+#ifdef XMLSTREAM_BZIP2
+  if (stream != nullptr)
+  {
+    int error = BZ_OK;
+    BZ2_bzReadClose(&error, stream);
+    stream = nullptr;
+  }
+#endif
+}
+
+
+//
+// isOpen
+//
+bool Bzip2Source::isOpen() const
+{
+  return file != nullptr;
+}
+
+
+//
+// read
+//
+size_t Bzip2Source::read(char* buffer, size_t size)
+{
+  size_t total = 0;
+
+#ifdef XMLSTREAM_BZIP2
+  while (stream != nullptr && total < size)
+  {
+    int error = BZ_OK;
+    int count = BZ2_bzRead(&error, stream, buffer + total, (int)min(size - total, (size_t)1 << 30));
+
+    if (error != BZ_OK && error != BZ_STREAM_END)
+    {
+      closeStream();   // damaged
+      break;
+    }
+
+    total += count;
+
+    if (error == BZ_STREAM_END)
+    {
+      //
+      // another stream may follow, starting in the bytes already read:
+      //
+      void* unusedData = nullptr;
+      int numUnused = 0;
+      char unused[BZ_MAX_UNUSED];
+
+      BZ2_bzReadGetUnused(&error, stream, &unusedData, &numUnused);
+      memcpy(unused, unusedData, numUnused);
+      closeStream();
+
+      int next = (numUnused > 0) ? EOF : fgetc(file);
+
+      if (next != EOF)
+        ungetc(next, file);
+
+      if (numUnused > 0 || next != EOF)
+        openStream(unused, numUnused);
+    }
+  }
+#endif
+
+  return total;
+}
+
+
+//
+// fileCompression
+//
+Compression fileCompression(const string& filename)
+{
+  unsigned char magic[3] = {0, 0, 0};
+  FILE* file = fopen(filename.c_str(), "rb");
+
+  if (file == nullptr)
+    return Compression::NONE;
+
+  size_t count = fread(magic, 1, sizeof(magic), file);
+  fclose(file);
+
+  if (count >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    return Compression::GZIP;
+
+  if (count >= 3 && magic[0] == 'B' && magic[1] == 'Z' && magic[2] == 'h')
+    return Compression::BZIP2;
+
+  return Compression::NONE;
+}
+
+
+//
+// isSpace / isNameChar
+//
+// Characters that separate the parts of a tag, and characters that can
+// appear in element and attribute names (anything else, which includes
+// all non-ASCII letters).
+//
+static bool isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool isNameChar(char c)
+{
+  return !isSpace(c) && c != '/' && c != '>' && c != '<' && c != '=' && c != '"' && c != '\'';
+}
+
+
+//
+// XmlPullParser
+//
+// chunkSize is the number of bytes read from the source at a time.  If
+// the source has its contents in memory, they are parsed in place.
+//
+XmlPullParser::XmlPullParser(ByteSource& source, size_t chunkSize)
+  : source(source), chunkSize(chunkSize), text(nullptr), base(0), pos(0), end(0), atEnd(false),
+    pendingEnd(false), sawRoot(false), fragment(false)
+{
+  if (source.contents(text, end))
+  {
+    atEnd = true;
+  }
+  else
+  {
+    buffer.resize(chunkSize);
+    text = buffer.data();
+    end = 0;
+  }
+}
+
+
+//
+// readMore
+//
+// Moves the unparsed bytes to the front of the buffer and appends the
+// next chunk of the source, growing the buffer only if a single piece
+// of markup is longer than a chunk.  Returns false at the end of the
+// source.
+//
+bool XmlPullParser::readMore()
+{
+  if (atEnd)
+    return false;
+
+  size_t remaining = end - pos;
+  base += pos;
+
+  if (pos > 0)
+    memmove(buffer.data(), buffer.data() + pos, remaining);
+
+  pos = 0;
+  end = remaining;
+
+  if (buffer.size() - end < chunkSize)
+    buffer.resize(end + chunkSize);
+
+  text = buffer.data();
+  size_t count = source.read(buffer.data() + end, chunkSize);
+
+  if (count == 0)
+  {
+    atEnd = true;
+    return false;
+  }
+
+  end += count;
+  return true;
+}
+
+
+//
+// find
+//
+// Returns the position of pattern in the buffer at or after from, or
+// string_view::npos if it is not (yet) in the buffer.
+//
+size_t XmlPullParser::find(size_t from, const char* pattern) const
+{
+  string_view window(text + from, end - from);
+  size_t found = window.find(pattern);
+
+  return (found == string_view::npos) ? found : from + found;
+}
+
+
+//
+// parseMarkup
+//
+// Parses the markup starting with the '<' at pos, setting length to
+// its size in bytes and event to the event it produces.
+//
+XmlPullParser::Status XmlPullParser::parseMarkup(size_t& length, Event& event)
+{
+  if (end - pos < 2)
+    return NEED_MORE;
+
+  const char* markup = text + pos;
+  size_t close = string_view::npos;
+
+  switch (markup[1])
+  {
+    case '?':  // processing instruction or XML declaration
+      close = find(pos + 2, "?>");
+      if (close == string_view::npos)
+        return NEED_MORE;
+      length = close + 2 - pos;
+      return SKIPPED;
+
+    case '!':
+      if (end - pos < 4)
+        return NEED_MORE;
+
+      if (strncmp(markup, "<!--", 4) == 0)
+      {
+        close = find(pos + 4, "-->");
+        if (close == string_view::npos)
+          return NEED_MORE;
+        length = close + 3 - pos;
+        return SKIPPED;
+      }
+
+      if (end - pos < 9)
+        return NEED_MORE;
+
+      if (strncmp(markup, "<![CDATA[", 9) == 0)
+      {
+        close = find(pos + 9, "]]>");
+        if (close == string_view::npos)
+          return NEED_MORE;
+        length = close + 3 - pos;
+        return SKIPPED;
+      }
+
+      return skipDoctype(length);
+
+    case '/':
+      event = END_ELEMENT;
+      return parseEndTag(length);
+
+    default:
+      event = START_ELEMENT;
+      return parseStartTag(length);
+  }
+}
+
+
+//
+// parseStartTag
+//
+// Parses <name attr="value" ...> or the empty element <name ... />.
+//
+XmlPullParser::Status XmlPullParser::parseStartTag(size_t& length)
+{
+  size_t i = pos + 1;
+  size_t nameStart = i;
+
+  while (i < end && isNameChar(text[i]))
+    i++;
+
+  if (i == end)
+    return NEED_MORE;
+  if (i == nameStart)
+    return MALFORMED;
+
+  elementName = string_view(text + nameStart, i - nameStart);
+  attributeList.clear();
+
+  bool empty = false;
+
+  for (;;)
+  {
+    while (i < end && isSpace(text[i]))
+      i++;
+
+    if (i == end)
+      return NEED_MORE;
+
+    if (text[i] == '>')
+    {
+      i++;
+      break;
+    }
+
+    if (text[i] == '/')
+    {
+      if (i + 1 == end)
+        return NEED_MORE;
+      if (text[i + 1] != '>')
+        return MALFORMED;
+
+      i += 2;
+      empty = true;
+      break;
+    }
+
+    // attribute name:
+    size_t attrStart = i;
+
+    while (i < end && isNameChar(text[i]))
+      i++;
+
+    if (i == end)
+      return NEED_MORE;
+    if (i == attrStart)
+      return MALFORMED;
+
+    string_view attrName(text + attrStart, i - attrStart);
+
+    for (const Attribute& attr : attributeList)
+    {
+      if (attr.Name == attrName)
+        return MALFORMED;
+    }
+
+    // = and the quoted value:
+    while (i < end && isSpace(text[i]))
+      i++;
+
+    if (i == end)
+      return NEED_MORE;
+    if (text[i] != '=')
+      return MALFORMED;
+
+    i++;
+
+    while (i < end && isSpace(text[i]))
+      i++;
+
+    if (i == end)
+      return NEED_MORE;
+    if (text[i] != '"' && text[i] != '\'')
+      return MALFORMED;
+
+    const char* quote = (const char*)memchr(text + i + 1, text[i], end - (i + 1));
+
+    if (quote == nullptr)
+      return NEED_MORE;
+
+    attributeList.push_back(Attribute{attrName, string_view(text + i + 1, quote - (text + i + 1))});
+    i = (quote - text) + 1;
+  }
+
+  pendingEnd = empty;
+  length = i - pos;
+  return DONE;
+}
+
+
+//
+// parseEndTag
+//
+// Parses </name>, which must close the innermost open element.
+//
+XmlPullParser::Status XmlPullParser::parseEndTag(size_t& length)
+{
+  size_t i = pos + 2;
+  size_t nameStart = i;
+
+  while (i < end && isNameChar(text[i]))
+    i++;
+
+  string_view name(text + nameStart, i - nameStart);
+
+  while (i < end && isSpace(text[i]))
+    i++;
+
+  if (i == end)
+    return NEED_MORE;
+
+  if (text[i] != '>' || openElements.empty() || openElements.back() != name)
+    return MALFORMED;
+
+  closedName = openElements.back();
+  length = i + 1 - pos;
+  return DONE;
+}
+
+
+//
+// skipDoctype
+//
+// Skips <!DOCTYPE ...>, including an internal subset in [ ], which can
+// itself contain '>' characters inside declarations and quoted strings.
+//
+XmlPullParser::Status XmlPullParser::skipDoctype(size_t& length)
+{
+  int brackets = 0;
+  char quote = 0;
+
+  for (size_t i = pos + 2; i < end; i++)
+  {
+    char c = text[i];
+
+    if (quote != 0)
+    {
+      if (c == quote)
+        quote = 0;
+    }
+    else if (c == '"' || c == '\'')
+      quote = c;
+    else if (c == '[')
+      brackets++;
+    else if (c == ']')
+      brackets--;
+    else if (c == '>' && brackets <= 0)
+    {
+      length = i + 1 - pos;
+      return SKIPPED;
+    }
+  }
+
+  return NEED_MORE;
+}
+
+
+//
+// fail
+//
+XmlPullParser::Event XmlPullParser::fail(const string& message)
+{
+  errorText = message;
+  return PARSE_ERROR;
+}
+
+
+//
+// parseFragment
+//
+// Treats the input as a piece of an element's contents, which may hold
+// any number of top-level elements, rather than as a document with a
+// single root element.
+//
+void XmlPullParser::parseFragment()
+{
+  fragment = true;
+}
+
+
+//
+// next
+//
+// Advances to the next element start or end and returns which it is,
+// END_DOCUMENT once the input is used up, or PARSE_ERROR if the input
+// is not well-formed (after which every call returns PARSE_ERROR).  An
+// empty element <x/> produces a START_ELEMENT followed by an
+// END_ELEMENT.
+//
+XmlPullParser::Event XmlPullParser::next()
+{
+  if (!errorText.empty())
+    return PARSE_ERROR;
+
+  attributeList.clear();
+
+  if (pendingEnd)
+  {
+    pendingEnd = false;
+    closedName = openElements.back();
+    openElements.pop_back();
+    elementName = closedName;
+    return END_ELEMENT;
+  }
+
+  for (;;)
+  {
+    const char* open = (end > pos) ? (const char*)memchr(text + pos, '<', end - pos) : nullptr;
+
+    // text up to the end of the buffer, which is skipped:
+    if (open == nullptr)
+    {
+      pos = end;
+
+      if (readMore())
+        continue;
+
+      if (!openElements.empty())
+        return fail("unexpected end of input inside <" + openElements.back() + ">");
+      if (!sawRoot && !fragment)
+        return fail("no root element");
+
+      return END_DOCUMENT;
+    }
+
+    pos = open - text;
+
+    size_t length = 0;
+    Event event = END_DOCUMENT;
+    Status status = parseMarkup(length, event);
+
+    if (status == NEED_MORE)
+    {
+      if (!readMore())
+        return fail("unexpected end of input");
+      continue;
+    }
+
+    if (status == MALFORMED)
+      return fail("malformed markup");
+
+    pos += length;
+
+    if (status == SKIPPED)
+      continue;
+
+    if (event == START_ELEMENT)
+    {
+      if (openElements.empty() && sawRoot && !fragment)
+        return fail("element <" + string(elementName) + "> after the root element");
+
+      openElements.push_back(string(elementName));
+      sawRoot = true;
+    }
+    else
+    {
+      openElements.pop_back();
+      elementName = closedName;
+    }
+
+    return event;
+  }
+}
+
+
+//
+// name
+//
+// Returns the name of the element that was just started or ended.
+//
+string_view XmlPullParser::name() const
+{
+  return elementName;
+}
+
+
+//
+// attributes
+//
+// Returns the attributes of the element just started, in document
+// order (none for an END_ELEMENT).
+//
+const vector<XmlPullParser::Attribute>& XmlPullParser::attributes() const
+{
+  return attributeList;
+}
+
+
+//
+// findAttribute
+//
+// Returns the attribute with the given name, or nullptr.
+//
+const XmlPullParser::Attribute* XmlPullParser::findAttribute(string_view name) const
+{
+  for (const Attribute& attr : attributeList)
+  {
+    if (attr.Name == name)
+      return &attr;
+  }
+
+  return nullptr;
+}
+
+
+//
+// depth
+//
+// Returns the number of open elements, counting an element that was
+// just started and not counting one that was just ended; the root
+// element is at depth 1.
+//
+size_t XmlPullParser::depth() const
+{
+  return openElements.size();
+}
+
+
+//
+// offset
+//
+// Returns the offset in the input of the first byte not yet parsed,
+// just past the markup of the last event.
+//
+size_t XmlPullParser::offset() const
+{
+  return base + pos;
+}
+
+
+//
+// error
+//
+// Returns a description of the parse error, empty if there is none.
+//
+const string& XmlPullParser::error() const
+{
+  return errorText;
+}
+
+
+//
+// appendUtf8
+//
+static void appendUtf8(unsigned long code, string& out)
+{
+  if (code < 0x80)
+  {
+    out += (char)code;
+  }
+  else if (code < 0x800)
+  {
+    out += (char)(0xC0 | (code >> 6));
+    out += (char)(0x80 | (code & 0x3F));
+  }
+  else if (code < 0x10000)
+  {
+    out += (char)(0xE0 | (code >> 12));
+    out += (char)(0x80 | ((code >> 6) & 0x3F));
+    out += (char)(0x80 | (code & 0x3F));
+  }
+  else
+  {
+    out += (char)(0xF0 | (code >> 18));
+    out += (char)(0x80 | ((code >> 12) & 0x3F));
+    out += (char)(0x80 | ((code >> 6) & 0x3F));
+    out += (char)(0x80 | (code & 0x3F));
+  }
+}
+
+
+//
+// decode
+//
+// Expands the entity references in a raw attribute value (&amp; &lt;
+// &gt; &quot; &apos; and numeric &#...; / &#x...;) and normalizes line
+// breaks to \n, the same processing tinyxml2 applies to attributes.
+// Unknown references are kept as they are.
+//
+void XmlPullParser::decode(string_view raw, string& decoded)
+{
+  static const struct { const char* text; char value; } entities[] = {
+    {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}
+  };
+
+  decoded.clear();
+  decoded.reserve(raw.size());
+
+  for (size_t i = 0; i < raw.size(); i++)
+  {
+    char c = raw[i];
+
+    if (c == '\r')
+    {
+      decoded += '\n';
+      if (i + 1 < raw.size() && raw[i + 1] == '\n')
+        i++;
+      continue;
+    }
+
+    if (c != '&')
+    {
+      decoded += c;
+      continue;
+    }
+
+    size_t semicolon = raw.find(';', i);
+    bool expanded = false;
+
+    if (semicolon != string_view::npos)
+    {
+      string_view reference = raw.substr(i, semicolon + 1 - i);
+
+      if (reference.size() > 3 && reference[1] == '#')
+      {
+        bool hex = (reference[2] == 'x');
+        string digits(reference.substr(hex ? 3 : 2, reference.size() - (hex ? 4 : 3)));
+        char* stop = nullptr;
+        unsigned long code = strtoul(digits.c_str(), &stop, hex ? 16 : 10);
+
+        if (!digits.empty() && *stop == '\0' && code <= 0x10FFFF)
+        {
+          appendUtf8(code, decoded);
+          expanded = true;
+        }
+      }
+      else
+      {
+        for (const auto& entity : entities)
+        {
+          if (reference == entity.text)
+          {
+            decoded += entity.value;
+            expanded = true;
+            break;
+          }
+        }
+      }
+
+      if (expanded)
+        i = semicolon;
+    }
+
+    if (!expanded)
+      decoded += c;
+  }
+}
@@ -0,0 +1,249 @@
+/*xmlstream.h*/
+
+//
+// Streaming (pull) XML parser for reading large map files without
+// building a document tree.
+//
+// The parser reads its input from a ByteSource in fixed-size chunks and
+// hands back one event at a time: the start of an element, with its
+// name and attributes, or the end of one.  Text, comments, processing
+// instructions, CDATA sections and the DOCTYPE are skipped.  Names and
+// attribute values are string_views into the parser's buffer, valid
+// only until the next call to next(); attribute values are raw, and
+// decode() expands their entity references when needed.
+//
+// Only the current chunk (plus any element that straddles two chunks)
+// is held in memory, so memory use does not grow with the file, even
+// when the chunks are decompressed from a gzip or bzip2 file.  A
+// source that is already in memory as a whole (a memory-mapped file)
+// is parsed in place instead, without copying anything: names and
+// values are then views straight into the mapping.
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+
+using namespace std;
+
+
+//
+// ByteSource
+//
+// Where the parser gets its input from.  read() copies the next bytes
+// into the caller's buffer and returns how many, 0 at the end of the
+// input.  A source whose whole contents are in memory also returns
+// them from contents(), so they can be parsed without copying.
+//
+class ByteSource {
+  public:
+    virtual ~ByteSource() {}
+
+    virtual size_t read(char* buffer, size_t size) = 0;
+    virtual bool contents(const char*& data, size_t& size) const;
+};
+
+
+//
+// FileSource
+//
+// Reads a file from disk with stdio.
+//
+class FileSource : public ByteSource {
+  private:
+    FILE* file;
+
+  public:
+    explicit FileSource(const string& filename);
+    ~FileSource();
+
+    FileSource(const FileSource&) = delete;
+    FileSource& operator=(const FileSource&) = delete;
+
+    bool isOpen() const;
+    size_t read(char* buffer, size_t size) override;
+};
+
+
+//
+// MappedFileSource
+//
+// Maps a file into memory read-only (on POSIX systems), so the parser
+// works directly on the page cache: no read buffer, and no copy of the
+// file on the heap.  isOpen() is false if the file cannot be mapped,
+// and the caller can fall back to a FileSource.
+//
+class MappedFileSource : public ByteSource {
+  private:
+    const char* data;
+    size_t size;
+    size_t offset;   // bytes already handed out by read()
+    bool mapped;
+
+  public:
+    explicit MappedFileSource(const string& filename);
+    ~MappedFileSource();
+
+    MappedFileSource(const MappedFileSource&) = delete;
+    MappedFileSource& operator=(const MappedFileSource&) = delete;
+
+    bool isOpen() const;
+    size_t read(char* buffer, size_t size) override;
+    bool contents(const char*& data, size_t& size) const override;
+};
+
+
+//
+// MemorySource
+//
+// Input already in memory, such as part of a mapped file, parsed in
+// place.  The bytes must outlive the parser.
+//
+class MemorySource : public ByteSource {
+  private:
+    const char* data;
+    size_t size;
+    size_t offset;   // bytes already handed out by read()
+
+  public:
+    MemorySource(const char* data, size_t size);
+
+    size_t read(char* buffer, size_t size) override;
+    bool contents(const char*& data, size_t& size) const override;
+};
+
+
+//
+// GzipSource
+//
+// Reads a gzip-compressed file (such as an .osm.gz extract) with zlib,
+// decompressing it a chunk at a time as the parser asks for more, so
+// the uncompressed file is never on disk or in memory as a whole.
+// isOpen() is false if the file cannot be opened, or if this build has
+// no zlib.  Damaged data ends the input early, which the parser then
+// reports as a malformed document.
+//
+class GzipSource : public ByteSource {
+  private:
+    void* file;   // gzFile
+
+  public:
+    explicit GzipSource(const string& filename);
+    ~GzipSource();
+
+    GzipSource(const GzipSource&) = delete;
+    GzipSource& operator=(const GzipSource&) = delete;
+
+    bool isOpen() const;
+    size_t read(char* buffer, size_t size) override;
+};
+
+
+//
+// Bzip2Source
+//
+// The same for bzip2-compressed files (.osm.bz2), with libbzip2.  Files
+// written by parallel compressors, which hold a series of bzip2
+// streams, are read through to the end of the last one.
+//
+class Bzip2Source : public ByteSource {
+  private:
+    FILE* file;
+    void* stream;   // BZFILE for the current stream, null at the end
+
+    bool openStream(const char* unused, int numUnused);
+    void closeStream();
+
+  public:
+    explicit Bzip2Source(const string& filename);
+    ~Bzip2Source();
+
+    Bzip2Source(const Bzip2Source&) = delete;
+    Bzip2Source& operator=(const Bzip2Source&) = delete;
+
+    bool isOpen() const;
+    size_t read(char* buffer, size_t size) override;
+};
+
+
+//
+// fileCompression
+//
+// How a file is compressed, judged by its first bytes rather than its
+// name.  Unreadable files count as not compressed.
+//
+enum class Compression {
+  NONE,
+  GZIP,
+  BZIP2
+};
+
+Compression fileCompression(const string& filename);
+
+
+class XmlPullParser {
+  public:
+    enum Event {
+      START_ELEMENT,
+      END_ELEMENT,
+      END_DOCUMENT,
+      PARSE_ERROR
+    };
+
+    struct Attribute {
+      string_view Name;
+      string_view Value;  // raw, entity references not expanded
+    };
+
+  private:
+    enum Status {
+      DONE,        // markup parsed
+      SKIPPED,     // markup parsed, but produces no event
+      NEED_MORE,   // markup continues past the end of the buffer
+      MALFORMED
+    };
+
+    ByteSource& source;
+    size_t chunkSize;
+    vector<char> buffer;         // chunks read from the source, unless parsing in place
+    const char* text;            // bytes being parsed, buffer.data() or the source's contents
+    size_t base;                 // offset in the input of text[0]
+    size_t pos;                  // next unparsed byte in text
+    size_t end;                  // end of the valid bytes in text
+    bool atEnd;                  // source has no more bytes
+
+    string_view elementName;
+    vector<Attribute> attributeList;
+    vector<string> openElements;  // names of the elements not yet closed
+    string closedName;            // name of the element of the last END_ELEMENT
+    bool pendingEnd;              // last START_ELEMENT was an empty element <x/>
+    bool sawRoot;
+    bool fragment;                // input is a piece of an element's contents
+    string errorText;
+
+    bool readMore();
+    size_t find(size_t from, const char* pattern) const;
+    Status parseMarkup(size_t& length, Event& event);
+    Status parseStartTag(size_t& length);
+    Status parseEndTag(size_t& length);
+    Status skipDoctype(size_t& length);
+    Event fail(const string& message);
+
+  public:
+    explicit XmlPullParser(ByteSource& source, size_t chunkSize = 64 * 1024);
+
+    void parseFragment();
+    Event next();
+
+    string_view name() const;
+    const vector<Attribute>& attributes() const;
+    const Attribute* findAttribute(string_view name) const;
+    size_t depth() const;
+    size_t offset() const;
+    const string& error() const;
+
+    static void decode(string_view raw, string& decoded);
+};